@@ -1,6 +1,24 @@
 #include "BankQueueManager.h"
+#include <iomanip>
+#include <sstream>
 
-int BankQueueManager::arrivalOrder = 0; // Definition and initialization outside the class
+// Statistics of a request (Stats.h): metrics and counters are listed in
+// Service and ClientType order.
+static LatencyMetric serveMetric(Service kind)
+{
+    return static_cast<LatencyMetric>(static_cast<size_t>(LatencyMetric::SERVE_DEPOSIT) + static_cast<size_t>(kind));
+}
+
+static LatencyMetric waitMetric(ClientType type)
+{
+    return static_cast<LatencyMetric>(static_cast<size_t>(LatencyMetric::WAIT_VIP) + static_cast<size_t>(type));
+}
+
+// `first` is the VIP counter of a per-type group.
+static StatsCounter typeCounter(StatsCounter first, ClientType type)
+{
+    return static_cast<StatsCounter>(static_cast<size_t>(first) + static_cast<size_t>(type));
+}
 
 
 std::unique_ptr<Client> createClientFactory(const std::string& id,
@@ -19,39 +37,171 @@ std::unique_ptr<Client> createClientFactory(const std::string& id,
     }
 }
 
+bool BankQueueManager::addBankClient(const std::string& id, int balance, const std::string& typeStr)
+{
+    auto client = createClientFactory(id, balance, typeStr);
+    if (!client) return false;
+    size_t before = clientsByHandle.size();
+    registerClient(std::move(client));
+    return clientsByHandle.size() > before;
+}
+
+// Builds a ServiceRequest in place - nothing on this path touches the heap once
+// the queue node pool and the per-handle tables are warm.
+// Returns the arrival ticket, or 0 when nothing was queued.
+int BankQueueManager::addRequest(std::string_view id, Service service, int amount, std::string_view targetId)
+{
+    Client* c = findClientById(id);
+    if (!c) {
+        replyError() << "Client with ID " << id << " not found! skipping";
+        return 0;
+    }
+
+    uint32_t target = kNoClient;
+    if (service == Service::TRANSFER) {
+        Client* to_client = findClientById(targetId);
+        RemoteAccount where{};
+        if (to_client) {
+            target = to_client->getHandle();
+        } else if (router && router->findRemote(targetId, where)) {
+            target = remoteTargetHandle(targetId, where);
+        } else {
+            replyError() << "Target client with ID " << targetId << " not found! skipping";
+            return 0;
+        }
+    }
+    return addRequest(c->getHandle(), service, amount, target);
+}
+
+int BankQueueManager::addRequest(uint32_t client, Service service, int amount, uint32_t target)
+{
+    BANKQ_TRACE_SCOPE("factory");
+    const int64_t begin = LatencyStats::instance().start();
+    if (client >= clientsByHandle.size()) {
+        replyError() << "Client handle " << client << " not found! skipping";
+        return 0;
+    }
+    Client* c = clientsByHandle[client];
+
+    if (service == Service::CHECK && isCheckFastLane(c->getType())) {
+        serveCheckFastLane(*c);
+        StatsCounters::instance().add(StatsCounter::FAST_LANE_CHECKS);
+        LatencyStats::instance().record(LatencyMetric::ADD, begin);
+        return 0;
+    }
+
+    ServiceRequest request{};
+    request.client = client;
+    request.kind = service;
+    request.clientType = c->getType();
+
+    switch (service) {
+        case Service::WITHDRAW:
+        case Service::DEPOSIT:
+            request.amount = amount;
+            break;
+        case Service::CHECK:
+            break;
+        case Service::TRANSFER:
+            if ((target & kRemoteTarget) ? (target & ~kRemoteTarget) >= remoteTargets.size() : target >= clientsByHandle.size()) {
+                replyError() << "Target client handle " << target << " not found! skipping";
+                return 0;
+            }
+            request.amount = amount;
+            request.target = target;
+            break;
+        default:
+            replyError() << "Unknown service for client " << c->getId() << "! skipping";
+            return 0;
+    }
+
+    arrivalOrder++;
+    request.ticket = arrivalOrder;
+    request.issuedNs = begin;
+    AddRequestToQueue(request);
+    LatencyStats::instance().record(LatencyMetric::ADD, begin);
+    return request.ticket;
+}
+
 void BankQueueManager::createRequestFactory(const std::string& id,
                                             const std::string& service,
                                             int amount,
                                             const std::string& targetId) {
+    addRequest(id, parseService(service), amount, targetId);
+}
+
+void BankQueueManager::createMultiTransferRequest(std::string_view id,
+                                                  const std::pmr::vector<std::pair<int, std::string_view>>& legs)
+{
+    BANKQ_TRACE_SCOPE("factory");
+    const int64_t begin = LatencyStats::instance().start();
     Client* c = findClientById(id);
     if (!c) {
-        std::cerr << "Client with ID " << id << " not found! skipping\n";
+        replyError() << "Client with ID " << id << " not found! skipping";
         return;
     }
 
-    arrivalOrder++;
-
-    std::unique_ptr<IServiceAction> newRequest;
-
-    if (service == "withdraw") {
-        newRequest = std::make_unique<WithdrawAction>(id, amount, c, arrivalOrder);
-    } else if (service == "deposit") {
-        newRequest = std::make_unique<DepositAction>(id, amount, c, arrivalOrder);
-    } else if (service == "check") {
-        newRequest = std::make_unique<CheckAction>(id, c, arrivalOrder);
-    } else if (service == "transfer") {
+    // Resolved straight into a recycled slot, whose capacity is kept.
+    const uint32_t slot = acquireLegSlot();
+    std::pmr::vector<TransferLeg>& resolved = legSlots[slot];
+    resolved.reserve(legs.size());
+    long long total = 0;
+    for (const auto& [amount, targetId] : legs) {
         Client* to_client = findClientById(targetId);
         if (!to_client) {
-            std::cerr << "Target client with ID " << id << " not found! skipping\n";
+            replyError() << "Target client with ID " << targetId << " not found! skipping";
+            resolved.clear();
+            freeLegSlots.push_back(slot);
             return;
         }
-        newRequest = std::make_unique<TransferAction>(id, amount, c, targetId, to_client, arrivalOrder);
+        resolved.push_back(TransferLeg{to_client, amount});
+        total += amount;
+    }
+
+    arrivalOrder++;
+
+    ServiceRequest request{};
+    request.ticket = arrivalOrder;
+    request.client = c->getHandle();
+    request.target = slot;
+    request.amount = total > INT_MAX ? INT_MAX : static_cast<int>(total);
+    request.kind = Service::MULTI_TRANSFER;
+    request.clientType = c->getType();
+    request.issuedNs = begin;
+
+    AddRequestToQueue(request);
+    LatencyStats::instance().record(LatencyMetric::ADD, begin);
+}
+
+uint32_t BankQueueManager::acquireLegSlot()
+{
+    if (!freeLegSlots.empty()) {
+        uint32_t slot = freeLegSlots.back();
+        freeLegSlots.pop_back();
+        return slot;
     }
+    legSlots.emplace_back();
+    return static_cast<uint32_t>(legSlots.size() - 1);
+}
 
-    AddRequestToQueue(std::move(newRequest));
+template <typename Fn>
+void BankQueueManager::forEachLeg(const ServiceRequest& request, Fn&& fn) const
+{
+    if (request.kind == Service::TRANSFER) {
+        if (!(request.target & kRemoteTarget)) fn(TransferLeg{clientsByHandle[request.target], request.amount});
+    } else if (request.kind == Service::MULTI_TRANSFER) {
+        for (const TransferLeg& leg : legSlots[request.target]) fn(leg);
+    }
 }
-                                   
 
+// Drops the request's bookkeeping once it has left the queue.
+void BankQueueManager::releaseRequest(const ServiceRequest& request)
+{
+    if (request.kind == Service::MULTI_TRANSFER) {
+        legSlots[request.target].clear(); // keeps its capacity for the next multi-transfer
+        freeLegSlots.push_back(request.target);
+    }
+}
 void BankQueueManager::LoadPreClientsAndQueue()
 {
     // load clients
@@ -73,10 +223,7 @@ void BankQueueManager::LoadPreClientsAndQueue()
             balance = clientJson.at("balance").get<int>();
             typeStr = clientJson.at("clientType").get<std::string>();
 
-            auto client = createClientFactory(id, balance, typeStr);
-            if (client) {
-                clientsMap[id] = std::move(client);
-            }
+            addBankClient(id, balance, typeStr);
         } catch (const std::out_of_range& e) {
             std::cerr << "Missing required client field: " << e.what() << std::endl;
             continue;
@@ -122,6 +269,21 @@ void BankQueueManager::LoadPreClientsAndQueue()
             targetId = clientJson.at("targetId").get<std::string>();
         }
 
+        if (service == "multitransfer") {
+            std::pmr::vector<std::pair<int, std::string_view>>& legs = legArgs; // views into clientJson
+            legs.clear();
+            try {
+                for (const auto& legJson : clientJson.at("legs")) {
+                    legs.emplace_back(legJson.at("amount").get<int>(), legJson.at("targetId").get_ref<const std::string&>());
+                }
+            } catch (const std::out_of_range& e) {
+                std::cerr << "Missing required multitransfer field: " << e.what() << std::endl;
+                continue;
+            }
+            createMultiTransferRequest(id, legs);
+            continue;
+        }
+
         // std::cout << "id: " << id << ", service: " << service;
         // if (clientJson.contains("amount")) std::cout << ", amount: " << amount;
         // if (clientJson.contains("targetId")) std::cout << ", targetId: " << targetId;
@@ -132,7 +294,28 @@ void BankQueueManager::LoadPreClientsAndQueue()
 
 }
 
-Client* BankQueueManager::findClientById(const std::string& id) {
+void BankQueueManager::registerClient(std::unique_ptr<Client> client)
+{
+    if (clientsMap.count(client->getId())) {
+        std::cerr << "Duplicate client id " << client->getId() << " - skipped\n";
+        return;
+    }
+    client->setHandle(static_cast<uint32_t>(clientsByHandle.size()));
+    clientsByHandle.push_back(client.get());
+    queue.addClient();
+    ledger.openAccount(client->getHandle(), client->getBalance());
+    checkLedger(*client);
+    std::string_view key = client->getId();
+    clientsMap.emplace(key, std::move(client));
+}
+
+uint32_t BankQueueManager::findClientHandle(std::string_view id)
+{
+    Client* c = findClientById(id);
+    return c ? c->getHandle() : kNoClient;
+}
+
+Client* BankQueueManager::findClientById(std::string_view id) {
     auto it = clientsMap.find(id);
     if (it != clientsMap.end()) {
         return it->second.get(); // מקבל מצביע מתוך unique_ptr
@@ -140,215 +323,1091 @@ Client* BankQueueManager::findClientById(const std::string& id) {
     return nullptr;
 }
 
-void BankQueueManager::AddRequestToQueue(std::unique_ptr<IServiceAction> newRequest)
+void BankQueueManager::AddRequestToQueue(const ServiceRequest& newRequest)
 {
+    BANKQ_TRACE_SCOPE("insert");
     
-    Client* client = newRequest->getClient();  
+    Client* client = clientsByHandle[newRequest.client];  
 
-    auto [it, inserted] = queue.insert(std::move(newRequest));
+    const bool inserted = queue.push(newRequest);
+    if (inserted) StatsCounters::instance().add(typeCounter(StatsCounter::QUEUED_VIP, newRequest.clientType));
 
-    if (inserted) {
-        std::cout << "Added client '" << client->getId() << "' to service queue\n";
-        ClientIdToQueueMap[client->getId()] = it;
-    } else {
-        std::cout << "Client '" << client->getId() << "' already inside the service queue - skipped.\n";
-    }
+    ActionResult result{};
+    result.event = ResultEvent::QUEUED;
+    result.code = inserted ? ResultCode::OK : ResultCode::ALREADY_QUEUED;
+    result.ticket = newRequest.ticket;
+    result.client = newRequest.client;
+    result.amount = newRequest.amount;
+    result.balanceAfter = client->getBalance();
+    result.kind = static_cast<uint8_t>(newRequest.kind);
+    emit(result);
 
 }
 
-void BankQueueManager::printQueue() {
+void BankQueueManager::printQueue(std::ostream& out) {
 
     if (!queue.empty())
     {
-        std::cout << "Bank queue:" << std::endl;
-        for (const auto& actionPtr : queue) {
-            Client* c = actionPtr->getClient();
-            std::cout << "Id: " << c->getId() << ", Balance: " << c->getBalance() << ", Client type: " << c->getTypeAsString()
-                      << ", Action Type: " <<  service_to_string(actionPtr->getServiceKind())
-                      << ", Ticket #: " << actionPtr->getArrivalTicketNumber() << std::endl;
-        }
+        out << "Bank queue:" << std::endl;
+        queue.forEach([&](const ServiceRequest& request) {
+            Client* c = clientsByHandle[request.client];
+            out << "Id: " << c->getId() << ", Balance: " << c->getBalance() << ", Client type: " << c->getTypeAsString()
+                << ", Action Type: " <<  service_to_string(request.kind)
+                << ", Ticket #: " << request.ticket << std::endl;
+        });
     }
     else
     {
-        std::cout << "Bank queue is empty" << std::endl;
+        out << "Bank queue is empty" << std::endl;
     }
 }
 
-void BankQueueManager::printBankClients()
+void BankQueueManager::printBankClients(std::ostream& out)
 {
     if (!clientsMap.empty())
     {
-        std::cout << "Bank clients:" << std::endl;
+        out << "Bank clients:" << std::endl;
         for (const auto& pair : clientsMap)
         {
             const auto& clientPtr = pair.second;
             if (clientPtr) {
-                std::cout << "Id: " << clientPtr->getId() << ", Balance: " << clientPtr->getBalance() << " , Client type: " << clientPtr->getTypeAsString() << std::endl;
+                out << "Id: " << clientPtr->getId() << ", Balance: " << clientPtr->getBalance() << " , Client type: " << clientPtr->getTypeAsString() << std::endl;
             }
         }
     }
     else
     {
-        std::cout << "There are no bank clients." << std::endl;
+        out << "There are no bank clients." << std::endl;
+    }
+}
+
+void BankQueueManager::printLedger(std::string_view id)
+{
+    Client* c = findClientById(id);
+    if (!c) {
+        std::cout << "No client found with id: '" << id << "'" << std::endl;
+        return;
+    }
+
+    const uint32_t account = Ledger::accountOf(c->getHandle());
+    std::cout << "Ledger for client '" << id << "':" << std::endl;
+    ledger.forEachEntry(account, [](const Ledger::Entry& e) {
+        std::cout << "Tx #" << e.txId << ", Ticket #: " << e.ticket
+                  << (e.amount >= 0 ? ", Credit: " : ", Debit: ") << (e.amount >= 0 ? e.amount : -e.amount) << "$\n";
+    });
+    std::cout << "Materialized balance: " << ledger.balance(account) << "$ (client balance: " << c->getBalance()
+              << "$), journal entries: " << ledger.entryCount() << ", trial balance: " << ledger.trialBalance() << std::endl;
+}
+
+// Read-only checks never touch the queue: the manager is the single writer of
+// every balance, so reading it between commands is already a consistent snapshot.
+void BankQueueManager::serveCheckFastLane(Client& c)
+{
+    ActionResult result{};
+    result.event = ResultEvent::FAST_LANE;
+    result.client = c.getHandle();
+    result.balanceAfter = c.getBalance();
+    result.kind = static_cast<uint8_t>(Service::CHECK);
+    emit(result);
+
+    History::Record r{};
+    r.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    r.ticket = 0; // no ticket issued
+    r.counterparty = History::kNone;
+    r.balanceAfter = c.getBalance();
+    r.kind = static_cast<uint8_t>(Service::CHECK);
+    history.append(c.getHandle(), r);
+}
+
+void BankQueueManager::setCheckFastLane(ClientType type, bool enabled)
+{
+    if (type != ClientType::UNKNOWN) checkFastLane[static_cast<size_t>(type)] = enabled;
+}
+
+bool BankQueueManager::isCheckFastLane(ClientType type) const
+{
+    return type != ClientType::UNKNOWN && checkFastLane[static_cast<size_t>(type)];
+}
+
+void BankQueueManager::recordHistory(const ServiceRequest& request, bool succeeded)
+{
+    Client* c = clientsByHandle[request.client];
+
+    History::Record r{};
+    r.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    r.ticket = request.ticket;
+    r.counterparty = request.kind == Service::TRANSFER ? request.target : History::kNone;
+    r.amount = request.kind == Service::CHECK ? 0 : request.amount;
+    r.balanceAfter = c->getBalance();
+    r.kind = static_cast<uint8_t>(request.kind);
+    r.flags = succeeded ? 0 : History::kFailed;
+    history.append(c->getHandle(), r);
+
+    r.counterparty = c->getHandle();
+    r.flags |= History::kIncoming;
+    if (request.kind != Service::MULTI_TRANSFER) {
+        forEachLeg(request, [&](const TransferLeg& leg) {
+            r.amount = leg.amount;
+            r.balanceAfter = leg.to->getBalance();
+            history.append(leg.to->getHandle(), r);
+        });
+        return;
+    }
+    // A target may take several legs: each records its balance right after
+    // that leg, i.e. the final balance less what its later legs credited.
+    // One backward pass sums those credits per target, then the records are
+    // appended in leg order.
+    const std::pmr::vector<TransferLeg>& legs = legSlots[request.target];
+    legBalances.resize(legs.size());
+    if (creditedLater.size() < clientsByHandle.size()) creditedLater.resize(clientsByHandle.size());
+    for (size_t i = legs.size(); i-- > 0;) {
+        long long& later = creditedLater[legs[i].to->getHandle()];
+        legBalances[i] = static_cast<int>(legs[i].to->getBalance() - later);
+        if (succeeded) later += legs[i].amount;
+    }
+    for (size_t i = 0; i < legs.size(); ++i) {
+        creditedLater[legs[i].to->getHandle()] = 0;
+        r.amount = legs[i].amount;
+        r.balanceAfter = legBalances[i];
+        history.append(legs[i].to->getHandle(), r);
+    }
+}
+
+// Feeds every credited account to the hot account detector, which splits the
+// balance of accounts taking a large share of the credits into sub-counters.
+void BankQueueManager::recordCredits(const ServiceRequest& request)
+{
+    auto onHot = [this](uint32_t h) {
+        Client* c = clientsByHandle[h];
+        c->enableSplit();
+
+        ActionResult result{};
+        result.event = ResultEvent::HOT;
+        result.client = h;
+        result.balanceAfter = c->getBalance();
+        emit(result);
+    };
+    auto onCold = [this](uint32_t h) {
+        clientsByHandle[h]->disableSplit();
+    };
+
+    if (request.kind == Service::DEPOSIT) {
+        hotAccounts.recordCredit(request.client, onHot, onCold);
+    }
+    forEachLeg(request, [&](const TransferLeg& leg) {
+        hotAccounts.recordCredit(leg.to->getHandle(), onHot, onCold);
+    });
+}
+
+void BankQueueManager::printHistory(const CommandTokens& args)
+{
+    // args: history <id> [last <n> | ticket <from> <to> | time <fromMs> <toMs>]
+    const char* usage = "Invalid usage. Use: history [id] [(optional) last [n] | ticket [from] [to] | time [fromMs] [toMs]]";
+    if (args.size() < 2) {
+        std::cout << usage << std::endl;
+        return;
+    }
+
+    Client* c = findClientById(args[1]);
+    if (!c) {
+        std::cout << "No client found with id: '" << args[1] << "'" << std::endl;
+        return;
+    }
+
+    auto print = [this](const History::Record& r) {
+        std::cout << "Ticket #: " << r.ticket << ", Time: " << r.timeMs
+                  << ", Action Type: " << service_to_string(static_cast<Service>(r.kind));
+        if (r.counterparty != History::kNone)
+            std::cout << ((r.flags & History::kIncoming) ? ", From: " : ", To: ")
+                      << targetId(r.counterparty);
+        if (r.amount > 0) std::cout << ", Amount: " << r.amount << "$";
+        std::cout << ", Balance after: " << r.balanceAfter << "$"
+                  << ((r.flags & History::kFailed) ? " (failed)" : "") << "\n";
+    };
+
+    std::cout << "History for client '" << c->getId() << "':" << std::endl;
+    size_t last = 20;
+    int fromTicket, toTicket;
+    int64_t fromMs, toMs;
+    bool complete = true;
+    if (args.size() == 2) {
+        complete = history.forEachLast(c->getHandle(), last, print);
+    } else if (args[2] == "last" && args.size() == 4 && parseNumber(args[3], last)) {
+        complete = history.forEachLast(c->getHandle(), last, print);
+    } else if (args[2] == "ticket" && args.size() == 5 && parseNumber(args[3], fromTicket) && parseNumber(args[4], toTicket)) {
+        complete = history.forEachTicketRange(c->getHandle(), fromTicket, toTicket, print);
+    } else if (args[2] == "time" && args.size() == 5 && parseNumber(args[3], fromMs) && parseNumber(args[4], toMs)) {
+        complete = history.forEachTimeRange(c->getHandle(), fromMs, toMs, print);
+    } else {
+        std::cout << usage << std::endl;
+    }
+    if (!complete) std::cout << "Some records could not be read back from " << history.spillFile() << " and are missing." << std::endl;
+}
+
+// --- Latency statistics (see Stats.h) ---
+
+namespace {
+constexpr std::pair<const char*, double> kStatsPercentiles[] = {
+    {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}};
+}
+
+void BankQueueManager::printStats(std::ostream& out)
+{
+    LatencyStats& stats = LatencyStats::instance();
+    const std::unique_ptr<LatencySnapshot> snapshot = stats.snapshot();
+
+    out << "Latency in microseconds since the last reset (recording " << (stats.isEnabled() ? "on" : "off") << "):" << std::endl;
+    bool any = false;
+    for (size_t m = 0; m < snapshot->metrics.size(); ++m) {
+        const LatencyHistogram& h = snapshot->metrics[m];
+        if (h.count == 0) continue;
+        any = true;
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2)
+             << kLatencyMetricNames[m] << ": count " << h.count << ", mean " << h.mean() / 1000;
+        for (const auto& [name, q] : kStatsPercentiles) line << ", " << name << " " << h.percentile(q) / 1000.0;
+        line << ", max " << h.max() / 1000.0;
+        out << line.str() << std::endl;
+    }
+    if (!any) out << "No latencies recorded." << std::endl;
+}
+
+// Percentiles in ns, plus every non-empty bucket as [highest value, count].
+bool BankQueueManager::dumpStats(std::string_view path)
+{
+    const std::unique_ptr<LatencySnapshot> snapshot = LatencyStats::instance().snapshot();
+
+    json j;
+    j["unit"] = "ns";
+    j["metrics"] = json::object();
+    for (size_t m = 0; m < snapshot->metrics.size(); ++m) {
+        const LatencyHistogram& h = snapshot->metrics[m];
+        json metric = {{"count", h.count}, {"sum", h.sum}, {"mean", h.mean()}};
+        for (const auto& [name, q] : kStatsPercentiles) metric[name] = h.percentile(q);
+        metric["max"] = h.max();
+        json buckets = json::array();
+        for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+            if (h.counts[i]) buckets.push_back({LatencyHistogram::bucketUpper(i), h.counts[i]});
+        }
+        metric["buckets"] = std::move(buckets);
+        j["metrics"][kLatencyMetricNames[m]] = std::move(metric);
+    }
+
+    std::ofstream file{std::string(path)};
+    file << j.dump(2) << "\n";
+    return static_cast<bool>(file);
+}
+
+// Applies the request and reports what happened; nothing is formatted here.
+ActionResult BankQueueManager::execute(const ServiceRequest& request)
+{
+    BANKQ_TRACE_SCOPE("execute");
+    Client* client = clientsByHandle[request.client];
+    const int amount = request.amount;
+
+    ActionResult result{};
+    result.event = ResultEvent::SERVED;
+    result.ticket = request.ticket;
+    result.client = request.client;
+    result.amount = amount;
+    result.kind = static_cast<uint8_t>(request.kind);
+
+    switch (request.kind)
+    {
+        case Service::WITHDRAW:
+            if (!client->withdraw(amount)) 
+            {
+                result.code = amount <= 0 ? ResultCode::INVALID_AMOUNT : ResultCode::INSUFFICIENT_FUNDS;
+                break;
+            }
+            ledger.postWithdraw(request.ticket, client->getHandle(), amount);
+            checkLedger(*client);
+            break;
+
+        case Service::DEPOSIT:
+            if (!client->deposit(amount)) 
+            {
+                result.code = amount <= 0 ? ResultCode::INVALID_AMOUNT : ResultCode::BALANCE_OVERFLOW;
+                break;
+            }
+            ledger.postDeposit(request.ticket, client->getHandle(), amount);
+            checkLedger(*client);
+            break;
+
+        case Service::CHECK:
+            result.amount = 0;
+            break;
+
+        case Service::TRANSFER: {
+            result.target = request.target;
+            if (request.target & kRemoteTarget) {
+                result.code = reserveRemoteTransfer(request, *client);
+                break;
+            }
+            Client* to_client = clientsByHandle[request.target];
+            if (!transfer_atomic(*client, *to_client, amount)) 
+            {
+                result.code = amount <= 0 ? ResultCode::INVALID_AMOUNT
+                            : client->getBalance() < amount ? ResultCode::INSUFFICIENT_FUNDS
+                            : ResultCode::BALANCE_OVERFLOW;
+            } else {
+                ledger.postTransfer(request.ticket, client->getHandle(), to_client->getHandle(), amount);
+                checkLedger(*client);
+                checkLedger(*to_client);
+            }
+            result.targetBalanceAfter = to_client->getBalance();
+            break;
+        }
+
+        case Service::MULTI_TRANSFER: {
+            const std::pmr::vector<TransferLeg>& legs = legSlots[request.target];
+            result.target = static_cast<uint32_t>(legs.size());
+            if (!multi_transfer_atomic(*client, legs, legSweep)) 
+            {
+                result.code = ResultCode::REJECTED;
+                break;
+            }
+            ledger.postMultiTransfer(request.ticket, client->getHandle(), legs);
+            checkLedger(*client);
+            for (const TransferLeg& leg : legs) checkLedger(*leg.to);
+            break;
+        }
+
+        default:
+            result.code = ResultCode::REJECTED;
+            break;
     }
+    result.balanceAfter = client->getBalance();
+    return result;
 }
 
 void BankQueueManager::serveNext()
 {
+    BANKQ_TRACE_SCOPE("serve");
     if (!queue.empty())
     {
-        auto qit = queue.begin();              
-        IServiceAction* action = qit->get();   
-    
-        std::string cid = action->getClient()->getId();
+        LatencyStats& stats = LatencyStats::instance();
+        const int64_t servedNs = LatencyStats::now(); // the service model times every serve, stats on or off
+        const int64_t begin = stats.isEnabled() ? servedNs : 0;
+        const ServiceRequest request = queue.popFront();
+        if (begin && request.issuedNs) {
+            stats.recordValue(waitMetric(request.clientType), static_cast<uint64_t>(std::max<int64_t>(begin - request.issuedNs, 0)));
+        }
+        serviceModel.served(currentTeller, static_cast<size_t>(request.kind), servedNs);
+        if (queue.empty()) serviceModel.queueEmptied();
     
-        action->execute();
+        const ActionResult result = execute(request);
+        const bool succeeded = result.code == ResultCode::OK;
+        emit(result);
+        recordHistory(request, succeeded);
+        if (succeeded) recordCredits(request);
     
-        queue.erase(qit);
-        ClientIdToQueueMap.erase(cid);  
+        releaseRequest(request);
+        StatsCounters& counters = StatsCounters::instance();
+        counters.add(typeCounter(StatsCounter::SERVED_VIP, request.clientType));
+        if (!succeeded && request.kind == Service::WITHDRAW) counters.add(StatsCounter::FAILED_WITHDRAWALS);
+        if (!succeeded && (request.kind == Service::TRANSFER || request.kind == Service::MULTI_TRANSFER))
+            counters.add(StatsCounter::FAILED_TRANSFERS);
+        stats.record(serveMetric(request.kind), begin);
     }
     else
     {
-        std::cout << "Bank queue is empty" << std::endl;
+        serviceModel.idle(currentTeller);
+        ActionResult result{};
+        result.event = ResultEvent::QUEUE_EMPTY;
+        emit(result);
+    }
+}
+
+// --- Queue position and wait estimates (see ServiceModel.h) ---
+
+long long BankQueueManager::queuePosition(uint32_t client) const
+{
+    if (client >= clientsByHandle.size() || !queue.queued(client)) return -1;
+    return static_cast<long long>(queue.position(client));
+}
+
+int64_t BankQueueManager::estimateWaitNs(uint32_t client) const
+{
+    if (client >= clientsByHandle.size() || !queue.queued(client)) return -1;
+    return serviceModel.predictWaitNs(queue.aheadByKind(client), LatencyStats::now());
+}
+
+void BankQueueManager::closeTeller(uint32_t teller)
+{
+    serviceModel.closeTeller(teller);
+    if (currentTeller == teller) currentTeller = kConsoleTeller;
+}
+
+void BankQueueManager::printPosition(std::string_view id, bool estimate)
+{
+    Client* c = findClientById(id);
+    if (!c) {
+        replyError() << "Client with ID " << id << " not found!";
+        return;
+    }
+    const long long ahead = queuePosition(c->getHandle());
+    if (ahead < 0) {
+        reply() << "Client '" << id << "' has nothing queued";
+        return;
+    }
+    const int64_t waitNs = estimate ? estimateWaitNs(c->getHandle()) : -1;
+    if (!estimate || waitNs < 0) {
+        reply() << "Client '" << id << "' is #" << ahead + 1 << " in line (" << ahead << " ahead)"
+                << (estimate ? ", no service times measured yet" : "");
+        return;
+    }
+    reply() << "Estimated wait for client '" << id << "': " << waitNs / 1000 << " us (" << ahead << " ahead, "
+            << "tellers serving: " << serviceModel.busyTellers() << ")";
+}
+
+void BankQueueManager::printServiceTimes(std::ostream& out)
+{
+    auto print = [&](const char* name, const ServiceTimeSeries& series) {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2)
+             << name << ": samples " << series.samples() << ", mean " << series.mean() / 1000.0;
+        for (const auto& [label, q] : kStatsPercentiles) line << ", " << label << " " << series.quantile(q) / 1000.0;
+        out << line.str();
+    };
+
+    out << "Service times in microseconds (recent mean and quantiles):" << std::endl;
+    if (serviceModel.overall().samples() == 0) {
+        out << "No service times recorded." << std::endl;
+        return;
+    }
+    for (size_t k = 0; k < kServiceKinds; ++k) {
+        if (serviceModel.byKind(k).samples() == 0) continue;
+        print(service_to_string(static_cast<Service>(k)).c_str(), serviceModel.byKind(k));
+        out << std::endl;
+    }
+    serviceModel.forEachTeller([&](uint32_t teller, const ServiceTimeSeries& series, int64_t pace, bool busy) {
+        const std::string name = "teller " + std::to_string(teller) + (teller == kConsoleTeller ? " (console)" : "");
+        print(name.c_str(), series);
+        out << std::fixed << std::setprecision(2) << ", pace " << static_cast<double>(pace) / ServiceTimeModel::kPaceOne
+            << (busy ? ", serving" : ", idle") << std::defaultfloat << std::endl;
+    });
+}
+
+// --- Cross-branch transfers ---
+
+uint32_t BankQueueManager::remoteTargetHandle(std::string_view id, const RemoteAccount& where)
+{
+    auto it = remoteTargetIndex.find(id);
+    if (it != remoteTargetIndex.end()) return it->second;
+    const uint32_t handle = static_cast<uint32_t>(remoteTargets.size()) | kRemoteTarget;
+    remoteTargets.push_back(RemoteTarget{std::string(id), where}); // deque: earlier ids stay put
+    remoteTargetIndex.emplace(remoteTargets.back().id, handle);
+    return handle;
+}
+
+const std::string& BankQueueManager::targetId(uint32_t target) const
+{
+    if (target & kRemoteTarget) return remoteTargets[target & ~kRemoteTarget].id;
+    return clientsByHandle[target]->getId();
+}
+
+// First half of a transfer to another branch: the amount leaves the client for
+// the clearing account, and stays reserved until the owning branch answers.
+ResultCode BankQueueManager::reserveRemoteTransfer(const ServiceRequest& request, Client& client)
+{
+    if (!router) return ResultCode::REJECTED;
+    if (!client.withdraw(request.amount)) {
+        return request.amount <= 0 ? ResultCode::INVALID_AMOUNT : ResultCode::INSUFFICIENT_FUNDS;
+    }
+    ledger.postTransferOut(request.ticket, client.getHandle(), request.amount);
+    checkLedger(client);
+    const uint64_t transferId = nextTransferId++;
+    remoteInFlight.emplace(transferId, request);
+    router->sendCredit(remoteTargets[request.target & ~kRemoteTarget].where, transferId, request.amount);
+    return ResultCode::OK;
+}
+
+ResultCode BankQueueManager::applyRemoteCredit(uint32_t client, int amount, uint32_t fromBranch)
+{
+    ActionResult result{};
+    result.event = ResultEvent::REMOTE_CREDIT;
+    result.client = client;
+    result.target = fromBranch;
+    result.amount = amount;
+    result.kind = static_cast<uint8_t>(Service::TRANSFER);
+    if (client >= clientsByHandle.size()) return ResultCode::REJECTED;
+
+    Client* c = clientsByHandle[client];
+    if (!c->deposit(amount)) {
+        result.code = amount <= 0 ? ResultCode::INVALID_AMOUNT : ResultCode::BALANCE_OVERFLOW;
+    } else {
+        ledger.postTransferIn(0, client, amount);
+        checkLedger(*c);
+
+        History::Record r{};
+        r.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()).count();
+        r.ticket = 0; // the ticket belongs to the sending branch
+        r.counterparty = History::kNone;
+        r.amount = amount;
+        r.balanceAfter = c->getBalance();
+        r.kind = static_cast<uint8_t>(Service::TRANSFER);
+        r.flags = History::kIncoming;
+        history.append(client, r);
+    }
+    result.balanceAfter = c->getBalance();
+    emit(result);
+    return result.code;
+}
+
+// Second half: a refused credit goes back to the client it was reserved from.
+void BankQueueManager::settleRemoteTransfer(uint64_t transferId, ResultCode code)
+{
+    auto it = remoteInFlight.find(transferId);
+    if (it == remoteInFlight.end()) return;
+    const ServiceRequest request = it->second;
+    remoteInFlight.erase(it);
+
+    Client* c = clientsByHandle[request.client];
+    if (code != ResultCode::OK) {
+        if (!c->deposit(request.amount)) {
+            // Only possible if the client was credited up to INT_MAX meanwhile;
+            // the amount stays on the clearing account.
+            logError() << "Refund of transfer " << transferId << " to '" << c->getId() << "' overflows - left in clearing";
+        } else {
+            ledger.postTransferIn(request.ticket, request.client, request.amount);
+            checkLedger(*c);
+        }
+        recordHistory(request, false);
+        StatsCounters::instance().add(StatsCounter::FAILED_TRANSFERS);
+    }
+
+    ActionResult result{};
+    result.event = ResultEvent::REMOTE_SETTLED;
+    result.code = code;
+    result.ticket = request.ticket;
+    result.client = request.client;
+    result.target = request.target;
+    result.amount = request.amount;
+    result.balanceAfter = c->getBalance();
+    result.kind = static_cast<uint8_t>(Service::TRANSFER);
+    emit(result);
+}
+
+// --- State snapshot ---
+
+json BankQueueManager::saveState() const
+{
+    json state;
+    state["nextTicket"] = arrivalOrder;
+    json& clients = state["clients"] = json::array();
+    for (const Client* c : clientsByHandle) {
+        clients.push_back({{"id", c->getId()}, {"balance", c->getBalance()}, {"clientType", client_type_to_string(c->getType())}});
+    }
+    json& queued = state["queue"] = json::array();
+    queue.forEach([&](const ServiceRequest& request) {
+        json r = {{"ticket", request.ticket},
+                  {"client", clientsByHandle[request.client]->getId()},
+                  {"service", service_to_string(request.kind)},
+                  {"amount", request.amount}};
+        if (request.kind == Service::TRANSFER) r["targetId"] = targetId(request.target);
+        if (request.kind == Service::MULTI_TRANSFER) {
+            json& legs = r["legs"] = json::array();
+            for (const TransferLeg& leg : legSlots[request.target]) legs.push_back({{"targetId", leg.to->getId()}, {"amount", leg.amount}});
+        }
+        queued.push_back(std::move(r));
+    });
+    return state;
+}
+
+bool BankQueueManager::restoreState(const json& state)
+{
+    if (!clientsByHandle.empty()) return false;
+    try {
+        for (const auto& c : state.at("clients")) {
+            addBankClient(c.at("id").get<std::string>(), c.at("balance").get<int>(), c.at("clientType").get<std::string>());
+        }
+        auto resolve = [&](const std::string& id, uint32_t& target) {
+            RemoteAccount where{};
+            if (Client* to = findClientById(id)) target = to->getHandle();
+            else if (router && router->findRemote(id, where)) target = remoteTargetHandle(id, where);
+            else throw std::out_of_range("unknown target client " + id);
+        };
+        for (const auto& r : state.at("queue")) { // forEach order: per type, tickets ascending
+            Client* c = findClientById(r.at("client").get<std::string>());
+            if (!c) throw std::out_of_range("unknown client " + r.at("client").get<std::string>());
+            ServiceRequest request{};
+            request.ticket = r.at("ticket").get<int>();
+            request.client = c->getHandle();
+            request.target = kNoClient;
+            request.amount = r.at("amount").get<int>();
+            request.kind = parseService(r.at("service").get<std::string>());
+            request.clientType = c->getType();
+            request.issuedNs = 0; // waited in another process: not timed
+            if (request.kind == Service::TRANSFER) resolve(r.at("targetId").get<std::string>(), request.target);
+            if (request.kind == Service::MULTI_TRANSFER) {
+                request.target = acquireLegSlot();
+                for (const auto& leg : r.at("legs")) {
+                    Client* to = findClientById(leg.at("targetId").get<std::string>());
+                    if (!to) throw std::out_of_range("unknown target client " + leg.at("targetId").get<std::string>());
+                    legSlots[request.target].push_back(TransferLeg{to, leg.at("amount").get<int>()});
+                }
+            }
+            if (queue.push(request)) StatsCounters::instance().add(typeCounter(StatsCounter::QUEUED_VIP, request.clientType));
+        }
+        arrivalOrder = state.at("nextTicket").get<int>();
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid state snapshot: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Result rendering ---
+
+void BankQueueManager::emit(const ActionResult& result)
+{
+    const bool recordSink = outputSink && outputSink->wantsRecords(); // answered whatever the format
+    if (!recordSink && outputFormat == OutputFormat::NONE) return;
+    if (!recordSink && outputFormat != OutputFormat::BINARY && !outputSink && !Logger::instance().enabled(LogLevel::INFO)) return; // would render to nothing
+    pendingResults.push_back(result);
+    if (pendingResults.size() >= kResultBatch) flushResults();
+}
+
+void BankQueueManager::flushResults()
+{
+    if (pendingResults.empty()) return;
+    BANKQ_TRACE_SCOPE("log");
+    if (outputSink && outputSink->wantsRecords()) {
+        for (const ActionResult& r : pendingResults) outputSink->writeRecord(r);
+        pendingResults.clear();
+        return;
+    }
+    switch (outputFormat) {
+        case OutputFormat::TEXT:
+            for (const ActionResult& r : pendingResults) renderText(r);
+            break;
+        case OutputFormat::JSONL:
+            for (const ActionResult& r : pendingResults) renderJsonl(r);
+            break;
+        case OutputFormat::BINARY:
+            binaryOut.write(reinterpret_cast<const char*>(pendingResults.data()),
+                            static_cast<std::streamsize>(pendingResults.size() * sizeof(ActionResult)));
+            break;
+        default:
+            break;
     }
+    pendingResults.clear();
+}
 
+bool BankQueueManager::setOutputFormat(OutputFormat format, std::string_view path)
+{
+    if (format == OutputFormat::UNKNOWN) return false;
+    flushResults();
+    if (binaryOut.is_open()) binaryOut.close();
+    if (format == OutputFormat::BINARY) {
+        binaryOut.open(std::string(path), std::ios::binary | std::ios::app);
+        if (!binaryOut) return false;
+    }
+    outputFormat = format;
+    return true;
+}
+
+void BankQueueManager::renderText(const ActionResult& r)
+{
+    if (r.event == ResultEvent::QUEUE_EMPTY) {
+        reply() << "Bank queue is empty";
+        return;
+    }
+
+    const bool ok = r.code == ResultCode::OK;
+    const std::string& id = clientsByHandle[r.client]->getId();
+
+    switch (r.event) {
+        case ResultEvent::QUEUED:
+            if (ok) reply() << "Added client '" << id << "' to service queue";
+            else reply() << "Client '" << id << "' already inside the service queue - skipped.";
+            return;
+        case ResultEvent::FAST_LANE:
+            reply() << "Client '" << id << "' have balance of " << r.balanceAfter << "$ (fast lane)";
+            return;
+        case ResultEvent::CANCELED:
+            reply() << "Client '" << id << "' removed from the queue (canceled)";
+            return;
+        case ResultEvent::HOT:
+            reply() << "Client '" << id << "' is hot - balance split into sub-counters";
+            return;
+        case ResultEvent::REMOTE_SETTLED:
+            if (ok) reply() << "Transfer of " << r.amount << "$ from client '" << id << "' to client '"
+                            << targetId(r.target) << "' committed";
+            else reply() << "Transfer of " << r.amount << "$ from client '" << id << "' to client '"
+                         << targetId(r.target) << "' refused (" << result_code_to_string(r.code)
+                         << "), refunded | client new balance: " << r.balanceAfter << "$";
+            return;
+        case ResultEvent::REMOTE_CREDIT:
+            if (ok) reply() << "Received " << r.amount << "$ for client '" << id << "' from branch " << r.target
+                            << " | client new balance: " << r.balanceAfter << "$";
+            else reply() << "Refused " << r.amount << "$ for client '" << id << "' from branch " << r.target
+                         << " (" << result_code_to_string(r.code) << ")";
+            return;
+        default:
+            break;
+    }
 
+    switch (static_cast<Service>(r.kind)) {
+        case Service::WITHDRAW:
+            if (!ok) reply() << "Withdraw failed for client " << id << " (invalid amount or insufficient funds)";
+            else reply() << "Withdrew " << r.amount << "$ by client '" << id
+                           << "' | client new balance: " << r.balanceAfter << "$";
+            break;
+        case Service::DEPOSIT:
+            if (!ok) reply() << "Deposit failed for client " << id << " (invalid amount or overflow)";
+            else reply() << "Deposited " << r.amount << "$ to client '" << id
+                           << "' | client new balance: " << r.balanceAfter << "$";
+            break;
+        case Service::CHECK:
+            reply() << "Client '" << id << "' have balance of " << r.balanceAfter << "$";
+            break;
+        case Service::TRANSFER: {
+            const std::string& to = targetId(r.target);
+            if (!ok) reply() << "Transfer failed: " << id << " -> " << to << " amount=" << r.amount;
+            else if (r.target & kRemoteTarget)
+                reply() << "Reserved " << r.amount << "$ from client '" << id << "' for client '" << to
+                        << "' at branch " << remoteTargets[r.target & ~kRemoteTarget].where.branch
+                        << " | client new balance: " << r.balanceAfter << "$";
+            else reply() << "Transferred " << r.amount << "$ from client '" << id << "' to client '" << to
+                           << "' | new balances: client '" << id << "' : " << r.balanceAfter
+                           << "$ , client '" << to << "' : " << r.targetBalanceAfter << "$ ";
+            break;
+        }
+        case Service::MULTI_TRANSFER:
+            if (!ok) reply() << "Multi-transfer failed: " << id << " legs=" << r.target << " total=" << r.amount;
+            else reply() << "Transferred " << r.amount << "$ from client '" << id << "' in " << r.target
+                           << " legs | client new balance: " << r.balanceAfter << "$";
+            break;
+        default:
+            break;
+    }
 }
 
-void BankQueueManager::cancelClient(const std::string& id)
+// Appends `s` as a JSON string literal.
+static void appendJsonString(LogLine& line, std::string_view s)
 {
+    line << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') line << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) line << ' ';
+        else line << c;
+    }
+    line << '"';
+}
 
-    auto it = ClientIdToQueueMap.find(id);
-    if (it != ClientIdToQueueMap.end()) {
-        queue.erase(it->second); // remove from the queue
-        ClientIdToQueueMap.erase(it); // remove from the map
-        std::cout << "Client '" << id << "' removed from the queue (canceled)" << std::endl;
+void BankQueueManager::renderJsonl(const ActionResult& r)
+{
+    LogLine line = reply();
+    line << "{\"event\":\"" << result_event_to_string(r.event) << '"';
+    if (r.event == ResultEvent::QUEUE_EMPTY) {
+        line << '}';
+        return;
+    }
+
+    line << ",\"client\":";
+    appendJsonString(line, clientsByHandle[r.client]->getId());
+    if (r.event != ResultEvent::HOT) {
+        line << ",\"ticket\":" << r.ticket
+             << ",\"service\":\"" << service_to_string(static_cast<Service>(r.kind)) << '"'
+             << ",\"amount\":" << r.amount
+             << ",\"code\":\"" << result_code_to_string(r.code) << '"';
+    }
+    line << ",\"balance\":" << r.balanceAfter;
+    if ((r.event == ResultEvent::SERVED || r.event == ResultEvent::REMOTE_SETTLED) && static_cast<Service>(r.kind) == Service::TRANSFER) {
+        line << ",\"target\":";
+        appendJsonString(line, targetId(r.target));
+        if (!(r.target & kRemoteTarget)) line << ",\"targetBalance\":" << r.targetBalanceAfter;
+    }
+    if (r.event == ResultEvent::REMOTE_CREDIT) {
+        line << ",\"fromBranch\":" << r.target;
+    }
+    if (r.event == ResultEvent::SERVED && static_cast<Service>(r.kind) == Service::MULTI_TRANSFER) {
+        line << ",\"legs\":" << r.target;
+    }
+    line << '}';
+}
+
+void BankQueueManager::cancelClient(std::string_view id)
+{
+
+    Client* c = findClientById(id);
+    if (c && queue.queued(c->getHandle())) {
+        cancelClient(c->getHandle());
     }
     else
     {
-        std::cout << "No client found with id: '" << id << "' to cancel" << std::endl;
+        flushResults(); // keep this line after the results queued before it
+        reply() << "No client found with id: '" << id << "' to cancel";
     }
 }
 
-void BankQueueManager::runCommand(const std::string& input)
+void BankQueueManager::cancelClient(uint32_t client)
 {
-    std::istringstream iss(input);
-    std::vector<std::string> tokens;
-    std::string word;
-
-    while (iss >> word) {
-        tokens.push_back(word);
+    BANKQ_TRACE_SCOPE("cancel");
+    const int64_t begin = LatencyStats::instance().start();
+    if (client >= clientsByHandle.size() || !queue.queued(client)) {
+        flushResults();
+        reply() << "No queued request for client handle " << client << " to cancel";
+        return;
     }
 
-    if (tokens.empty()) return;
+    const ServiceRequest request = queue.remove(client); // the client's latest request
+    if (queue.empty()) serviceModel.queueEmptied();
+    releaseRequest(request);
+
+    ActionResult result{};
+    result.event = ResultEvent::CANCELED;
+    result.ticket = request.ticket;
+    result.client = request.client;
+    result.amount = request.amount;
+    result.balanceAfter = clientsByHandle[client]->getBalance();
+    result.kind = static_cast<uint8_t>(request.kind);
+    emit(result);
+    StatsCounters::instance().add(typeCounter(StatsCounter::CANCELED_VIP, request.clientType));
+    LatencyStats::instance().record(LatencyMetric::CANCEL, begin);
+}
+
+void BankQueueManager::runCommand(std::string_view input)
+{
+    runCommand(parseCommandLine(input));
+}
 
-    Command cmd = parseCommand(tokens[0]);
+void BankQueueManager::runCommand(const ParsedCommand& p)
+{
+    BANKQ_TRACE_SCOPE("command");
+    const CommandTokens& tokens = p.args;
 
-    std::string id, service, targetId;
-    int amount = -1;
+    if (tokens.empty()) return;
 
-    switch (cmd) 
+    // Results of add / cancel / serve stay pending so scripts render them in
+    // batches. Anything printed directly must not overtake them: usage errors
+    // go through the log after the pending results, and reports printed with
+    // std::cout also wait for the log to drain.
+    if (p.status != ParseStatus::OK) flushResults();
+    if (p.command != Command::ADD && p.command != Command::CANCEL && p.command != Command::SERVE) {
+        flushResults();
+        logFlush();
+    }
+
+    switch (p.command) 
     {
         case Command::ADD:
-            if (tokens.size() < 3 || tokens.size() > 5) 
+            if (p.service == Service::MULTI_TRANSFER)
             {
-                std::cout << "Invalid usage. Use: add [id] [service] [(optional)amount] [(optional)target id] " << std::endl;
+                if (p.status == ParseStatus::USAGE) 
+                {
+                    reply() << "Invalid usage. Use: add [id] multitransfer [amount] [target id] [amount] [target id] ...";
+                    break;
+                }
+                if (p.status == ParseStatus::BAD_NUMBER)
+                {
+                    reply() << "Invalid input. Please enter a valid params. add [id] multitransfer [amount] [target id] ...";
+                    break;
+                }
+
+                std::pmr::vector<std::pair<int, std::string_view>>& legs = legArgs; // views into the command line
+                legs.clear();
+                Tokenizer legTokens(p.legs);
+                std::string_view amount, target;
+                while (legTokens.next(amount) && legTokens.next(target)) {
+                    int value = 0;
+                    parseNumber(amount, value); // validated by parseCommandLine
+                    legs.emplace_back(value, target);
+                }
+                createMultiTransferRequest(p.id, legs);
                 break;
             }
 
-            try
+            if (p.status == ParseStatus::USAGE) 
             {
-                id = tokens[1];
-                service = tokens[2];
-                
-                if (tokens.size() >= 4) {
-                    amount = std::stoi(tokens[3]);
-                }
+                reply() << "Invalid usage. Use: add [id] [service] [(optional)amount] [(optional)target id] ";
+                break;
+            }
+            if (p.status == ParseStatus::BAD_NUMBER)
+            {
+                reply() << "Invalid input. Please enter a valid params. add [id (1 word string)] [service (1 word string)] [(optional)amount] [(optional)target id]";
+                break;
+            }
 
-                if (tokens.size() == 5) {
-                    targetId = tokens[4];
-                }
+            addRequest(p.id, p.service, p.amount, p.targetId);
+            break;
 
-                createRequestFactory(id,service,amount,targetId);
+        case Command::CANCEL:
+            if (p.status != ParseStatus::OK) 
+            {
+                reply() << "Invalid usage. Use: cancel [id]";
+                break;
             }
-            catch (const std::exception& e) 
+            cancelClient(p.id);
+            break;
+
+        case Command::SERVE:
+            serveNext();
+            break;
+
+        case Command::PRINTQ:
+            printQueue();
+            break;
+
+        case Command::PRINTC:
+            printBankClients();
+            break;
+
+        case Command::LEDGER:
+            if (tokens.size() != 2) 
             {
-                std::cout << "Invalid input. Please enter a valid params. add [id (1 word string)] [service (1 word string)] [(optional)amount] [(optional)target id]" << std::endl;
+                std::cout << "Invalid usage. Use: ledger [id]" << std::endl;
+                break;
             }
+            printLedger(tokens[1]);
             break;
 
-        case Command::CANCEL:
+        case Command::HISTORY:
+            printHistory(tokens);
+            break;
+
+        case Command::POSITION:
+        case Command::ESTIMATE:
             if (tokens.size() != 2) 
             {
-                std::cout << "Invalid usage. Use: cancel [id]" << std::endl;
+                reply() << "Invalid usage. Use: " << tokens[0] << " [id]";
                 break;
             }
+            printPosition(tokens[1], p.command == Command::ESTIMATE);
+            break;
+
+        case Command::SERVICETIMES:
+            printServiceTimes();
+            break;
 
-            try
+        case Command::FASTLANE:
+            if (tokens.size() == 1) 
             {
-                id = tokens[1];
-                cancelClient(id);
+                for (ClientType type : {ClientType::VIP, ClientType::BUSINESS, ClientType::REGULAR}) {
+                    std::cout << "Check fast lane for " << client_type_to_string(type) << ": "
+                              << (isCheckFastLane(type) ? "on" : "off") << std::endl;
+                }
+                break;
             }
-            catch (const std::exception& e) 
+            if (tokens.size() != 3 || parseClientType(tokens[1]) == ClientType::UNKNOWN ||
+                (tokens[2] != "on" && tokens[2] != "off")) 
             {
-                std::cout << "Invalid input. Please enter a valid params. cancel [id (1 word string)]" << std::endl;
+                std::cout << "Invalid usage. Use: fastlane [(optional) REGULAR|VIP|BUSINESS] [on|off]" << std::endl;
+                break;
             }
+            setCheckFastLane(parseClientType(tokens[1]), tokens[2] == "on");
+            std::cout << "Check fast lane for " << tokens[1] << " is " << tokens[2] << std::endl;
             break;
 
-        case Command::SERVE:
-            serveNext();
+        case Command::VERBOSITY:
+            if (tokens.size() == 1) 
+            {
+                std::cout << "Verbosity: " << log_level_to_string(Logger::instance().getLevel()) << std::endl;
+                break;
+            }
+            if (tokens.size() != 2 || (tokens[1] != "silent" && tokens[1] != "error" &&
+                                       tokens[1] != "info" && tokens[1] != "debug")) 
+            {
+                std::cout << "Invalid usage. Use: verbosity [(optional) silent|error|info|debug]" << std::endl;
+                break;
+            }
+            Logger::instance().setLevel(parseLogLevel(tokens[1]));
+            std::cout << "Verbosity set to " << tokens[1] << std::endl;
             break;
 
-        case Command::PRINTQ:
-            printQueue();
+        case Command::OUTPUT:
+            if (tokens.size() == 1) 
+            {
+                const char* names[] = {"text", "jsonl", "binary", "none"};
+                std::cout << "Output format: " << names[static_cast<size_t>(outputFormat)] << std::endl;
+                break;
+            }
+            if (parseOutputFormat(tokens[1]) == OutputFormat::UNKNOWN ||
+                (parseOutputFormat(tokens[1]) == OutputFormat::BINARY) != (tokens.size() == 3) || tokens.size() > 3) 
+            {
+                std::cout << "Invalid usage. Use: output [(optional) text|jsonl|none|binary [file]]" << std::endl;
+                break;
+            }
+            if (!setOutputFormat(parseOutputFormat(tokens[1]), tokens[2]))
+            {
+                std::cout << "Could not open '" << tokens[2] << "' for writing" << std::endl;
+                break;
+            }
+            std::cout << "Output format set to " << tokens[1] << std::endl;
             break;
 
-        case Command::PRINTC:
-            printBankClients();
+        case Command::STATS:
+            if (tokens.size() == 1)
+            {
+                printStats();
+                break;
+            }
+            if (tokens.size() == 2 && (tokens[1] == "on" || tokens[1] == "off"))
+            {
+                LatencyStats::instance().setEnabled(tokens[1] == "on");
+                std::cout << "Latency recording is " << tokens[1] << std::endl;
+                break;
+            }
+            if (tokens.size() == 2 && tokens[1] == "reset")
+            {
+                LatencyStats::instance().reset();
+                std::cout << "Latency statistics reset" << std::endl;
+                break;
+            }
+            if (tokens.size() != 3 || tokens[1] != "dump")
+            {
+                std::cout << "Invalid usage. Use: stats [(optional) on|off|reset|dump [file]]" << std::endl;
+                break;
+            }
+            if (!dumpStats(tokens[2]))
+            {
+                std::cout << "Could not write '" << tokens[2] << "'" << std::endl;
+                break;
+            }
+            std::cout << "Latency statistics written to " << tokens[2] << std::endl;
+            break;
+
+        case Command::TRACE:
+            if (!kTraceCompiled)
+            {
+                std::cout << "Tracing is not compiled in (build with -DBANKQ_TRACE)" << std::endl;
+                break;
+            }
+            if (tokens.size() == 2 && tokens[1] == "clear")
+            {
+                traceClear();
+                std::cout << "Trace cleared" << std::endl;
+                break;
+            }
+            if (tokens.size() != 3 || tokens[1] != "dump")
+            {
+                std::cout << "Invalid usage. Use: trace [dump [file] | clear]" << std::endl;
+                break;
+            }
+            if (!traceDump(tokens[2]))
+            {
+                std::cout << "Could not write '" << tokens[2] << "'" << std::endl;
+                break;
+            }
+            std::cout << "Trace written to " << tokens[2] << " (open it in Perfetto or chrome://tracing)" << std::endl;
             break;
 
         case Command::EXIT:
+            setOutputFormat(OutputFormat::NONE, ""); // closes a binary output file
             std::cout << "Goodbye!\n";
             exit(0);
 
         case Command::UNKNOWN:
         default:
-            std::cout << "Unknown command: " << tokens[0] << "\n";
+            reply() << "Unknown command: " << tokens[0];
             break;
     }
-}
 
-
-
-int main() {
-
-    BankQueueManager manager;
-    manager.LoadPreClientsAndQueue();
-    std::cout << std::endl;
-    manager.printBankClients();
-    std::cout << std::endl;
-    manager.printQueue();
-    std::cout << std::endl;
-
-    std::string input;
-    
-    std::cout << "Please insert one of the following commands:" << std::endl;
-    std::cout << "add [id (1 word string)] [service (1 word string)] [(optional)amount] [(optional)target id]" << std::endl;
-    std::cout << "cancel [id (1 word string)]" << std::endl;
-    std::cout << "serve" << std::endl;
-    std::cout << "printq (print queue)" << std::endl;
-    std::cout << "printc (print bank clients)" << std::endl;
-    std::cout << "exit" << std::endl;
-    std::cout << std::endl;
-
-    while (true) {
-            std::cout << std::endl;
-            std::cout << ">> ";
-            std::getline(std::cin, input); // input from user
-        
-            manager.runCommand(input);
-        
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-    return 0;
+    if (p.command != Command::ADD && p.command != Command::CANCEL && p.command != Command::SERVE)
+        std::cout << std::flush; // before the log writes anything after it
 }
@@ -1,14 +1,29 @@
+#pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
 #include <set>
+#include <memory_resource>
+#include <array>
 #include <vector>
-#include <sstream>
+#include <deque>
 #include <algorithm>
 #include <unordered_map>
 #include <fstream>
+#include <climits>
+#include <cassert>
 #include "include/json.hpp"
+#include "Ledger.h"
+#include "History.h"
+#include "HotAccount.h"
+#include "Scheduler.h"
+#include "ServiceModel.h"
+#include "CommandParser.h"
+#include "Log.h"
+#include "Results.h"
+#include "Stats.h"
 using json = nlohmann::json;
 
 enum class ClientType {
@@ -24,6 +39,16 @@ enum class Command {
     SERVE,
     PRINTQ,
     PRINTC,
+    LEDGER,
+    HISTORY,
+    FASTLANE,
+    VERBOSITY,
+    OUTPUT,
+    STATS,
+    TRACE,
+    POSITION,
+    ESTIMATE,
+    SERVICETIMES,
     EXIT,
     UNKNOWN
 };
@@ -33,6 +58,7 @@ enum class Service { // todo - write in capital letters!
     WITHDRAW ,
     CHECK ,
     TRANSFER,
+    MULTI_TRANSFER,
     UNKNOWN
 };
 
@@ -43,19 +69,33 @@ enum class ClientPriority {
     VIP = 3
 };
 
-ClientType parseClientType(const std::string& str) {
+inline ClientType parseClientType(std::string_view str) {
     if (str == "REGULAR") return ClientType::REGULAR;
     if (str == "VIP") return ClientType::VIP;
     if (str == "BUSINESS") return ClientType::BUSINESS;
     return ClientType::UNKNOWN;
 }
 
-Service parseService(const std::string& service) {
-    if (service == "deposit")    return Service::DEPOSIT;
-    if (service == "withdraw")    return Service::WITHDRAW;
-    if (service == "check")  return Service::CHECK;
-    if (service == "transfer")  return Service::TRANSFER;
-    return Service::UNKNOWN;
+inline std::string client_type_to_string(ClientType t) {
+    switch (t) {
+        case ClientType::REGULAR:  return "REGULAR";
+        case ClientType::VIP:      return "VIP";
+        case ClientType::BUSINESS: return "BUSINESS";
+        default:                   return "UNKNOWN";
+    }
+}
+
+inline constexpr KeywordTable<Service, 5> serviceKeywords({
+    {"deposit", Service::DEPOSIT},
+    {"withdraw", Service::WITHDRAW},
+    {"check", Service::CHECK},
+    {"transfer", Service::TRANSFER},
+    {"multitransfer", Service::MULTI_TRANSFER},
+}, Service::UNKNOWN);
+static_assert(serviceKeywords.isPerfect(), "service keywords need a collision-free hash");
+
+inline Service parseService(std::string_view service) {
+    return serviceKeywords.lookup(service);
 }
 
 inline std::string service_to_string(Service k) {
@@ -64,18 +104,105 @@ inline std::string service_to_string(Service k) {
         case Service::DEPOSIT:  return "deposit";
         case Service::CHECK:    return "check";
         case Service::TRANSFER: return "transfer";
+        case Service::MULTI_TRANSFER: return "multitransfer";
+        case Service::UNKNOWN: break;
     }
     return "unknown";
 }
 
-Command parseCommand(const std::string& cmd) {
-    if (cmd == "add")    return Command::ADD;
-    if (cmd == "cancel")    return Command::CANCEL;
-    if (cmd == "serve")  return Command::SERVE;
-    if (cmd == "printq")  return Command::PRINTQ;
-    if (cmd == "printc")  return Command::PRINTC;
-    if (cmd == "exit")   return Command::EXIT;
-    return Command::UNKNOWN;
+inline constexpr KeywordTable<Command, 16> commandKeywords({
+    {"add", Command::ADD},
+    {"cancel", Command::CANCEL},
+    {"serve", Command::SERVE},
+    {"printq", Command::PRINTQ},
+    {"printc", Command::PRINTC},
+    {"ledger", Command::LEDGER},
+    {"history", Command::HISTORY},
+    {"fastlane", Command::FASTLANE},
+    {"verbosity", Command::VERBOSITY},
+    {"output", Command::OUTPUT},
+    {"stats", Command::STATS},
+    {"trace", Command::TRACE},
+    {"position", Command::POSITION},
+    {"estimate", Command::ESTIMATE},
+    {"servicetimes", Command::SERVICETIMES},
+    {"exit", Command::EXIT},
+}, Command::UNKNOWN);
+static_assert(commandKeywords.isPerfect(), "command keywords need a collision-free hash");
+
+inline Command parseCommand(std::string_view cmd) {
+    return commandKeywords.lookup(cmd);
+}
+
+enum class ParseStatus {
+    OK,
+    USAGE,       // wrong number of arguments
+    BAD_NUMBER   // an amount is not an integer
+};
+
+// One command line, split and validated without allocating. Views point into
+// the input line, which must outlive the result.
+struct ParsedCommand {
+    Command command = Command::UNKNOWN;
+    ParseStatus status = ParseStatus::OK;
+    CommandTokens args;           // args[0] is the command keyword
+    std::string_view id;          // ADD, CANCEL
+    Service service = Service::UNKNOWN;
+    int amount = -1;
+    std::string_view targetId;
+    std::string_view legs;        // MULTI_TRANSFER: "<amount> <target id> ..."
+
+    explicit ParsedCommand(std::string_view line) : args(line) {}
+};
+
+inline ParsedCommand parseCommandLine(std::string_view line) {
+    BANKQ_TRACE_SCOPE("parse");
+    ParsedCommand p(line);
+    if (p.args.empty()) return p;
+    p.command = parseCommand(p.args[0]);
+
+    switch (p.command) {
+        case Command::ADD:
+            if (p.args.size() < 3) {
+                p.status = ParseStatus::USAGE;
+                break;
+            }
+            p.id = p.args[1];
+            p.service = parseService(p.args[2]);
+            if (p.service == Service::MULTI_TRANSFER) {
+                if (p.args.size() < 5 || p.args.size() % 2 == 0) {
+                    p.status = ParseStatus::USAGE;
+                    break;
+                }
+                p.legs = p.args.restFrom(3);
+                Tokenizer legs(p.legs);
+                std::string_view amount, target;
+                while (legs.next(amount) && legs.next(target)) {
+                    int value;
+                    if (!parseNumber(amount, value)) {
+                        p.status = ParseStatus::BAD_NUMBER;
+                        break;
+                    }
+                }
+                break;
+            }
+            if (p.args.size() > 5) {
+                p.status = ParseStatus::USAGE;
+                break;
+            }
+            if (p.args.size() >= 4 && !parseNumber(p.args[3], p.amount)) p.status = ParseStatus::BAD_NUMBER;
+            if (p.args.size() == 5) p.targetId = p.args[4];
+            break;
+
+        case Command::CANCEL:
+            if (p.args.size() != 2) p.status = ParseStatus::USAGE;
+            else p.id = p.args[1];
+            break;
+
+        default:
+            break; // remaining commands read p.args themselves
+    }
+    return p;
 }
 
 class Client {
@@ -83,8 +210,15 @@ class Client {
         Client(std::string id_, int balance_)
             : id(std::move(id_)), balance(balance_) {}
 
-        std::string getId() const { return id; }
-        int getBalance() const { return balance; }
+        const std::string& getId() const { return id; }
+        int getBalance() const
+        {
+            return split ? static_cast<int>(balance + split->pending()) : balance;
+        }
+
+        // Dense index assigned at registration, used by the ledger.
+        uint32_t getHandle() const { return handle; }
+        void setHandle(uint32_t h) { handle = h; }
         virtual ClientType getType() const = 0;
         virtual ~Client() = default;
 
@@ -101,22 +235,77 @@ class Client {
         bool deposit(int amount) 
         {
             if (amount <= 0) return false;
-            if (balance > INT_MAX - amount) return false; // overflow guard
+            if (creditSplit(amount)) return true;
+            if (split) fold();
+            if (balance > INT_MAX - held - amount) return false; // overflow guard, held room excluded
             balance += amount;
             return true;
         }
 
+        // Room below INT_MAX that credits may still use.
+        long long creditRoom() const { return static_cast<long long>(INT_MAX) - getBalance() - held; }
+
+        // Sets aside room for a credit promised but not applied yet (a
+        // prepared remote transfer); other credits cannot use it. The holder
+        // releases it right before applying the credit, or when it is dropped.
+        bool holdCredit(int amount)
+        {
+            if (amount <= 0) return false;
+            if (split) fold();
+            if (balance > INT_MAX - held - amount) return false;
+            held += amount;
+            if (split) split->resetBudgets(balance + held);
+            return true;
+        }
+
+        void releaseCredit(int amount) { held -= amount; }
+
         bool withdraw(int amount) 
         {
             if (amount <= 0) return false;
+            if (split) fold();
             if (balance < amount) return false; 
             balance -= amount;
             return true;
         }
 
+        // --- Hot account split (see HotAccount.h) ---
+        bool isSplit() const { return split != nullptr; }
+
+        void enableSplit(size_t slots = SplitBalance::defaultSlotCount())
+        {
+            if (split) return;
+            split = std::make_unique<SplitBalance>(slots);
+            split->resetBudgets(balance + held);
+        }
+
+        void disableSplit()
+        {
+            if (!split) return;
+            fold();
+            split.reset();
+        }
+
+        // Lock-free credit into the caller's sub-counter. Only succeeds for a
+        // split account whose slot still has budget; safe to call from any thread.
+        bool creditSplit(int amount)
+        {
+            return split && amount > 0 && split->tryAdd(amount);
+        }
+
     protected:
         std::string id;
         int balance;
+        int held = 0; // see holdCredit()
+        uint32_t handle = 0;
+        std::unique_ptr<SplitBalance> split; // set while the account is hot
+
+        // Moves the sub-counters into the base balance.
+        void fold()
+        {
+            balance += static_cast<int>(split->drain());
+            split->resetBudgets(balance + held);
+        }
 
 };
 
@@ -130,6 +319,46 @@ inline bool transfer_atomic(Client& from, Client& to, int amount) {
     return true;
 }
 
+struct TransferLeg {
+    Client* to;
+    int amount;
+};
+
+// All-or-nothing transfer of every leg from one source.
+// Legs are validated in one sweep ordered by target handle (repeated targets are
+// summed), so funds are checked once against the total and no leg can fail
+// after the first balance has been touched. `sweep` is the caller's scratch
+// buffer for the sorted copy, so a warm one does not allocate.
+inline bool multi_transfer_atomic(Client& from, const std::pmr::vector<TransferLeg>& legs,
+                                  std::pmr::vector<TransferLeg>& sweep) {
+    if (legs.empty()) return false;
+
+    sweep.assign(legs.begin(), legs.end());
+    std::sort(sweep.begin(), sweep.end(), [](const TransferLeg& a, const TransferLeg& b) {
+        return a.to->getHandle() < b.to->getHandle();
+    });
+
+    long long total = 0;
+    for (size_t i = 0; i < sweep.size();) {
+        Client* to = sweep[i].to;
+        if (to == &from) return false;
+
+        long long credited = 0;
+        for (; i < sweep.size() && sweep[i].to == to; ++i) {
+            if (sweep[i].amount <= 0) return false;
+            credited += sweep[i].amount;
+        }
+        if (credited > to->creditRoom()) return false; // overflow guard
+        total += credited;
+    }
+    if (total > from.getBalance()) return false;
+
+    if (!from.withdraw(static_cast<int>(total))) return false; // nothing credited yet
+    for (const TransferLeg& leg : legs)
+        leg.to->deposit(leg.amount);
+    return true;
+}
+
 class RegularClient : public Client {
     public:
         RegularClient(std::string id_, int balance_)
@@ -160,172 +389,239 @@ class BusinessClient : public Client {
         }
 };
 
-class IServiceAction {
-protected:
-    std::string id;
-    Client* client;
-    int arrivalTicketNumber;
-
-public:
-    IServiceAction(const std::string& id, Client* client, int arrivalTicketNumber)
-        : id(id), client(client), arrivalTicketNumber(arrivalTicketNumber) {}
-
-    Client* getClient() const {
-        return client;
-    }
-
-    virtual Service getServiceKind() const noexcept = 0;
-
-    int getArrivalTicketNumber() const {
-        return arrivalTicketNumber;
-    }
-
-    virtual void execute() = 0;
-    virtual ~IServiceAction() = default;
+// --- Service request ---
+// A queued request is a plain 32-byte value: no heap object, no virtual call
+// and no copy of the client id. Clients are referred to by handle and
+// resolved by BankQueueManager when the request is served.
+struct ServiceRequest {
+    int ticket;              // arrival ticket
+    uint32_t client;         // client handle
+    uint32_t target;         // TRANSFER: target handle, MULTI_TRANSFER: legs slot
+    int amount;              // MULTI_TRANSFER: total of all legs
+    Service kind;
+    ClientType clientType;   // cached so ordering never touches the client
+    int64_t issuedNs;        // steady clock when the ticket was issued, 0 if not timed (Stats.h)
 };
+static_assert(sizeof(ServiceRequest) <= 32, "ServiceRequest must stay compact");
 
-// --- Withdraw ---
-class WithdrawAction : public IServiceAction {
-    int amount;
-
-public:
-    WithdrawAction(const std::string& id, int amt, Client* client, int arrivalTicketNumber)
-        : IServiceAction(id, client, arrivalTicketNumber), amount(amt) {}
-
-    Service getServiceKind() const noexcept override { return Service::WITHDRAW; }
-
-    void execute() override 
+struct ServiceRequestComparator {
+    bool operator()(const ServiceRequest& a, const ServiceRequest& b) const
     {
-        if (!client->withdraw(amount)) 
-        {
-            std::cout << "Withdraw failed for client " << client->getId()
-                      << " (invalid amount or insufficient funds)\n";
-            return;
-        }
-        std::cout << "Withdrew " << amount << "$ by client '" << client->getId()
-                  << "' | client new balance: " << client->getBalance() << "$\n";
-    }
-};
+        if (a.clientType != b.clientType)
+            return a.clientType < b.clientType; // VIP (0) < BUSINESS (1) < REGULAR (2)
 
-// --- Deposit ---
-class DepositAction : public IServiceAction {
-    int amount;
-
-public:
-    DepositAction(const std::string& id, int amt, Client* client, int arrivalTicketNumber)
-        : IServiceAction(id, client, arrivalTicketNumber), amount(amt) {}
-
-    Service getServiceKind() const noexcept override { return Service::DEPOSIT; }
-
-    void execute() override 
-    {
-        if (!client->deposit(amount)) 
-        {
-            std::cout << "Deposit failed for client " << client->getId()
-                      << " (invalid amount or overflow)\n";
-            return;
-        }
-        std::cout << "Deposited " << amount << "$ to client '" << client->getId()
-                  << "' | client new balance: " << client->getBalance() << "$\n";
+        // סוגים שווים – השווה לפי arrivalTicketNumber
+        return a.ticket < b.ticket;
     }
 };
 
-// --- Check ---
-class CheckAction : public IServiceAction {
-public:
-    CheckAction(const std::string& id, Client* client, int arrivalTicketNumber)
-        : IServiceAction(id, client, arrivalTicketNumber) {}
-
-    Service getServiceKind() const noexcept override { return Service::CHECK; }
-
-    void execute() override {
-        std::cout << "Client '" << client->getId()
-                  << "' have balance of " << client->getBalance() << "$\n";
-    }
+// --- Cross-branch transfers ---
+// A manager running as one branch of a BranchEngine (BranchEngine.h) may
+// name accounts of other branches as transfer targets. Such a target gets a
+// request target handle with kRemoteTarget set. Serving the transfer
+// reserves the amount (debits the source) and hands it to the router; the
+// owning branch credits it and the router reports back through
+// settleRemoteTransfer(), which commits or refunds the reservation.
+struct RemoteAccount {
+    uint32_t branch;
+    uint32_t handle;   // the router's name for the account (BranchEngine: client handle in that branch's manager)
 };
 
-// --- Transfer ---
-class TransferAction : public IServiceAction {
-    std::string targetId;
-    Client* to_client;
-    int amount;
-
-public:
-    TransferAction(const std::string& id,
-                   int amt,
-                   Client* client,
-                   const std::string& target,
-                   Client* to_client,
-                   int arrivalTicketNumber)
-        : IServiceAction(id, client, arrivalTicketNumber),
-          targetId(target), to_client(to_client), amount(amt) {}
+class TransferRouter
+{
+    public:
+        virtual ~TransferRouter() = default;
 
-    Service getServiceKind() const noexcept override { return Service::TRANSFER; }
+        // Where `id` lives when it is not a client of this manager; false if
+        // no branch has it.
+        virtual bool findRemote(std::string_view id, RemoteAccount& where) const = 0;
 
-    void execute() override 
-    {
-        if (!transfer_atomic(*client, *to_client, amount)) 
-        {
-            std::cout << "Transfer failed: " << client->getId()
-                      << " -> " << to_client->getId()
-                      << " amount=" << amount << "\n";
-            return;
-        }
-        std::cout << "Transferred " << amount << "$ from client '" << client->getId()
-                  << "' to client '" << to_client->getId()
-                  << "' | new balances: client '" << client->getId() << "' : " << client->getBalance()
-                  << "$ , client '" << to_client->getId() << "' : " << to_client->getBalance() << "$ \n";
-    }
+        // Delivers a reserved transfer. Called on the manager's thread.
+        virtual void sendCredit(const RemoteAccount& where, uint64_t transferId, int amount) = 0;
 };
 
-struct IServiceActionComparator {
-    bool operator()(const std::unique_ptr<IServiceAction>& a,
-                    const std::unique_ptr<IServiceAction>& b) const
-    {
-        if (!a || !b) return a < b;
-
-        Client* ca = a->getClient();
-        Client* cb = b->getClient();
-
-        if (!ca || !cb) return ca < cb;
-
-        ClientType ta = ca->getType();
-        ClientType tb = cb->getType();
-
-        if (ta != tb)
-            return ta < tb; // VIP (0) < BUSINESS (1) < REGULAR (2)
-
-        // סוגים שווים – השווה לפי arrivalTicketNumber
-        return a->getArrivalTicketNumber() < b->getArrivalTicketNumber();
-    }
-};
+inline constexpr size_t kServiceKinds = static_cast<size_t>(Service::UNKNOWN);
 
-using QueueIt = std::set<std::unique_ptr<IServiceAction>, IServiceActionComparator>::iterator;
+// Nodes come from the manager's memory resource (see BankQueueManager()).
+using RequestScheduler = Scheduler<ServiceRequest, ServiceRequestComparator, 3, kServiceKinds>;
+using ServiceTimeModel = ServiceModel<kServiceKinds>;
 
 class BankQueueManager 
 {
     public:
-        void runCommand(const std::string& input); 
+        // Containers allocate from a pool owned by this manager. The pool is
+        // unsynchronized: a manager is driven by one thread, so each shard /
+        // thread gets its own manager and its own pool.
+        BankQueueManager() : BankQueueManager(nullptr) {}
+
+        // Containers allocate from `resource` instead (e.g. a pool shared by
+        // several structures of one shard, or std::pmr::new_delete_resource()
+        // for plain global allocation). It must outlive the manager.
+        explicit BankQueueManager(std::pmr::memory_resource* resource,
+                                  SchedulerBackend scheduler = SchedulerBackend::ORDERED_SET)
+            : resource(resource ? resource : &ownedPool), queue(scheduler, this->resource) {}
+
+        // Same, with the queue kept by `scheduler` (see Scheduler.h).
+        explicit BankQueueManager(SchedulerBackend scheduler) : BankQueueManager(nullptr, scheduler) {}
+
+        void runCommand(std::string_view input); // leaves results pending, see flushResults()
+        void runCommand(const ParsedCommand& command);
         void LoadPreClientsAndQueue();
-        void printBankClients();
-        void printQueue();
+        void printBankClients(std::ostream& out = std::cout);
+        void printQueue(std::ostream& out = std::cout);
+        void printLedger(std::string_view id);
+        void printHistory(const CommandTokens& args);
+        void printPosition(std::string_view id, bool estimate);
+        void printServiceTimes(std::ostream& out = std::cout);
+        void printStats(std::ostream& out = std::cout);
+        bool dumpStats(std::string_view path);
+        void setCheckFastLane(ClientType type, bool enabled);
+        bool isCheckFastLane(ClientType type) const;
+
+        // Programmatic API (used by the CLI and by the benchmarks).
+        bool addBankClient(const std::string& id, int balance, const std::string& typeStr);
+        int addRequest(std::string_view id, Service service, int amount, std::string_view targetId);
+        void serveNext();
+        void cancelClient(std::string_view id);
+
+        // Same, by client handle (interned id), for callers that resolved the
+        // id once up front. `target` is only read for TRANSFER.
+        static constexpr uint32_t kNoClient = UINT32_MAX;
+        uint32_t findClientHandle(std::string_view id);
+        int addRequest(uint32_t client, Service service, int amount, uint32_t target = kNoClient);
+        void cancelClient(uint32_t client);
+        size_t queueSize() const { return queue.size(); }
+        // Requests served before the client's latest queued one (0: it is
+        // next), -1 if it has nothing queued. O(log n) (Scheduler.h).
+        long long queuePosition(uint32_t client) const;
+        // Expected ns until a teller takes that request, from the service
+        // times of the requests ahead by kind and the busy tellers
+        // (ServiceModel.h). -1 if nothing is queued or no service time was
+        // measured yet (every serve is timed, with latency stats on or off).
+        int64_t estimateWaitNs(uint32_t client) const;
+
+        // Tellers taking `serve`: the console is kConsoleTeller; a front end
+        // opens one per session and makes it current while that session's
+        // commands run. Service times are recorded per teller.
+        static constexpr uint32_t kConsoleTeller = ServiceTimeModel::kConsoleTeller;
+        uint32_t openTeller() { return serviceModel.openTeller(); }
+        void closeTeller(uint32_t teller);
+        void setTeller(uint32_t teller) { currentTeller = teller; }
+        const ServiceTimeModel& serviceTimes() const { return serviceModel; }
+        size_t clientCount() const { return clientsByHandle.size(); }
+        int clientBalance(uint32_t client) const { return clientsByHandle[client]->getBalance(); }
+        SchedulerBackend schedulerBackend() const { return queue.backend(); }
+
+        // Results are rendered in batches of kResultBatch, before any command
+        // that prints directly, or when flushResults() is called (the CLI does
+        // so before every prompt). A BINARY format
+        // appends raw ActionResult records to `path`.
+        bool setOutputFormat(OutputFormat format, std::string_view path = {});
+        OutputFormat getOutputFormat() const { return outputFormat; }
+        void flushResults();
+
+        // Result lines and per-command errors go to `sink` instead of the log
+        // (nullptr restores the log). Pending results are flushed to the
+        // previous destination first.
+        void setOutputSink(OutputSink* sink)
+        {
+            flushResults();
+            outputSink = sink;
+        }
+
+        // Cross-branch transfers (see TransferRouter). The router must outlive
+        // the manager; nullptr disables them.
+        static constexpr uint32_t kRemoteTarget = 0x80000000u;
+        void setTransferRouter(TransferRouter* r) { router = r; }
+        // Credits a transfer reserved by branch `fromBranch`; returns OK or
+        // why it was refused (the sender then refunds it).
+        ResultCode applyRemoteCredit(uint32_t client, int amount, uint32_t fromBranch);
+        // Room for a credit that is promised before it is applied (see
+        // Client::holdCredit); false if it would not fit below INT_MAX.
+        bool holdRemoteCredit(uint32_t client, int amount) { return clientsByHandle[client]->holdCredit(amount); }
+        void releaseRemoteCredit(uint32_t client, int amount) { clientsByHandle[client]->releaseCredit(amount); }
+        void settleRemoteTransfer(uint64_t transferId, ResultCode code);
+        size_t remoteTransfersPending() const { return remoteInFlight.size(); }
+        void setHistorySpillPath(std::string path) { history.setSpillPath(std::move(path)); }
+
+        // Clients, balances, queued requests and the ticket counter, for
+        // replicas (cluster/RaftReplica.h). Journals are left out: a restored
+        // manager opens its ledger with the snapshot balances.
+        json saveState() const;
+        // Only into a manager without clients; false (reason on stderr) on a
+        // malformed state.
+        bool restoreState(const json& state);
         
         private: 
         
-        std::unordered_map<std::string, std::unique_ptr<Client>> clientsMap;
-        std::set<std::unique_ptr<IServiceAction>, IServiceActionComparator> queue;
-        std::unordered_map<std::string, QueueIt> ClientIdToQueueMap;
-        static int arrivalOrder; // Declaration only
+        std::pmr::unsynchronized_pool_resource ownedPool;
+        std::pmr::memory_resource* resource; // ownedPool unless one was supplied
+
+        std::pmr::unordered_map<std::string_view, std::unique_ptr<Client>> clientsMap{resource}; // key views the client's own id
+        std::pmr::vector<Client*> clientsByHandle{resource};
+        RequestScheduler queue;
+        std::pmr::vector<std::pmr::vector<TransferLeg>> legSlots{resource}; // multi-transfer legs, recycled by slot
+        std::pmr::vector<uint32_t> freeLegSlots{resource};
+        std::pmr::vector<TransferLeg> legSweep{resource}; // multi_transfer_atomic scratch
+        std::pmr::vector<std::pair<int, std::string_view>> legArgs{resource}; // multitransfer legs as parsed, scratch
+        std::pmr::vector<long long> creditedLater{resource}; // recordHistory scratch by handle, zero between calls
+        std::pmr::vector<int> legBalances{resource};        // recordHistory scratch by leg
+        Ledger ledger;
+        History history;
+        std::array<bool, 3> checkFastLane{true, true, true}; // indexed by ClientType
+        HotAccountDetector hotAccounts;
+        int arrivalOrder = 0; // per manager: managers on different threads share nothing
+        ServiceTimeModel serviceModel;
+        uint32_t currentTeller = kConsoleTeller;
+
+        TransferRouter* router = nullptr;
+        struct RemoteTarget {
+            std::string id;
+            RemoteAccount where;
+        };
+        std::pmr::deque<RemoteTarget> remoteTargets{resource};                     // index = target handle & ~kRemoteTarget
+        std::pmr::unordered_map<std::string_view, uint32_t> remoteTargetIndex{resource}; // key views RemoteTarget::id
+        std::pmr::unordered_map<uint64_t, ServiceRequest> remoteInFlight{resource}; // reserved, waiting to settle
+        uint64_t nextTransferId = 1;
+
+        static constexpr size_t kResultBatch = 1024;
+        OutputFormat outputFormat = OutputFormat::TEXT;
+        std::pmr::vector<ActionResult> pendingResults{resource};
+        std::ofstream binaryOut;
+        OutputSink* outputSink = nullptr;
+
+        // Lines answering the current requester: the output sink when one is
+        // set, the console log otherwise.
+        LogLine reply() const { return LogLine(LogLevel::INFO, LogStream::OUT, outputSink); }
+        LogLine replyError() const { return LogLine(LogLevel::ERROR, LogStream::ERR, outputSink); }
         
-        void addClient(const std::string& id, const std::string& service, int priority);
-        void serveNext();
-        void cancelClient(const std::string& id);
-        Client* findClientById(const std::string& id);
+        void registerClient(std::unique_ptr<Client> client);
+        ActionResult execute(const ServiceRequest& request);
+        void emit(const ActionResult& result);
+        void renderText(const ActionResult& result);
+        void renderJsonl(const ActionResult& result);
+        void serveCheckFastLane(Client& c);
+        void recordHistory(const ServiceRequest& request, bool succeeded);
+        void recordCredits(const ServiceRequest& request);
+        template <typename Fn> void forEachLeg(const ServiceRequest& request, Fn&& fn) const;
+        uint32_t acquireLegSlot();
+        void releaseRequest(const ServiceRequest& request);
+        // Every read uses the client's own balance; the ledger's is the view
+        // materialized from its postings. The two agree after every post.
+        void checkLedger(const Client& c) const
+        {
+            assert(ledger.clientBalance(c.getHandle()) == c.getBalance());
+            (void)c;
+        }
+        Client* findClientById(std::string_view id);
+        uint32_t remoteTargetHandle(std::string_view id, const RemoteAccount& where);
+        const std::string& targetId(uint32_t target) const;
+        ResultCode reserveRemoteTransfer(const ServiceRequest& request, Client& client);
         void createRequestFactory(const std::string& id,
                                             const std::string& service,
                                             int amount,
                                             const std::string& targetId);
-        void AddRequestToQueue(std::unique_ptr<IServiceAction> newRequest);
+        void createMultiTransferRequest(std::string_view id,
+                                        const std::pmr::vector<std::pair<int, std::string_view>>& legs);
+        void AddRequestToQueue(const ServiceRequest& newRequest);
     };
-
-
@@ -0,0 +1,411 @@
+#include "BankServer.h"
+#include "UringServer.h"
+#include "CoroServer.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// --- Session ---
+
+void Session::process()
+{
+    BANKQ_TRACE_SCOPE("session");
+    manager.setTeller(teller); // serves below are this session's
+    if (mode == Mode::UNDECIDED) {
+        if (in.empty()) return;
+        mode = static_cast<uint8_t>(in[0]) == kWireMagic ? Mode::BINARY : Mode::TEXT;
+        if (mode == Mode::BINARY) in.erase(0, 1);
+    }
+    if (mode == Mode::BINARY) {
+        processBinary();
+        return;
+    }
+
+    size_t pos = 0;
+    while (!closing && !outputBacklogged()) {
+        const size_t nl = in.find('\n', pos);
+        if (nl == std::string::npos) break;
+        execute(std::string_view(in).substr(pos, nl - pos));
+        pos = nl + 1;
+    }
+    in.erase(0, pos);
+}
+
+bool Session::hasCompleteRequest() const
+{
+    if (mode != Mode::BINARY) return in.find('\n') != std::string::npos;
+    WireHeader h;
+    if (in.size() < sizeof(h)) return false;
+    std::memcpy(&h, in.data(), sizeof(h));
+    return in.size() - sizeof(h) >= h.length;
+}
+
+void Session::writeLine(std::string_view line)
+{
+    if (mode == Mode::BINARY) {
+        appendWireFrame(out, static_cast<uint8_t>(WireReply::ERROR), tag, line.data(), line.size());
+        return;
+    }
+    out.append(line);
+    out.push_back('\n');
+}
+
+void Session::writeRecord(const ActionResult& result)
+{
+    appendWireFrame(out, static_cast<uint8_t>(WireReply::RESULT), tag, &result, sizeof(result));
+}
+
+void Session::consumed(size_t n)
+{
+    outSent += n;
+    if (outSent == out.size()) {
+        out.clear();
+        outSent = 0;
+    } else if (outSent > out.size() / 2) {
+        out.erase(0, outSent);
+        outSent = 0;
+    }
+}
+
+void Session::execute(std::string_view line)
+{
+    const ParsedCommand p = parseCommandLine(line);
+    if (p.args.empty()) return;
+
+    switch (p.command) {
+        case Command::ADD:
+        case Command::CANCEL:
+        case Command::SERVE:
+        case Command::POSITION:
+        case Command::ESTIMATE:
+            manager.runCommand(p);
+            break;
+
+        case Command::PRINTQ:
+        case Command::PRINTC:
+        case Command::SERVICETIMES: {
+            manager.flushResults(); // earlier responses of this session first
+            std::ostringstream report;
+            if (p.command == Command::PRINTQ) manager.printQueue(report);
+            else if (p.command == Command::PRINTC) manager.printBankClients(report);
+            else manager.printServiceTimes(report);
+            out.append(report.str());
+            break;
+        }
+
+        case Command::EXIT:
+            manager.flushResults();
+            writeLine("Goodbye!");
+            closing = true;
+            break;
+
+        case Command::UNKNOWN:
+            manager.flushResults();
+            writeLine("Unknown command: " + std::string(p.args[0]));
+            break;
+
+        default:
+            manager.flushResults();
+            writeLine("Command not available over the network: " + std::string(p.args[0]));
+            break;
+    }
+}
+
+void Session::processBinary()
+{
+    size_t pos = 0;
+    while (!outputBacklogged()) {
+        WireHeader h;
+        if (in.size() - pos < sizeof(h)) break;
+        std::memcpy(&h, in.data() + pos, sizeof(h));
+        if (in.size() - pos - sizeof(h) < h.length) break;
+        executeFrame(h, std::string_view(in).substr(pos + sizeof(h), h.length));
+        pos += sizeof(h) + h.length;
+    }
+    in.erase(0, pos);
+}
+
+void Session::executeFrame(const WireHeader& header, std::string_view body)
+{
+    tag = header.tag;
+    WireClient c{};
+    WireAdd add{};
+
+    switch (static_cast<WireOp>(header.type)) {
+        case WireOp::INTERN:
+            c.client = manager.findClientHandle(body);
+            if (c.client == BankQueueManager::kNoClient)
+                writeLine("Client with ID " + std::string(body) + " not found!");
+            else
+                appendWireFrame(out, static_cast<uint8_t>(WireReply::HANDLE), tag, &c, sizeof(c));
+            return;
+
+        case WireOp::ADD:
+            if (!readWireBody(body, add)) break;
+            if (static_cast<Service>(add.service) == Service::MULTI_TRANSFER) {
+                writeLine("Multi-transfer is only available in the text protocol");
+                return;
+            }
+            manager.addRequest(add.client, static_cast<Service>(add.service), add.amount, add.target);
+            manager.flushResults(); // answer with this request's tag
+            return;
+
+        case WireOp::CHECK:
+            if (!readWireBody(body, c)) break;
+            manager.addRequest(c.client, Service::CHECK, 0);
+            manager.flushResults();
+            return;
+
+        case WireOp::CANCEL:
+            if (!readWireBody(body, c)) break;
+            manager.cancelClient(c.client);
+            manager.flushResults();
+            return;
+
+        case WireOp::SERVE:
+            if (!body.empty()) break;
+            manager.serveNext();
+            manager.flushResults();
+            return;
+
+        case WireOp::ESTIMATE: {
+            if (!readWireBody(body, c)) break;
+            const long long ahead = manager.queuePosition(c.client);
+            if (ahead < 0) {
+                writeLine("No queued request for client handle " + std::to_string(c.client));
+                return;
+            }
+            WireEstimate estimate{};
+            estimate.waitNs = manager.estimateWaitNs(c.client);
+            estimate.ahead = static_cast<uint32_t>(ahead);
+            estimate.tellers = static_cast<uint32_t>(manager.serviceTimes().busyTellers());
+            appendWireFrame(out, static_cast<uint8_t>(WireReply::ESTIMATE), tag, &estimate, sizeof(estimate));
+            return;
+        }
+
+        default:
+            writeLine("Unknown request type " + std::to_string(header.type));
+            return;
+    }
+    writeLine("Malformed request: wrong body length " + std::to_string(body.size()));
+}
+
+// --- Backend selection ---
+
+int openListenSocket(uint16_t& port)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "socket() failed: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on port " << port << ": " << std::strerror(errno) << "\n";
+        ::close(fd);
+        return -1;
+    }
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+std::unique_ptr<NetworkServer> createServer(IoBackend backend, BankQueueManager& manager, uint16_t port)
+{
+    if (backend == IoBackend::URING) {
+        std::string reason;
+        if (UringServer::supported(reason)) return std::make_unique<UringServer>(manager, port);
+        std::cerr << "io_uring unavailable (" << reason << "), falling back to epoll.\n";
+    }
+    if (backend == IoBackend::CORO) {
+#if defined(__cpp_impl_coroutine)
+        return std::make_unique<CoroServer>(manager, port);
+#else
+        std::cerr << "Coroutine backend not built (needs -std=c++20), falling back to epoll.\n";
+#endif
+    }
+    return std::make_unique<BankServer>(manager, port);
+}
+
+// --- BankServer ---
+
+BankServer::BankServer(BankQueueManager& manager, uint16_t port)
+    : manager(manager), port(port) {}
+
+BankServer::~BankServer()
+{
+    for (auto& c : connections)
+        if (c) ::close(c->fd);
+    if (listenFd >= 0) ::close(listenFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (epollFd >= 0) ::close(epollFd);
+}
+
+bool BankServer::listen()
+{
+    std::signal(SIGPIPE, SIG_IGN);
+
+    listenFd = openListenSocket(port);
+    if (listenFd < 0) return false;
+
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    return true;
+}
+
+void BankServer::stop()
+{
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeFd, &one, sizeof(one));
+    (void)n;
+}
+
+void BankServer::run()
+{
+    std::vector<epoll_event> events(1024);
+    while (true) {
+        const int n = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait() failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd) return;
+            if (fd == listenFd) {
+                acceptAll();
+                continue;
+            }
+            if (fd >= static_cast<int>(connections.size()) || !connections[fd]) continue;
+            Connection& c = *connections[fd];
+            if (events[i].events & EPOLLOUT) onWritable(c);
+            if (connections[fd] && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) onReadable(c);
+        }
+    }
+}
+
+void BankServer::acceptAll()
+{
+    while (true) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cerr << "accept4() failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (fd >= static_cast<int>(connections.size())) connections.resize(fd + 1);
+        connections[fd] = std::make_unique<Connection>(fd, manager);
+        ++connectionsOpen;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void BankServer::onReadable(Connection& c)
+{
+    char buf[64 * 1024];
+    while (true) {
+        const ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.session.in.append(buf, static_cast<size_t>(n));
+            if (static_cast<size_t>(n) < sizeof(buf)) break;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        c.peerClosed = true; // orderly shutdown or error: answer what was sent, then close
+        break;
+    }
+
+    manager.setOutputSink(&c.session);
+    c.session.process();
+    manager.setOutputSink(nullptr); // renders this session's pending results into it
+    flushOutput(c);
+}
+
+void BankServer::onWritable(Connection& c)
+{
+    flushOutput(c);
+    // Input held back while the output was backed up.
+    if (connections[c.fd] && !c.session.outputBacklogged() && !c.session.in.empty() && !c.session.closing) {
+        manager.setOutputSink(&c.session);
+        c.session.process();
+        manager.setOutputSink(nullptr);
+        flushOutput(c);
+    }
+}
+
+void BankServer::flushOutput(Connection& c)
+{
+    Session& s = c.session;
+    while (s.hasOutput()) {
+        const ssize_t n = ::send(c.fd, s.out.data() + s.outSent, s.out.size() - s.outSent, MSG_NOSIGNAL);
+        if (n > 0) {
+            s.consumed(static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        closeConnection(c); // peer gone
+        return;
+    }
+    const bool finished = s.closing || (c.peerClosed && !s.hasCompleteRequest());
+    if (finished && !s.hasOutput()) {
+        closeConnection(c);
+        return;
+    }
+    updateInterest(c);
+}
+
+void BankServer::updateInterest(Connection& c)
+{
+    const bool wantWrite = c.session.hasOutput();
+    const bool reading = !c.session.outputBacklogged() && !c.session.closing && !c.peerClosed;
+    if (wantWrite == c.wantWrite && reading == c.reading) return;
+    c.wantWrite = wantWrite;
+    c.reading = reading;
+
+    epoll_event ev{};
+    ev.events = (reading ? static_cast<uint32_t>(EPOLLIN) : 0u) | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.fd = c.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void BankServer::closeConnection(Connection& c)
+{
+    const int fd = c.fd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections[fd].reset();
+    --connectionsOpen;
+}
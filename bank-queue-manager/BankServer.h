@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BankQueueManager.h"
+#include "WireProtocol.h"
+
+// TCP front end for the command protocol.
+//
+// One reactor thread owns the listening socket, every connection and the
+// BankQueueManager: it is the only thread that calls into the manager, so
+// the manager keeps its single-writer design and needs no locks. Sockets are
+// non-blocking and multiplexed with epoll.
+//
+// The protocol is the CLI's text protocol, one command per line, or the binary
+// protocol of WireProtocol.h, chosen by the first byte a client sends. Clients
+// may pipeline any number of requests; they are executed in order and every
+// response is appended to that connection's output buffer, which is sent as
+// the socket accepts it. A connection whose unsent output grows past
+// kMaxPendingOutput stops being read until the client catches up.
+//
+// Interchangeable I/O backends carry the bytes: BankServer (epoll, readiness
+// based, works everywhere), UringServer (io_uring, completion based, see
+// UringServer.h) and CoroServer (one coroutine per connection, C++20 builds
+// only, see CoroServer.h). createServer() picks one at runtime.
+
+// Protocol state of one connection, independent of how bytes move.
+class Session : public OutputSink
+{
+    public:
+        static constexpr size_t kMaxPendingOutput = 1 << 20;
+
+        // Each session is a teller of its own (BankQueueManager::openTeller).
+        explicit Session(BankQueueManager& manager) : manager(manager), teller(manager.openTeller()) {}
+        ~Session() { manager.closeTeller(teller); }
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        std::string in;       // received, not yet executed
+        std::string out;      // responses, not yet sent
+        size_t outSent = 0;   // bytes of `out` already sent
+        bool closing = false; // client sent `exit`; close once `out` is sent
+
+        // Executes every complete request in `in` (stops early while output is
+        // backed up). Must run on the manager's thread.
+        void process();
+
+        // Whether `in` holds a complete request that process() has not run.
+        bool hasCompleteRequest() const;
+
+        bool outputBacklogged() const { return out.size() - outSent > kMaxPendingOutput; }
+        bool hasOutput() const { return outSent < out.size(); }
+
+        // Drops the first `n` unsent bytes after a successful send.
+        void consumed(size_t n);
+
+        void writeLine(std::string_view line) override;
+        bool wantsRecords() const override { return mode == Mode::BINARY; }
+        void writeRecord(const ActionResult& result) override;
+
+    private:
+        enum class Mode { UNDECIDED, TEXT, BINARY };
+
+        BankQueueManager& manager;
+        const uint32_t teller;
+        Mode mode = Mode::UNDECIDED;
+        uint32_t tag = 0; // binary: tag of the request being executed
+
+        void execute(std::string_view line);
+        void processBinary();
+        void executeFrame(const WireHeader& header, std::string_view body);
+};
+
+enum class IoBackend {
+    EPOLL,
+    URING,
+    CORO,
+    UNKNOWN
+};
+
+inline IoBackend parseIoBackend(std::string_view str) {
+    if (str == "epoll") return IoBackend::EPOLL;
+    if (str == "uring" || str == "io_uring") return IoBackend::URING;
+    if (str == "coro") return IoBackend::CORO;
+    return IoBackend::UNKNOWN;
+}
+
+inline const char* io_backend_to_string(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::EPOLL: return "epoll";
+        case IoBackend::URING: return "io_uring";
+        case IoBackend::CORO:  return "coro";
+        default:               return "UNKNOWN";
+    }
+}
+
+class NetworkServer
+{
+    public:
+        virtual ~NetworkServer() = default;
+
+        // Binds and listens on all interfaces. Port 0 picks a free port.
+        virtual bool listen() = 0;
+        virtual uint16_t getPort() const = 0;
+
+        // Runs the reactor on the calling thread until stop().
+        virtual void run() = 0;
+
+        // Safe to call from any thread.
+        virtual void stop() = 0;
+
+        virtual size_t connectionCount() const = 0;
+        virtual IoBackend backend() const = 0;
+};
+
+// Opens a non-blocking listening TCP socket on all interfaces. Port 0 is
+// replaced by the port picked. Returns -1 (reason on stderr) on failure.
+int openListenSocket(uint16_t& port);
+
+// Creates a server on the requested backend. io_uring falls back to epoll
+// (with a note on stderr) when the kernel does not provide what it needs, and
+// so does the coroutine backend in a build without C++20 coroutines.
+std::unique_ptr<NetworkServer> createServer(IoBackend backend, BankQueueManager& manager, uint16_t port);
+
+// epoll backend.
+class BankServer : public NetworkServer
+{
+    public:
+        BankServer(BankQueueManager& manager, uint16_t port);
+        ~BankServer() override;
+
+        bool listen() override;
+        uint16_t getPort() const override { return port; }
+        void run() override;
+        void stop() override;
+        size_t connectionCount() const override { return connectionsOpen; }
+        IoBackend backend() const override { return IoBackend::EPOLL; }
+
+    private:
+        struct Connection {
+            int fd;
+            bool wantWrite = false; // EPOLLOUT registered
+            bool reading = true;    // EPOLLIN registered
+            bool peerClosed = false; // read side reached EOF; finish and close
+            Session session;
+
+            Connection(int fd, BankQueueManager& manager) : fd(fd), session(manager) {}
+        };
+
+        BankQueueManager& manager;
+        uint16_t port;
+        int listenFd = -1;
+        int epollFd = -1;
+        int wakeFd = -1;
+        size_t connectionsOpen = 0;
+        std::vector<std::unique_ptr<Connection>> connections; // indexed by fd
+
+        void acceptAll();
+        void onReadable(Connection& c);
+        void onWritable(Connection& c);
+        void flushOutput(Connection& c);
+        void updateInterest(Connection& c);
+        void closeConnection(Connection& c);
+};
@@ -0,0 +1,195 @@
+#include "BranchEngine.h"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kRoundBatch = 64; // lines / messages per source per round
+
+} // namespace
+
+BranchEngine::BranchEngine(size_t count, SchedulerBackend scheduler)
+{
+    for (size_t i = 0; i < count; ++i) {
+        branches.push_back(std::make_unique<Branch>(*this, static_cast<uint32_t>(i), scheduler));
+        branches.back()->backlog.resize(count);
+    }
+    for (size_t i = 0; i < count * count; ++i) links.push_back(std::make_unique<Link>());
+}
+
+BranchEngine::~BranchEngine()
+{
+    stop();
+}
+
+bool BranchEngine::addClient(size_t branch, const std::string& id, int balance, const std::string& type)
+{
+    if (running || branch >= branches.size() || directory.count(id)) return false;
+    BankQueueManager& m = branches[branch]->manager;
+    if (!m.addBankClient(id, balance, type)) return false;
+    ids.push_back(id);
+    directory.emplace(ids.back(), RemoteAccount{static_cast<uint32_t>(branch), m.findClientHandle(id)});
+    return true;
+}
+
+void BranchEngine::start(bool pin)
+{
+    if (running) return;
+    running = true;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < branches.size(); ++i) {
+        Branch* b = branches[i].get();
+        b->thread = std::thread([b] { b->run(); });
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cores, &set);
+            pthread_setaffinity_np(b->thread.native_handle(), sizeof(set), &set); // best effort
+        }
+    }
+}
+
+bool BranchEngine::submit(size_t branch, std::string_view line)
+{
+    if (!running || branch >= branches.size() || line.size() > sizeof(Line::text)) return false;
+    Line l;
+    l.length = static_cast<uint16_t>(line.size());
+    std::memcpy(l.text, line.data(), line.size());
+    Branch& b = *branches[branch];
+    while (!b.inbox->tryPush(l)) std::this_thread::yield(); // inbox full: wait for the branch
+    ++b.submitted;
+    return true;
+}
+
+// Quiet when every branch ran what it was given and every credit sent has
+// been both applied and answered. A branch publishes its counters after the
+// round's results are rendered, `executed` last, so once a branch's executed
+// count is current so are the transfers it started.
+void BranchEngine::drain()
+{
+    if (!running) return;
+    auto idle = std::chrono::microseconds(50);
+    while (true) {
+        bool quiet = true;
+        for (const auto& b : branches) quiet = quiet && b->executedOut.load(std::memory_order_acquire) == b->submitted;
+        uint64_t sent = 0, credited = 0, settled = 0;
+        for (const auto& b : branches) {
+            sent += b->sentOut.load(std::memory_order_acquire);
+            credited += b->creditedOut.load(std::memory_order_acquire);
+            settled += b->settledOut.load(std::memory_order_acquire);
+        }
+        if (quiet && credited == sent && settled == sent) return;
+        std::this_thread::sleep_for(idle);
+        idle = std::min(idle * 2, std::chrono::microseconds(1000));
+    }
+}
+
+void BranchEngine::stop()
+{
+    if (!running) return;
+    drain();
+    stopping.store(true, std::memory_order_release);
+    for (const auto& b : branches) b->thread.join();
+    stopping.store(false, std::memory_order_relaxed);
+    running = false;
+}
+
+// --- Branch ---
+
+BranchEngine::Branch::Branch(BranchEngine& engine, uint32_t index, SchedulerBackend scheduler)
+    : engine(engine), index(index), manager(scheduler)
+{
+    manager.setTransferRouter(this);
+    manager.setHistorySpillPath("history.branch" + std::to_string(index) + ".bin");
+}
+
+bool BranchEngine::Branch::findRemote(std::string_view id, RemoteAccount& where) const
+{
+    auto it = engine.directory.find(id);
+    if (it == engine.directory.end() || it->second.branch == index) return false;
+    where = it->second;
+    return true;
+}
+
+void BranchEngine::Branch::sendCredit(const RemoteAccount& where, uint64_t transferId, int amount)
+{
+    ++sent;
+    post(where.branch, Message{Message::Kind::CREDIT, ResultCode::OK, index, where.handle, amount, transferId});
+}
+
+// Keeps the order of messages to each branch: once one waits in the backlog,
+// the ones after it do too.
+void BranchEngine::Branch::post(uint32_t to, const Message& message)
+{
+    if (backlog[to].empty() && engine.link(index, to).tryPush(message)) return;
+    backlog[to].push_back(message);
+}
+
+bool BranchEngine::Branch::flushBacklog()
+{
+    bool moved = false;
+    for (uint32_t to = 0; to < backlog.size(); ++to) {
+        std::deque<Message>& pending = backlog[to];
+        while (!pending.empty() && engine.link(index, to).tryPush(pending.front())) {
+            pending.pop_front();
+            moved = true;
+        }
+    }
+    return moved;
+}
+
+void BranchEngine::Branch::receive(const Message& message)
+{
+    if (message.kind == Message::Kind::CREDIT) {
+        const ResultCode code = manager.applyRemoteCredit(message.handle, message.amount, message.from);
+        ++credited;
+        post(message.from, Message{Message::Kind::RESULT, code, index, message.handle, message.amount, message.transferId});
+    } else {
+        manager.settleRemoteTransfer(message.transferId, message.code);
+        ++settled;
+    }
+}
+
+// Links first, so transfers settle ahead of new commands; the idle backoff is
+// the log writer's (Log.h).
+void BranchEngine::Branch::run()
+{
+    const uint32_t count = static_cast<uint32_t>(engine.branches.size());
+    Line line;
+    Message message;
+    auto idle = std::chrono::microseconds(50);
+    while (true) {
+        const bool stop = engine.stopping.load(std::memory_order_acquire);
+        bool worked = flushBacklog();
+        for (uint32_t from = 0; from < count; ++from) {
+            if (from == index) continue;
+            Link& in = engine.link(from, index);
+            for (size_t i = 0; i < kRoundBatch && in.tryPop(message); ++i) {
+                receive(message);
+                worked = true;
+            }
+        }
+        for (size_t i = 0; i < kRoundBatch && inbox->tryPop(line); ++i) {
+            manager.runCommand(std::string_view(line.text, line.length));
+            ++executed;
+            worked = true;
+        }
+
+        if (worked) {
+            manager.flushResults();
+            sentOut.store(sent, std::memory_order_release);
+            creditedOut.store(credited, std::memory_order_release);
+            settledOut.store(settled, std::memory_order_release);
+            executedOut.store(executed, std::memory_order_release);
+            idle = std::chrono::microseconds(50);
+        } else if (stop) {
+            return; // drain() ran before the stop request
+        } else {
+            std::this_thread::sleep_for(idle);
+            idle = std::min(idle * 2, std::chrono::microseconds(1000));
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "BankQueueManager.h"
+#include "SpscRing.h"
+
+// Shared-nothing multi-branch engine.
+//
+// Clients are partitioned into branches. Each branch is a BankQueueManager
+// with its own queue, ledger and history, driven by one thread (pinned to a
+// core when asked) that nothing else touches: no locks, no shared writes on
+// the command path. Commands reach a branch through an SPSC inbox of text
+// lines; submit() is called from one producer thread.
+//
+// A transfer whose target lives in another branch is a two-step exchange over
+// per-pair SPSC links (see TransferRouter):
+//  1. the sending branch serves it by reserving the amount and posts a credit
+//     to the owning branch,
+//  2. that branch credits its client (or refuses: overflow, unknown client)
+//     and posts the result back, and the sender commits or refunds.
+// Until step 2 the money sits on the sender's inter-branch clearing account,
+// so every ledger balances at all times. Messages that do not fit a full link
+// wait in the sender's backlog, which keeps two branches sending to each
+// other from ever waiting on one another.
+
+class BranchEngine
+{
+    public:
+        static constexpr size_t kInboxLines = 1024;    // per branch, a power of two
+        static constexpr size_t kLinkMessages = 1024;  // per ordered branch pair, a power of two
+
+        explicit BranchEngine(size_t branches, SchedulerBackend scheduler = SchedulerBackend::ORDERED_SET);
+        ~BranchEngine();
+
+        BranchEngine(const BranchEngine&) = delete;
+        BranchEngine& operator=(const BranchEngine&) = delete;
+
+        // Opens a client in `branch`; ids are unique across branches. Only
+        // before start().
+        bool addClient(size_t branch, const std::string& id, int balance, const std::string& type);
+
+        size_t branchCount() const { return branches.size(); }
+        // The manager of one branch; only while the engine is stopped.
+        BankQueueManager& manager(size_t branch) { return branches[branch]->manager; }
+
+        // Starts one thread per branch; with `pin`, branch i runs on core
+        // i % hardware_concurrency().
+        void start(bool pin = true);
+
+        // Queues a command line for `branch`, waiting while its inbox is
+        // full. False if the line is longer than a slot holds.
+        bool submit(size_t branch, std::string_view line);
+
+        // Waits until every submitted command has run and every cross-branch
+        // transfer has settled, with its results rendered.
+        void drain();
+
+        // drain(), then stops and joins the branch threads.
+        void stop();
+
+    private:
+        struct Line {
+            uint16_t length;
+            char text[126];
+        };
+
+        struct Message {
+            enum class Kind : uint8_t { CREDIT, RESULT };
+            Kind kind;
+            ResultCode code;      // RESULT
+            uint32_t from;        // sending branch
+            uint32_t handle;      // CREDIT: client handle at the receiving branch
+            int32_t amount;
+            uint64_t transferId;  // the sender's, echoed by RESULT
+        };
+
+        using Inbox = SpscRing<Line, kInboxLines>;
+        using Link = SpscRing<Message, kLinkMessages>;
+
+        struct Branch : TransferRouter {
+            Branch(BranchEngine& engine, uint32_t index, SchedulerBackend scheduler);
+
+            bool findRemote(std::string_view id, RemoteAccount& where) const override;
+            void sendCredit(const RemoteAccount& where, uint64_t transferId, int amount) override;
+
+            void run();
+            void post(uint32_t to, const Message& message);
+            bool flushBacklog();
+            void receive(const Message& message);
+
+            BranchEngine& engine;
+            const uint32_t index;
+            BankQueueManager manager;
+            std::unique_ptr<Inbox> inbox = std::make_unique<Inbox>();
+            std::vector<std::deque<Message>> backlog; // by receiving branch
+            uint64_t submitted = 0;                   // producer thread only
+            uint64_t sent = 0, credited = 0, settled = 0, executed = 0; // branch thread only
+            std::thread thread;
+
+            // Published by the branch thread after each round, for drain().
+            alignas(64) std::atomic<uint64_t> sentOut{0};
+            std::atomic<uint64_t> creditedOut{0};
+            std::atomic<uint64_t> settledOut{0};
+            std::atomic<uint64_t> executedOut{0};
+        };
+
+        std::vector<std::unique_ptr<Branch>> branches;
+        std::vector<std::unique_ptr<Link>> links; // index from * branches + to
+        std::deque<std::string> ids;              // directory keys; immutable once started
+        std::unordered_map<std::string_view, RemoteAccount> directory;
+        std::atomic<bool> stopping{false};
+        bool running = false;
+
+        Link& link(uint32_t from, uint32_t to) { return *links[from * branches.size() + to]; }
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+// Allocation-free building blocks for the command line parser: a whitespace
+// tokenizer over std::string_view, std::from_chars number parsing and a
+// keyword table with a perfect hash found at compile time. Nothing here
+// throws, so malformed input is reported through return values only.
+
+// Splits on the same whitespace as `std::istream >> std::string`.
+class Tokenizer
+{
+    public:
+        explicit Tokenizer(std::string_view input) : rest(input) {}
+
+        bool next(std::string_view& token)
+        {
+            size_t i = 0;
+            while (i < rest.size() && isSpace(rest[i])) ++i;
+            if (i == rest.size()) {
+                rest = {};
+                return false;
+            }
+            size_t end = i;
+            while (end < rest.size() && !isSpace(rest[end])) ++end;
+            token = rest.substr(i, end - i);
+            rest.remove_prefix(end);
+            return true;
+        }
+
+    private:
+        std::string_view rest;
+
+        static constexpr bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+        }
+};
+
+// Every token of one command line. Only the first kMaxTokens are kept; `size()`
+// still counts all of them, and `restFrom(i)` gives the unsplit tail of the
+// line for commands with variable-length arguments.
+class CommandTokens
+{
+    public:
+        static constexpr size_t kMaxTokens = 8;
+
+        explicit CommandTokens(std::string_view line) : line(line)
+        {
+            Tokenizer tokenizer(line);
+            std::string_view token;
+            while (tokenizer.next(token)) {
+                if (count < kMaxTokens) tokens[count] = token;
+                ++count;
+            }
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        // Empty for tokens past kMaxTokens.
+        std::string_view operator[](size_t i) const { return i < kMaxTokens ? tokens[i] : std::string_view(); }
+
+        std::string_view restFrom(size_t i) const
+        {
+            if (i >= count || i >= kMaxTokens) return {};
+            return line.substr(static_cast<size_t>(tokens[i].data() - line.data()));
+        }
+
+    private:
+        std::string_view line;
+        std::array<std::string_view, kMaxTokens> tokens{};
+        size_t count = 0;
+};
+
+// Whole-token integer parse. Accepts an optional leading '+' like std::stoi,
+// but rejects trailing garbage ("12abc") and out-of-range values.
+template <typename T>
+bool parseNumber(std::string_view token, T& out)
+{
+    if (!token.empty() && token.front() == '+') token.remove_prefix(1);
+    if (token.empty()) return false;
+    T value{};
+    auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (ec != std::errc() || end != token.data() + token.size()) return false;
+    out = value;
+    return true;
+}
+
+// Maps N keywords to enum values with one hash and one string compare.
+// The constructor searches for a hash seed under which every keyword lands in
+// its own slot; it runs at compile time for `constexpr` tables, where a
+// failed search is caught by `static_assert(table.isPerfect())`.
+template <typename Enum, size_t N, size_t TableSize = 32>
+class KeywordTable
+{
+    static_assert((TableSize & (TableSize - 1)) == 0, "table size must be a power of two");
+    static_assert(N <= TableSize, "more keywords than slots");
+
+    public:
+        constexpr KeywordTable(const std::pair<std::string_view, Enum> (&keywords)[N], Enum unknown)
+            : unknown(unknown)
+        {
+            for (uint32_t s = 1; s < 100000; ++s) {
+                if (tryBuild(keywords, s)) {
+                    seed = s;
+                    return;
+                }
+            }
+        }
+
+        constexpr bool isPerfect() const { return seed != 0; }
+
+        constexpr Enum lookup(std::string_view word) const
+        {
+            const size_t slot = hash(word, seed);
+            return used[slot] && words[slot] == word ? values[slot] : unknown;
+        }
+
+    private:
+        std::array<std::string_view, TableSize> words{};
+        std::array<Enum, TableSize> values{};
+        std::array<bool, TableSize> used{};
+        Enum unknown;
+        uint32_t seed = 0;
+
+        // FNV-1a with the seed as offset basis, folded down to the table size.
+        static constexpr size_t hash(std::string_view word, uint32_t seed)
+        {
+            uint32_t h = seed * 2166136261u;
+            for (char c : word) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+            return (h ^ (h >> 16)) & (TableSize - 1);
+        }
+
+        constexpr bool tryBuild(const std::pair<std::string_view, Enum> (&keywords)[N], uint32_t s)
+        {
+            for (size_t i = 0; i < TableSize; ++i) used[i] = false;
+            for (size_t i = 0; i < N; ++i) {
+                const size_t slot = hash(keywords[i].first, s);
+                if (used[slot]) return false;
+                used[slot] = true;
+                words[slot] = keywords[i].first;
+                values[slot] = keywords[i].second;
+            }
+            return true;
+        }
+};
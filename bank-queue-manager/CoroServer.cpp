@@ -0,0 +1,78 @@
+#include "CoroServer.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+CoroServer::CoroServer(BankQueueManager& manager, uint16_t port)
+    : manager(manager), port(port) {}
+
+CoroServer::~CoroServer()
+{
+    executor.destroySuspended();
+    if (listenFd >= 0) ::close(listenFd);
+}
+
+bool CoroServer::listen()
+{
+    listenFd = openListenSocket(port);
+    return listenFd >= 0;
+}
+
+void CoroServer::run()
+{
+    acceptLoop(); // runs until its first accept suspends
+    executor.run();
+}
+
+Task CoroServer::acceptLoop()
+{
+    AsyncListener listener(executor, listenFd);
+    while (true) {
+        const int fd = co_await listener.accept();
+        if (fd < 0) {
+            std::cerr << "accept4() failed: " << std::strerror(-fd) << "\n";
+            continue;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        serveConnection(fd); // runs until its first read suspends
+    }
+}
+
+Task CoroServer::serveConnection(int fd)
+{
+    AsyncSocket socket(executor, fd);
+    Session session(manager);
+    bool peerOpen = true;
+    ++connectionsOpen;
+
+    while (true) {
+        manager.setOutputSink(&session);
+        session.process();
+        manager.setOutputSink(nullptr); // renders this session's pending results into it
+
+        while (session.hasOutput()) {
+            const ssize_t n = co_await socket.write(session.out.data() + session.outSent,
+                                                    session.out.size() - session.outSent);
+            if (n < 0) { // peer gone
+                --connectionsOpen;
+                co_return;
+            }
+            session.consumed(static_cast<size_t>(n));
+        }
+
+        if (session.closing) break;
+        if (session.hasCompleteRequest()) continue; // held back while the output was backed up
+        if (!peerOpen) break;
+
+        if (socket.readable()) co_await executor.yield(); // more input waiting: let the other sessions run first
+        const ssize_t n = co_await socket.read(readBuffer, sizeof(readBuffer));
+        if (n <= 0) peerOpen = false; // orderly shutdown or error: answer what was sent, then close
+        else session.in.append(readBuffer, static_cast<size_t>(n));
+    }
+    --connectionsOpen;
+}
+
+#endif // __cpp_impl_coroutine
@@ -0,0 +1,40 @@
+#pragma once
+#include "BankServer.h"
+#include "Coroutine.h"
+
+// Coroutine backend for the TCP front end (needs C++20; see Coroutine.h).
+//
+// Each connection is one coroutine that reads as straight-line code: read,
+// run the complete requests through its Session, write the responses, repeat.
+// Backpressure is implicit: a session does not read again until its output
+// has been sent. Sessions, the manager and the executor all live on the
+// thread that calls run(), like the other backends.
+
+#if defined(__cpp_impl_coroutine)
+
+class CoroServer : public NetworkServer
+{
+    public:
+        CoroServer(BankQueueManager& manager, uint16_t port);
+        ~CoroServer() override;
+
+        bool listen() override;
+        uint16_t getPort() const override { return port; }
+        void run() override;
+        void stop() override { executor.stop(); }
+        size_t connectionCount() const override { return connectionsOpen; }
+        IoBackend backend() const override { return IoBackend::CORO; }
+
+    private:
+        BankQueueManager& manager;
+        uint16_t port;
+        int listenFd = -1;
+        size_t connectionsOpen = 0;
+        Executor executor;
+        char readBuffer[64 * 1024]; // shared: a read is consumed before any other coroutine runs
+
+        Task acceptLoop();
+        Task serveConnection(int fd);
+};
+
+#endif // __cpp_impl_coroutine
@@ -0,0 +1,385 @@
+#pragma once
+#if defined(__cpp_impl_coroutine)
+#include <array>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Small coroutine runtime for socket sessions (C++20; the header is empty
+// when coroutines are not enabled).
+//
+//  - Task: a fire-and-forget coroutine. It starts running at the call and
+//    frees its own frame when it returns.
+//  - FramePool: frames come from per-thread free lists by size class, so
+//    once a frame of each size has been used, starting a coroutine does not
+//    allocate.
+//  - Executor: an epoll loop on one thread. Every socket is registered once,
+//    edge-triggered; epoll_ctl is only called again around a write that has
+//    to wait for buffer space. It keeps a readable / writable flag per
+//    socket, cleared when an operation finds the socket drained (EAGAIN or a
+//    short transfer) and set again by the next edge. yield() requeues a coroutine behind the others that are
+//    ready, so a client that always has more input cannot starve the rest.
+//  - AsyncSocket / AsyncListener: awaitable recv / send / accept. The
+//    operation runs at once if the socket may be ready, and suspends
+//    otherwise, with no syscall spent on a certain EAGAIN. The awaiter lives
+//    in the coroutine frame, so an await allocates nothing.
+
+// --- FramePool ---
+
+class FramePool
+{
+    public:
+        static FramePool& local()
+        {
+            thread_local FramePool pool;
+            return pool;
+        }
+
+        void* allocate(size_t size)
+        {
+            const size_t cls = sizeClass(size);
+            if (cls >= kClasses) return ::operator new(size);
+            if (FreeFrame* f = freeLists[cls]) {
+                freeLists[cls] = f->next;
+                return f;
+            }
+            ++fresh;
+            return ::operator new((cls + 1) * kGranule);
+        }
+
+        void deallocate(void* p, size_t size)
+        {
+            const size_t cls = sizeClass(size);
+            if (cls >= kClasses) {
+                ::operator delete(p);
+                return;
+            }
+            FreeFrame* f = static_cast<FreeFrame*>(p);
+            f->next = freeLists[cls];
+            freeLists[cls] = f;
+        }
+
+        // Frames that had to come from the global allocator so far.
+        size_t freshAllocations() const { return fresh; }
+
+        ~FramePool()
+        {
+            for (FreeFrame*& head : freeLists) {
+                while (head) {
+                    FreeFrame* next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t kGranule = 64;
+        static constexpr size_t kClasses = 64; // frames up to 4 KB are pooled
+
+        struct FreeFrame { FreeFrame* next; };
+        std::array<FreeFrame*, kClasses> freeLists{};
+        size_t fresh = 0;
+
+        static size_t sizeClass(size_t size) { return (size - 1) / kGranule; }
+};
+
+// --- Task ---
+
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::local().allocate(size); }
+        static void operator delete(void* p, size_t size) { FramePool::local().deallocate(p, size); }
+    };
+};
+
+// --- Executor ---
+
+class Executor
+{
+    public:
+        // A suspended socket operation, retried by the executor on every
+        // readiness edge until it stops returning EAGAIN.
+        struct Operation {
+            std::coroutine_handle<> waiter;
+            virtual bool attempt() = 0; // true once finished
+        protected:
+            ~Operation() = default;
+        };
+
+        Executor()
+        {
+            epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+            wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = wakeFd;
+            ::epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        }
+
+        ~Executor()
+        {
+            ::close(wakeFd);
+            ::close(epollFd);
+        }
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        void watch(int fd)
+        {
+            if (fd >= static_cast<int>(slots.size())) slots.resize(fd + 1);
+            slots[fd] = Slot{};
+            interest(fd, EPOLL_CTL_ADD, false);
+        }
+
+        void unwatch(int fd)
+        {
+            ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            slots[fd] = Slot{};
+        }
+
+        void waitReadable(int fd, Operation* op) { slots[fd].reader = op; }
+        void waitWritable(int fd, Operation* op)
+        {
+            slots[fd].writer = op;
+            interest(fd, EPOLL_CTL_MOD, true); // reports at once if space opened up meanwhile
+        }
+
+        bool readable(int fd) const { return slots[fd].readable; }
+        bool writable(int fd) const { return slots[fd].writable; }
+        void setReadable(int fd, bool ready) { slots[fd].readable = ready; }
+        void setWritable(int fd, bool ready) { slots[fd].writable = ready; }
+
+        // co_await executor.yield(): resumes after the sockets that are ready
+        // now have been served.
+        struct Yield {
+            Executor& executor;
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> h) { executor.ready.push_back(h); }
+            void await_resume() const {}
+        };
+        Yield yield() { return Yield{*this}; }
+
+        // Resumes coroutines as their sockets become ready, until stop().
+        void run()
+        {
+            std::array<epoll_event, 1024> events;
+            std::vector<std::coroutine_handle<>> resuming;
+            while (true) {
+                if (!ready.empty()) {
+                    resuming.swap(ready); // yields from these wait for the next pass
+                    for (std::coroutine_handle<> h : resuming) h.resume();
+                    resuming.clear();
+                }
+                const int n = ::epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), ready.empty() ? -1 : 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) return;
+                for (int i = 0; i < n; ++i) {
+                    const int fd = events[i].data.fd;
+                    if (fd == wakeFd) return;
+                    const uint32_t e = events[i].events;
+                    // Re-index after every resume: it may close fds or grow `slots`.
+                    if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) complete(fd, &Slot::reader, &Slot::readable);
+                    if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) complete(fd, &Slot::writer, &Slot::writable);
+                }
+            }
+        }
+
+        // Safe to call from any thread.
+        void stop()
+        {
+            uint64_t one = 1;
+            ssize_t n = ::write(wakeFd, &one, sizeof(one));
+            (void)n;
+        }
+
+        // Destroys every coroutine still suspended on a socket or in yield()
+        // (their locals are destroyed, closing their sockets). Call after
+        // run() returned.
+        void destroySuspended()
+        {
+            std::vector<std::coroutine_handle<>> handles;
+            handles.swap(ready);
+            for (const Slot& s : slots) {
+                if (s.reader) handles.push_back(s.reader->waiter);
+                if (s.writer) handles.push_back(s.writer->waiter);
+            }
+            for (std::coroutine_handle<> h : handles) h.destroy();
+        }
+
+    private:
+        struct Slot {
+            Operation* reader = nullptr;
+            Operation* writer = nullptr;
+            bool readable = true; // not known to be drained
+            bool writable = true;
+        };
+
+        int epollFd = -1;
+        int wakeFd = -1;
+        std::vector<Slot> slots; // indexed by fd
+        std::vector<std::coroutine_handle<>> ready; // yielded, resumed on the next pass
+
+        // EPOLLOUT is only registered while a writer waits: with it always on,
+        // every ACK from a client would wake the loop for nothing.
+        void interest(int fd, int op, bool write)
+        {
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            ev.data.fd = fd;
+            ::epoll_ctl(epollFd, op, fd, &ev);
+        }
+
+        void complete(int fd, Operation* Slot::*which, bool Slot::*flag)
+        {
+            if (fd >= static_cast<int>(slots.size())) return;
+            slots[fd].*flag = true;
+            Operation* op = slots[fd].*which;
+            if (!op || !op->attempt()) return; // nobody waiting, or a spurious edge
+            slots[fd].*which = nullptr;
+            if (which == &Slot::writer) interest(fd, EPOLL_CTL_MOD, false);
+            op->waiter.resume();
+        }
+};
+
+// --- Awaitable sockets ---
+
+// Owns a connected non-blocking socket registered with an executor.
+class AsyncSocket
+{
+    public:
+        AsyncSocket(Executor& executor, int fd) : executor(executor), fd(fd) { executor.watch(fd); }
+
+        ~AsyncSocket()
+        {
+            executor.unwatch(fd);
+            ::close(fd);
+        }
+
+        AsyncSocket(const AsyncSocket&) = delete;
+        AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+        // co_await socket.read(buf, len): bytes read, 0 at EOF, -errno on error.
+        struct Read final : Executor::Operation {
+            AsyncSocket& socket;
+            char* buf;
+            size_t len;
+            ssize_t result = 0;
+
+            Read(AsyncSocket& socket, char* buf, size_t len) : socket(socket), buf(buf), len(len) {}
+
+            bool attempt() override
+            {
+                const ssize_t n = ::recv(socket.fd, buf, len, 0);
+                const bool again = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+                if (again || (n > 0 && static_cast<size_t>(n) < len)) socket.executor.setReadable(socket.fd, false);
+                if (again) return false;
+                result = n < 0 ? -errno : n;
+                return true;
+            }
+            bool await_ready() { return socket.executor.readable(socket.fd) && attempt(); }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                waiter = h;
+                socket.executor.waitReadable(socket.fd, this);
+            }
+            ssize_t await_resume() const { return result; }
+        };
+
+        // co_await socket.write(data, len): bytes sent (possibly fewer than
+        // len), or -errno on error.
+        struct Write final : Executor::Operation {
+            AsyncSocket& socket;
+            const char* data;
+            size_t len;
+            ssize_t result = 0;
+
+            Write(AsyncSocket& socket, const char* data, size_t len) : socket(socket), data(data), len(len) {}
+
+            bool attempt() override
+            {
+                const ssize_t n = ::send(socket.fd, data, len, MSG_NOSIGNAL);
+                const bool again = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+                if (again || (n > 0 && static_cast<size_t>(n) < len)) socket.executor.setWritable(socket.fd, false);
+                if (again) return false;
+                result = n < 0 ? -errno : n;
+                return true;
+            }
+            bool await_ready() { return socket.executor.writable(socket.fd) && attempt(); }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                waiter = h;
+                socket.executor.waitWritable(socket.fd, this);
+            }
+            ssize_t await_resume() const { return result; }
+        };
+
+        Read read(char* buf, size_t len) { return Read(*this, buf, len); }
+        Write write(const char* data, size_t len) { return Write(*this, data, len); }
+
+        // False once a read found no more input, until the next edge.
+        bool readable() const { return executor.readable(fd); }
+
+    private:
+        Executor& executor;
+        int fd;
+};
+
+// A non-blocking listening socket registered with an executor (not owned).
+class AsyncListener
+{
+    public:
+        AsyncListener(Executor& executor, int fd) : executor(executor), fd(fd) { executor.watch(fd); }
+        ~AsyncListener() { executor.unwatch(fd); }
+
+        AsyncListener(const AsyncListener&) = delete;
+        AsyncListener& operator=(const AsyncListener&) = delete;
+
+        // co_await listener.accept(): a non-blocking connected socket, or -errno.
+        struct Accept final : Executor::Operation {
+            AsyncListener& listener;
+            int result = -1;
+
+            explicit Accept(AsyncListener& listener) : listener(listener) {}
+
+            bool attempt() override
+            {
+                const int s = ::accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                    listener.executor.setReadable(listener.fd, false);
+                    return false;
+                }
+                result = s < 0 ? -errno : s;
+                return true;
+            }
+            bool await_ready() { return listener.executor.readable(listener.fd) && attempt(); }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                waiter = h;
+                listener.executor.waitReadable(listener.fd, this);
+            }
+            int await_resume() const { return result; }
+        };
+
+        Accept accept() { return Accept(*this); }
+
+    private:
+        Executor& executor;
+        int fd;
+};
+
+#endif // __cpp_impl_coroutine
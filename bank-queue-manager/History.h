@@ -0,0 +1,225 @@
+#pragma once
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Per-client history of executed actions, keyed by client handle.
+//
+// Each client owns a list of fixed-size chunks of 32-byte records. Only the
+// newest chunk of every client is open for appends; full chunks are sealed and
+// tracked in a global FIFO. Once more than `maxResidentChunks` sealed chunks
+// are in memory, the oldest is appended to the spill file and only its
+// summary (ticket / time bounds and file offset) stays resident, so memory per
+// stored transaction is bounded regardless of history length.
+//
+// Queries walk the chunk summaries and only load chunks whose bounds overlap
+// the requested range. The spill file is created in the working directory
+// under a name of its own per process and per History, unless one is set.
+
+class History
+{
+    public:
+        static constexpr size_t kChunkRecords = 128; // 4 KB per chunk
+
+        struct Record {
+            int64_t timeMs;          // execution time, ms since epoch
+            int32_t ticket;          // arrival ticket of the action
+            uint32_t counterparty;   // other client of a transfer, kNone otherwise
+            int32_t amount;
+            int32_t balanceAfter;    // this client's balance after execution
+            uint8_t kind;            // Service
+            uint8_t flags;           // kFailed | kIncoming
+            uint16_t reserved;
+            uint32_t reserved2;
+        };
+        static_assert(sizeof(Record) == 32, "history records are 32 bytes");
+
+        static constexpr uint32_t kNone = UINT32_MAX;
+        static constexpr uint8_t kFailed = 1;
+        static constexpr uint8_t kIncoming = 2;
+
+        explicit History(std::string spillPath = defaultSpillPath(), size_t maxResidentChunks = 4096)
+            : spillPath(std::move(spillPath)), maxResidentChunks(maxResidentChunks) {}
+
+        // history.<pid>.<n>.bin: neither another process in the same
+        // directory nor another History of this one truncates it.
+        static std::string defaultSpillPath()
+        {
+            static std::atomic<unsigned> instances{0};
+            return "history." + std::to_string(::getpid()) + "." + std::to_string(instances++) + ".bin";
+        }
+
+        // Takes effect if nothing has been spilled yet.
+        void setSpillPath(std::string path)
+        {
+            if (!spill.is_open()) spillPath = std::move(path);
+        }
+
+        ~History()
+        {
+            if (spill.is_open()) {
+                spill.close();
+                std::remove(spillPath.c_str());
+            }
+        }
+
+        void append(uint32_t handle, const Record& r)
+        {
+            if (handle >= clients.size()) clients.resize(handle + 1);
+            auto& chunks = clients[handle];
+            if (chunks.empty() || chunks.back().count == kChunkRecords) {
+                const bool first = chunks.empty();
+                if (!first) sealed(handle, static_cast<uint32_t>(chunks.size() - 1));
+                chunks.emplace_back();
+                // A client's first chunk grows on demand (most clients have short
+                // histories); later ones are allocated whole, once per chunk.
+                if (!first) chunks.back().records.reserve(kChunkRecords);
+            }
+            Chunk& c = chunks.back();
+            if (c.count == 0) {
+                c.minTicket = c.maxTicket = r.ticket;
+                c.firstTimeMs = r.timeMs;
+            }
+            c.minTicket = std::min(c.minTicket, r.ticket);
+            c.maxTicket = std::max(c.maxTicket, r.ticket);
+            c.lastTimeMs = r.timeMs;
+            c.records.push_back(r);
+            ++c.count;
+            ++totalRecords;
+        }
+
+        // The queries return false if a spilled chunk could not be read
+        // back; its records are skipped.
+
+        // Newest `n` records of the client, newest first.
+        template <typename Fn>
+        bool forEachLast(uint32_t handle, size_t n, Fn&& fn)
+        {
+            if (handle >= clients.size()) return true;
+            bool complete = true;
+            auto& chunks = clients[handle];
+            for (size_t ci = chunks.size(); ci-- > 0 && n > 0;) {
+                const Record* recs = load(chunks[ci]);
+                if (!recs) {
+                    complete = false;
+                    continue;
+                }
+                for (uint32_t i = chunks[ci].count; i-- > 0 && n > 0; --n) fn(recs[i]);
+            }
+            return complete;
+        }
+
+        // Records with ticket in [from, to], oldest first.
+        template <typename Fn>
+        bool forEachTicketRange(uint32_t handle, int32_t from, int32_t to, Fn&& fn)
+        {
+            if (handle >= clients.size()) return true;
+            bool complete = true;
+            for (Chunk& c : clients[handle]) {
+                if (c.maxTicket < from || c.minTicket > to) continue;
+                const Record* recs = load(c);
+                if (!recs) {
+                    complete = false;
+                    continue;
+                }
+                for (uint32_t i = 0; i < c.count; ++i)
+                    if (recs[i].ticket >= from && recs[i].ticket <= to) fn(recs[i]);
+            }
+            return complete;
+        }
+
+        // Records executed in [fromMs, toMs], oldest first.
+        template <typename Fn>
+        bool forEachTimeRange(uint32_t handle, int64_t fromMs, int64_t toMs, Fn&& fn)
+        {
+            if (handle >= clients.size()) return true;
+            bool complete = true;
+            for (Chunk& c : clients[handle]) {
+                if (c.lastTimeMs < fromMs || c.firstTimeMs > toMs) continue;
+                const Record* recs = load(c);
+                if (!recs) {
+                    complete = false;
+                    continue;
+                }
+                for (uint32_t i = 0; i < c.count; ++i)
+                    if (recs[i].timeMs >= fromMs && recs[i].timeMs <= toMs) fn(recs[i]);
+            }
+            return complete;
+        }
+
+        const std::string& spillFile() const { return spillPath; }
+
+        size_t recordCount() const { return totalRecords; }
+        size_t residentChunkCount() const { return residentSealed.size(); }
+        size_t spilledChunkCount() const { return spilledChunks; }
+
+    private:
+        struct Chunk {
+            std::vector<Record> records;       // grows up to kChunkRecords, emptied once spilled
+            uint32_t count = 0;
+            int32_t minTicket = 0;
+            int32_t maxTicket = 0;
+            int64_t firstTimeMs = 0;
+            int64_t lastTimeMs = 0;
+            int64_t spillOffset = -1;
+        };
+
+        std::vector<std::vector<Chunk>> clients;              // handle -> chunks, oldest first
+        std::deque<std::pair<uint32_t, uint32_t>> residentSealed; // (handle, chunk) in seal order
+        std::string spillPath;
+        std::fstream spill;
+        size_t maxResidentChunks;
+        size_t totalRecords = 0;
+        size_t spilledChunks = 0;
+        std::vector<Record> scratch; // buffer for chunks read back from disk
+
+        void sealed(uint32_t handle, uint32_t chunkIndex)
+        {
+            residentSealed.emplace_back(handle, chunkIndex);
+            while (residentSealed.size() > maxResidentChunks) {
+                auto [h, ci] = residentSealed.front();
+                residentSealed.pop_front();
+                spillChunk(clients[h][ci]);
+            }
+        }
+
+        void spillChunk(Chunk& c)
+        {
+            if (!spill.is_open()) {
+                spill.open(spillPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!spill) return; // keep the chunk resident if the file is unavailable
+            }
+            spill.seekp(0, std::ios::end);
+            const int64_t offset = static_cast<int64_t>(spill.tellp());
+            spill.write(reinterpret_cast<const char*>(c.records.data()), c.count * sizeof(Record));
+            spill.flush();
+            if (offset < 0 || !spill) { // disk full or similar: keep the chunk resident
+                spill.clear();
+                return;
+            }
+            c.spillOffset = offset;
+            std::vector<Record>().swap(c.records);
+            ++spilledChunks;
+        }
+
+        // The chunk's records, or nullptr if its spilled copy cannot be read.
+        const Record* load(const Chunk& c)
+        {
+            if (c.spillOffset < 0) return c.records.data();
+            scratch.resize(c.count);
+            spill.seekg(c.spillOffset);
+            spill.read(reinterpret_cast<char*>(scratch.data()), c.count * sizeof(Record));
+            if (!spill) { // short read or I/O error: keep the stream usable for later spills
+                spill.clear();
+                return nullptr;
+            }
+            return scratch.data();
+        }
+};
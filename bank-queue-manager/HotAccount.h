@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Balance split into per-core sub-counters for accounts that receive a large
+// share of the credits.
+//
+// Deposits are added lock-free to the slot of the calling thread. Each slot has
+// a budget (its share of the headroom below INT_MAX at the last fold), so the
+// combined balance can never overflow without any cross-slot coordination.
+// Withdrawals and checks fold the slots back into the base balance, which is
+// owned by the serving thread like any other balance.
+class SplitBalance
+{
+    public:
+        explicit SplitBalance(size_t slotCount)
+            : slotCount(std::max<size_t>(1, slotCount)), slots(new Slot[this->slotCount]) {}
+
+        static size_t defaultSlotCount()
+        {
+            return std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 64);
+        }
+
+        size_t getSlotCount() const { return slotCount; }
+
+        // Gives every slot an even share of half the headroom left above `base`.
+        // Half, because a deposit racing a fold may still run on the old budget.
+        void resetBudgets(int base)
+        {
+            const long long share = (static_cast<long long>(INT_MAX) - base) / static_cast<long long>(2 * slotCount);
+            for (size_t i = 0; i < slotCount; ++i) slots[i].budget.store(share, std::memory_order_relaxed);
+        }
+
+        // Lock-free credit to the caller's slot. False when the slot's budget
+        // is exhausted; the caller then folds and retries on the base balance.
+        bool tryAdd(int amount)
+        {
+            Slot& s = slots[localSlot()];
+            long long cur = s.value.load(std::memory_order_relaxed);
+            do {
+                if (cur + amount > s.budget.load(std::memory_order_relaxed)) return false;
+            } while (!s.value.compare_exchange_weak(cur, cur + amount, std::memory_order_relaxed));
+            return true;
+        }
+
+        // Moves everything credited so far out of the slots.
+        long long drain()
+        {
+            long long sum = 0;
+            for (size_t i = 0; i < slotCount; ++i) sum += slots[i].value.exchange(0, std::memory_order_acq_rel);
+            return sum;
+        }
+
+        // Credited but not yet folded (a momentary read, not a snapshot).
+        long long pending() const
+        {
+            long long sum = 0;
+            for (size_t i = 0; i < slotCount; ++i) sum += slots[i].value.load(std::memory_order_acquire);
+            return sum;
+        }
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<long long> value{0};
+            std::atomic<long long> budget{0};
+        };
+
+        size_t slotCount;
+        std::unique_ptr<Slot[]> slots;
+
+        size_t localSlot() const
+        {
+            static thread_local const size_t tid = std::hash<std::thread::id>{}(std::this_thread::get_id());
+            return tid % slotCount;
+        }
+};
+
+// Counts credits per client handle over fixed windows of `window` credits.
+// At the end of each window, accounts whose share reached `hotShare` are
+// reported hot, and hot accounts whose share fell below a quarter of it are
+// reported cold again (the gap keeps an account from flapping between modes).
+class HotAccountDetector
+{
+    public:
+        explicit HotAccountDetector(uint32_t window = 1024, double hotShare = 0.125)
+            : window(window), hotShare(hotShare) {}
+
+        // onHot(handle) / onCold(handle) are called at window boundaries.
+        template <typename OnHot, typename OnCold>
+        void recordCredit(uint32_t handle, OnHot&& onHot, OnCold&& onCold)
+        {
+            if (handle >= counts.size()) {
+                counts.resize(handle + 1, 0);
+                isHot.resize(handle + 1, false);
+            }
+            if (counts[handle]++ == 0) touched.push_back(handle);
+            if (++seen < window) return;
+
+            const double hot = hotShare * window;
+            for (size_t i = 0; i < hotHandles.size();) {
+                uint32_t h = hotHandles[i];
+                if (counts[h] < hot / 4) {
+                    isHot[h] = false;
+                    hotHandles[i] = hotHandles.back();
+                    hotHandles.pop_back();
+                    onCold(h);
+                } else {
+                    ++i;
+                }
+            }
+            for (uint32_t h : touched) {
+                if (counts[h] >= hot && !isHot[h]) {
+                    isHot[h] = true;
+                    hotHandles.push_back(h);
+                    onHot(h);
+                }
+                counts[h] = 0;
+            }
+            touched.clear();
+            seen = 0;
+        }
+
+    private:
+        uint32_t window;
+        double hotShare;
+        uint32_t seen = 0;
+        std::vector<uint32_t> counts;      // credits in the current window
+        std::vector<uint32_t> touched;     // handles with a non-zero count
+        std::vector<bool> isHot;
+        std::vector<uint32_t> hotHandles;
+};
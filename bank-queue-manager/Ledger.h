@@ -0,0 +1,251 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Append-only double-entry journal.
+// Every executed money movement posts one balanced transaction (the signed
+// amounts of its entries sum to zero). Entries are never updated or removed.
+//
+// Storage is columnar: the newest entries live in an uncompressed tail, and
+// every kBlockSize entries the tail is sealed into a Block whose columns are
+// delta / zigzag encoded as LEB128 varints. Per-account block lists let a
+// history query touch only the blocks that mention that account.
+//
+// Balances are a materialized view updated on every post, so reading a
+// balance never replays the journal. The manager asserts after every post
+// that the view agrees with the client's own balance.
+
+class Ledger
+{
+    public:
+        // House accounts. Client accounts are client handle + kFirstClientAccount.
+        static constexpr uint32_t kCashAccount = 0;       // teller cash drawer
+        static constexpr uint32_t kEquityAccount = 1;     // opening balances
+        static constexpr uint32_t kInterBranchAccount = 2; // clearing for transfers with other branches
+        static constexpr uint32_t kFirstClientAccount = 3;
+        static constexpr size_t kBlockSize = 4096;
+
+        struct Entry {
+            uint64_t txId;
+            int32_t ticket;      // arrival ticket of the action (0 = opening balance)
+            uint32_t account;
+            int64_t amount;      // + credit (balance grows), - debit
+        };
+
+        Ledger() { ensureAccount(kEquityAccount); }
+
+        static uint32_t accountOf(uint32_t clientHandle) { return clientHandle + kFirstClientAccount; }
+
+        void openAccount(uint32_t clientHandle, int64_t openingBalance)
+        {
+            ensureAccount(accountOf(clientHandle));
+            if (openingBalance != 0) {
+                beginTx();
+                append(0, accountOf(clientHandle), openingBalance);
+                append(0, kEquityAccount, -openingBalance);
+            }
+        }
+
+        void postDeposit(int ticket, uint32_t clientHandle, int64_t amount)
+        {
+            beginTx();
+            append(ticket, accountOf(clientHandle), amount);
+            append(ticket, kCashAccount, -amount);
+        }
+
+        void postWithdraw(int ticket, uint32_t clientHandle, int64_t amount)
+        {
+            beginTx();
+            append(ticket, accountOf(clientHandle), -amount);
+            append(ticket, kCashAccount, amount);
+        }
+
+        void postTransfer(int ticket, uint32_t fromHandle, uint32_t toHandle, int64_t amount)
+        {
+            beginTx();
+            append(ticket, accountOf(fromHandle), -amount);
+            append(ticket, accountOf(toHandle), amount);
+        }
+
+        // Money leaving for / arriving from another branch (BranchEngine.h).
+        // The clearing accounts of all branches sum to zero once every
+        // transfer between them has settled.
+        void postTransferOut(int ticket, uint32_t fromHandle, int64_t amount)
+        {
+            beginTx();
+            append(ticket, accountOf(fromHandle), -amount);
+            append(ticket, kInterBranchAccount, amount);
+        }
+
+        void postTransferIn(int ticket, uint32_t toHandle, int64_t amount)
+        {
+            beginTx();
+            append(ticket, accountOf(toHandle), amount);
+            append(ticket, kInterBranchAccount, -amount);
+        }
+
+        // One transaction: a single debit of the source and one credit per leg.
+        // Legs only need a `to->getHandle()` and an `amount`.
+        template <typename Legs>
+        void postMultiTransfer(int ticket, uint32_t fromHandle, const Legs& legs)
+        {
+            beginTx();
+            int64_t total = 0;
+            for (const auto& leg : legs) total += leg.amount;
+            append(ticket, accountOf(fromHandle), -total);
+            for (const auto& leg : legs) append(ticket, accountOf(leg.to->getHandle()), leg.amount);
+        }
+
+        int64_t balance(uint32_t account) const
+        {
+            return account < balances.size() ? balances[account] : 0;
+        }
+
+        int64_t clientBalance(uint32_t clientHandle) const { return balance(accountOf(clientHandle)); }
+
+        size_t entryCount() const { return sealedCount + tail.size(); }
+        uint64_t transactionCount() const { return nextTxId; }
+
+        // Sum over every account; zero as long as each transaction was balanced.
+        int64_t trialBalance() const
+        {
+            int64_t sum = 0;
+            for (int64_t b : balances) sum += b;
+            return sum;
+        }
+
+        // Calls fn(const Entry&) for every entry of `account`, oldest first.
+        template <typename Fn>
+        void forEachEntry(uint32_t account, Fn&& fn) const
+        {
+            if (account < accountBlocks.size()) {
+                std::vector<Entry> decoded;
+                for (uint32_t blockIndex : accountBlocks[account]) {
+                    decodeBlock(blocks[blockIndex], decoded);
+                    for (const Entry& e : decoded)
+                        if (e.account == account) fn(e);
+                }
+            }
+            for (const Entry& e : tail)
+                if (e.account == account) fn(e);
+        }
+
+        // Bytes held by sealed blocks (compressed) and by the raw tail.
+        size_t compressedBytes() const
+        {
+            size_t bytes = 0;
+            for (const Block& b : blocks)
+                bytes += b.txIds.size() + b.tickets.size() + b.accounts.size() + b.amounts.size();
+            return bytes + tail.size() * sizeof(Entry);
+        }
+
+    private:
+        struct Block {
+            uint32_t count = 0;
+            uint64_t firstTxId = 0;
+            std::vector<uint8_t> txIds;     // delta from previous entry
+            std::vector<uint8_t> tickets;   // zigzag delta from previous entry
+            std::vector<uint8_t> accounts;  // raw varint
+            std::vector<uint8_t> amounts;   // zigzag varint
+        };
+
+        std::vector<Entry> tail;
+        std::vector<Block> blocks;
+        std::vector<std::vector<uint32_t>> accountBlocks; // account -> sealed blocks mentioning it
+        std::vector<int64_t> balances;                    // materialized view
+        size_t sealedCount = 0;
+        uint64_t nextTxId = 0;
+        uint64_t currentTxId = 0;
+
+        void ensureAccount(uint32_t account)
+        {
+            if (account >= balances.size()) {
+                balances.resize(account + 1, 0);
+                accountBlocks.resize(account + 1);
+            }
+        }
+
+        void beginTx() { currentTxId = nextTxId++; }
+
+        void append(int ticket, uint32_t account, int64_t amount)
+        {
+            ensureAccount(account);
+            balances[account] += amount;
+            tail.push_back(Entry{currentTxId, ticket, account, amount});
+            if (tail.size() == kBlockSize) seal();
+        }
+
+        static uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+        static int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+        static void putVarint(std::vector<uint8_t>& out, uint64_t v)
+        {
+            while (v >= 0x80) {
+                out.push_back(static_cast<uint8_t>(v) | 0x80);
+                v >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(v));
+        }
+
+        static uint64_t getVarint(const uint8_t*& p)
+        {
+            uint64_t v = 0;
+            int shift = 0;
+            while (*p & 0x80) {
+                v |= static_cast<uint64_t>(*p++ & 0x7F) << shift;
+                shift += 7;
+            }
+            v |= static_cast<uint64_t>(*p++) << shift;
+            return v;
+        }
+
+        void seal()
+        {
+            const uint32_t blockIndex = static_cast<uint32_t>(blocks.size());
+            Block block;
+            block.count = static_cast<uint32_t>(tail.size());
+            block.firstTxId = tail.front().txId;
+
+            uint64_t prevTx = block.firstTxId;
+            int64_t prevTicket = 0;
+            for (const Entry& e : tail) {
+                putVarint(block.txIds, e.txId - prevTx);
+                putVarint(block.tickets, zigzag(static_cast<int64_t>(e.ticket) - prevTicket));
+                putVarint(block.accounts, e.account);
+                putVarint(block.amounts, zigzag(e.amount));
+                prevTx = e.txId;
+                prevTicket = e.ticket;
+
+                auto& list = accountBlocks[e.account];
+                if (list.empty() || list.back() != blockIndex) list.push_back(blockIndex);
+            }
+            block.txIds.shrink_to_fit();
+            block.tickets.shrink_to_fit();
+            block.accounts.shrink_to_fit();
+            block.amounts.shrink_to_fit();
+
+            blocks.push_back(std::move(block));
+            sealedCount += tail.size();
+            tail.clear();
+        }
+
+        static void decodeBlock(const Block& block, std::vector<Entry>& out)
+        {
+            out.resize(block.count);
+            const uint8_t* tx = block.txIds.data();
+            const uint8_t* tk = block.tickets.data();
+            const uint8_t* ac = block.accounts.data();
+            const uint8_t* am = block.amounts.data();
+            uint64_t prevTx = block.firstTxId;
+            int64_t prevTicket = 0;
+            for (uint32_t i = 0; i < block.count; ++i) {
+                prevTx += getVarint(tx);
+                prevTicket += unzigzag(getVarint(tk));
+                out[i].txId = prevTx;
+                out[i].ticket = static_cast<int32_t>(prevTicket);
+                out[i].account = static_cast<uint32_t>(getVarint(ac));
+                out[i].amount = unzigzag(getVarint(am));
+            }
+        }
+};
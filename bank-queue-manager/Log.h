@@ -0,0 +1,277 @@
+#pragma once
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Stats.h"
+#include "Trace.h"
+
+// Asynchronous console log.
+//
+// Producers format a line on their own stack (LogLine) and copy it into a
+// per-thread single-producer / single-consumer ring of fixed 128-byte records;
+// a line longer than one record spans consecutive records. Rings are
+// ThreadShards (Stats.h): one left by an exited thread, drained or not, is
+// taken over by the next new producer. A background
+// writer thread drains every ring and issues one write() per stream per pass,
+// so the serving thread never makes a write syscall. If a ring fills up, its
+// producer waits for the writer instead of dropping lines.
+//
+// flush() is a barrier: it returns once everything submitted before the call
+// has been written. Code that prints with std::cout directly calls it first so
+// both kinds of output stay in order.
+
+enum class LogLevel {
+    SILENT,
+    ERROR,   // failed lookups and malformed input, to stderr
+    INFO,    // results of commands, to stdout
+    DEBUG
+};
+
+enum class LogStream : uint8_t {
+    OUT,
+    ERR
+};
+
+inline LogLevel parseLogLevel(std::string_view str) {
+    if (str == "silent") return LogLevel::SILENT;
+    if (str == "error") return LogLevel::ERROR;
+    if (str == "info") return LogLevel::INFO;
+    if (str == "debug") return LogLevel::DEBUG;
+    return LogLevel::INFO;
+}
+
+inline const char* log_level_to_string(LogLevel level) {
+    switch (level) {
+        case LogLevel::SILENT: return "silent";
+        case LogLevel::ERROR:  return "error";
+        case LogLevel::INFO:   return "info";
+        case LogLevel::DEBUG:  return "debug";
+    }
+    return "info";
+}
+
+class Logger
+{
+    public:
+        static constexpr size_t kRingRecords = 4096; // per producer thread
+
+        struct Record {
+            LogStream stream;
+            uint8_t continued;   // 1 when the line goes on in the next record
+            uint16_t length;
+            char text[124];
+        };
+        static_assert(sizeof(Record) == 128, "log records are 128 bytes");
+
+        static Logger& instance()
+        {
+            static Logger logger;
+            return logger;
+        }
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        ~Logger()
+        {
+            stopping.store(true, std::memory_order_release);
+            if (writer.joinable()) writer.join();
+        }
+
+        void setLevel(LogLevel l) { level.store(l, std::memory_order_relaxed); }
+        LogLevel getLevel() const { return level.load(std::memory_order_relaxed); }
+
+        bool enabled(LogLevel l) const
+        {
+            return l != LogLevel::SILENT && l <= level.load(std::memory_order_relaxed);
+        }
+
+        // Queues one line (without its newline). Never performs I/O.
+        void submit(LogStream stream, const char* text, size_t length)
+        {
+            Ring& ring = rings.local();
+            const size_t textSize = sizeof(Record::text);
+            const uint64_t needed = length == 0 ? 1 : (length + textSize - 1) / textSize;
+            uint64_t head = ring.head.load(std::memory_order_relaxed);
+            while (head + needed - ring.tail.load(std::memory_order_acquire) > kRingRecords)
+                std::this_thread::yield(); // ring full: wait for the writer
+
+            for (uint64_t i = 0; i < needed; ++i) {
+                Record& r = ring.records[(head + i) % kRingRecords];
+                const size_t n = std::min(length, textSize);
+                r.stream = stream;
+                r.continued = i + 1 < needed;
+                r.length = static_cast<uint16_t>(n);
+                std::memcpy(r.text, text, n);
+                text += n;
+                length -= n;
+            }
+            ring.head.store(head + needed, std::memory_order_release);
+        }
+
+        // Waits until every line submitted before this call has been written.
+        void flush()
+        {
+            std::vector<std::pair<Ring*, uint64_t>> targets;
+            rings.forEach([&](Ring& ring) { targets.emplace_back(&ring, ring.head.load(std::memory_order_acquire)); },
+                          [] {});
+            for (auto [ring, head] : targets)
+                while (ring->tail.load(std::memory_order_acquire) < head) std::this_thread::yield();
+        }
+
+    private:
+        struct Ring {
+            alignas(64) std::atomic<uint64_t> head{0}; // next record the producer writes
+            alignas(64) std::atomic<uint64_t> tail{0}; // next record not yet written out
+            std::unique_ptr<Record[]> records{new Record[kRingRecords]};
+        };
+
+        std::atomic<LogLevel> level{LogLevel::INFO};
+        std::atomic<bool> stopping{false};
+        ThreadShards<Ring> rings;
+        std::thread writer;
+
+        Logger() : writer([this] { run(); }) {}
+
+        void run()
+        {
+            std::vector<Ring*> snapshot;
+            std::string out, err;
+            out.reserve(1 << 16);
+            err.reserve(1 << 16);
+            auto idle = std::chrono::microseconds(50);
+            while (true) {
+                const bool stop = stopping.load(std::memory_order_acquire);
+                snapshot.clear();
+                rings.forEach([&](Ring& ring) { snapshot.push_back(&ring); }, [] {});
+
+                bool wrote = false;
+                for (Ring* ring : snapshot) {
+                    const uint64_t head = ring->head.load(std::memory_order_acquire);
+                    const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                    if (head == tail) continue;
+                    BANKQ_TRACE_SCOPE("log.write");
+                    for (uint64_t i = tail; i < head; ++i) {
+                        const Record& r = ring->records[i % kRingRecords];
+                        std::string& buf = r.stream == LogStream::ERR ? err : out;
+                        buf.append(r.text, r.length);
+                        if (!r.continued) buf.push_back('\n');
+                    }
+                    writeAll(STDOUT_FILENO, out);
+                    writeAll(STDERR_FILENO, err);
+                    ring->tail.store(head, std::memory_order_release);
+                    wrote = true;
+                }
+
+                if (wrote) {
+                    idle = std::chrono::microseconds(50);
+                } else if (stop) {
+                    return; // drained after the stop request
+                } else {
+                    std::this_thread::sleep_for(idle);
+                    idle = std::min(idle * 2, std::chrono::microseconds(1000));
+                }
+            }
+        }
+
+        static void writeAll(int fd, std::string& buf)
+        {
+            const char* p = buf.data();
+            size_t left = buf.size();
+            while (left > 0) {
+                ssize_t n = ::write(fd, p, left);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    break; // output closed: drop the rest
+                }
+                p += n;
+                left -= static_cast<size_t>(n);
+            }
+            buf.clear();
+        }
+};
+
+struct ActionResult; // Results.h
+
+// Receives lines meant for one requester (e.g. a network session) instead of
+// the console. Called on the thread that formats the line.
+class OutputSink
+{
+    public:
+        virtual ~OutputSink() = default;
+        virtual void writeLine(std::string_view line) = 0;
+
+        // A sink that answers with result records (binary clients) returns
+        // true; the manager then passes it ActionResults instead of text.
+        virtual bool wantsRecords() const { return false; }
+        virtual void writeRecord(const ActionResult&) {}
+};
+
+// One log line, formatted into a stack buffer and submitted when it goes out
+// of scope. Does nothing when its level is disabled. Lines are cut at
+// kMaxLine bytes. With a sink, the line goes to the sink whatever the level.
+class LogLine
+{
+    public:
+        static constexpr size_t kMaxLine = 512;
+
+        LogLine(LogLevel level, LogStream stream, OutputSink* sink = nullptr)
+            : on(sink || Logger::instance().enabled(level)), stream(stream), sink(sink) {}
+
+        LogLine(const LogLine&) = delete;
+        LogLine& operator=(const LogLine&) = delete;
+
+        ~LogLine()
+        {
+            if (!on) return;
+            if (sink) sink->writeLine(std::string_view(buf, len));
+            else Logger::instance().submit(stream, buf, len);
+        }
+
+        LogLine& operator<<(std::string_view s)
+        {
+            if (on) {
+                const size_t n = std::min(s.size(), kMaxLine - len);
+                std::memcpy(buf + len, s.data(), n);
+                len += n;
+            }
+            return *this;
+        }
+
+        LogLine& operator<<(const char* s) { return *this << std::string_view(s); }
+        LogLine& operator<<(const std::string& s) { return *this << std::string_view(s); }
+        LogLine& operator<<(char c) { return *this << std::string_view(&c, 1); }
+
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+        LogLine& operator<<(T value)
+        {
+            if (on) {
+                auto [end, ec] = std::to_chars(buf + len, buf + kMaxLine, value);
+                if (ec == std::errc()) len = static_cast<size_t>(end - buf);
+            }
+            return *this;
+        }
+
+    private:
+        char buf[kMaxLine];
+        size_t len = 0;
+        bool on;
+        LogStream stream;
+        OutputSink* sink;
+};
+
+inline LogLine logInfo() { return LogLine(LogLevel::INFO, LogStream::OUT); }
+inline LogLine logError() { return LogLine(LogLevel::ERROR, LogStream::ERR); }
+inline LogLine logDebug() { return LogLine(LogLevel::DEBUG, LogStream::OUT); }
+
+inline void logFlush() { Logger::instance().flush(); }
@@ -0,0 +1,248 @@
+#include "MetricsServer.h"
+#include "BankServer.h"
+#include "Stats.h"
+#include <malloc.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <unistd.h>
+
+// --- Exposition ---
+
+namespace {
+
+// Histogram `le` bounds, ns.
+constexpr uint64_t kBucketBounds[] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000, 500000000,
+    1000000000, 2500000000, 5000000000, 10000000000};
+
+constexpr const char* kTypeLabels[] = {"vip", "business", "regular"}; // ClientType order
+
+void appendNumber(std::string& out, double value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    out += buf;
+}
+
+void appendHeader(std::string& out, const char* name, const char* type, const char* help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void appendSample(std::string& out, const char* name, const std::string& labels, double value)
+{
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+
+// One histogram series; the HDR buckets are folded into kBucketBounds by their
+// highest value, so a bucket straddling a bound counts in the next one up.
+void appendHistogram(std::string& out, const char* name, const std::string& labels, const LatencyHistogram& h)
+{
+    const std::string series = std::string(name) + "_bucket";
+    const std::string prefix = labels + ",le=\"";
+    uint64_t cumulative = 0;
+    size_t i = 0;
+    for (uint64_t bound : kBucketBounds) {
+        for (; i < LatencyHistogram::kBuckets && LatencyHistogram::bucketUpper(i) <= bound; ++i) cumulative += h.counts[i];
+        std::string le;
+        appendNumber(le, bound / 1e9);
+        appendSample(out, series.c_str(), prefix + le + "\"", static_cast<double>(cumulative));
+    }
+    appendSample(out, series.c_str(), prefix + "+Inf\"", static_cast<double>(h.count));
+    appendSample(out, (std::string(name) + "_sum").c_str(), labels, h.sum / 1e9);
+    appendSample(out, (std::string(name) + "_count").c_str(), labels, static_cast<double>(h.count));
+}
+
+void appendProcess(std::string& out)
+{
+    long pages = 0, resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages >> resident;
+    const double pageSize = static_cast<double>(::sysconf(_SC_PAGESIZE));
+    appendHeader(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+    appendSample(out, "process_resident_memory_bytes", "", resident * pageSize);
+    appendHeader(out, "process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes.");
+    appendSample(out, "process_virtual_memory_bytes", "", pages * pageSize);
+
+    timespec cpu{};
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    appendHeader(out, "process_cpu_seconds_total", "counter", "User and system CPU time spent in seconds.");
+    appendSample(out, "process_cpu_seconds_total", "", cpu.tv_sec + cpu.tv_nsec / 1e9);
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 heap = ::mallinfo2();
+    appendHeader(out, "bankq_heap_bytes", "gauge", "malloc heap: arena size, bytes in use and free in the arenas, bytes in mmapped chunks.");
+    appendSample(out, "bankq_heap_bytes", "kind=\"arena\"", static_cast<double>(heap.arena));
+    appendSample(out, "bankq_heap_bytes", "kind=\"in_use\"", static_cast<double>(heap.uordblks));
+    appendSample(out, "bankq_heap_bytes", "kind=\"free\"", static_cast<double>(heap.fordblks));
+    appendSample(out, "bankq_heap_bytes", "kind=\"mmapped\"", static_cast<double>(heap.hblkhd));
+#endif
+}
+
+} // namespace
+
+std::string renderMetrics()
+{
+    const StatsCounters::Values c = StatsCounters::instance().snapshot();
+    const std::unique_ptr<LatencySnapshot> latency = LatencyStats::instance().snapshot(false); // counters never go back
+    auto value = [&](StatsCounter counter, size_t type = 0) {
+        return static_cast<double>(c[static_cast<size_t>(counter) + type]);
+    };
+    auto typeLabel = [](size_t type) { return std::string("client_type=\"") + kTypeLabels[type] + "\""; };
+
+    std::string out;
+    out.reserve(32 * 1024);
+
+    appendHeader(out, "bankq_queue_depth", "gauge", "Requests waiting in the service queue.");
+    for (size_t t = 0; t < 3; ++t) {
+        const double depth = value(StatsCounter::QUEUED_VIP, t) - value(StatsCounter::SERVED_VIP, t)
+                           - value(StatsCounter::CANCELED_VIP, t);
+        appendSample(out, "bankq_queue_depth", typeLabel(t), depth);
+    }
+
+    const std::pair<const char*, StatsCounter> perType[] = {
+        {"bankq_requests_queued_total", StatsCounter::QUEUED_VIP},
+        {"bankq_requests_served_total", StatsCounter::SERVED_VIP},
+        {"bankq_requests_canceled_total", StatsCounter::CANCELED_VIP},
+    };
+    for (const auto& [name, first] : perType) {
+        appendHeader(out, name, "counter", "Requests by client type.");
+        for (size_t t = 0; t < 3; ++t) appendSample(out, name, typeLabel(t), value(first, t));
+    }
+
+    appendHeader(out, "bankq_fast_lane_checks_total", "counter", "Balance checks answered without queueing.");
+    appendSample(out, "bankq_fast_lane_checks_total", "", value(StatsCounter::FAST_LANE_CHECKS));
+    appendHeader(out, "bankq_failed_withdrawals_total", "counter", "Served withdrawals that were rejected.");
+    appendSample(out, "bankq_failed_withdrawals_total", "", value(StatsCounter::FAILED_WITHDRAWALS));
+    appendHeader(out, "bankq_failed_transfers_total", "counter", "Served transfers and multi-transfers that were rejected.");
+    appendSample(out, "bankq_failed_transfers_total", "", value(StatsCounter::FAILED_TRANSFERS));
+
+    // Metric names are "<command>" or "<command>.<service>"; "wait.<type>" is the queue wait.
+    appendHeader(out, "bankq_command_duration_seconds", "histogram", "Execution time of add, cancel and serve by service.");
+    for (size_t m = 0; m < latency->metrics.size(); ++m) {
+        const std::string_view name = kLatencyMetricNames[m];
+        const size_t dot = name.find('.');
+        if (name.substr(0, dot) == "wait") continue;
+        std::string labels = "command=\"" + std::string(name.substr(0, dot)) + "\"";
+        if (dot != std::string_view::npos) labels += ",service=\"" + std::string(name.substr(dot + 1)) + "\"";
+        appendHistogram(out, "bankq_command_duration_seconds", labels, latency->metrics[m]);
+    }
+    appendHeader(out, "bankq_queue_wait_seconds", "histogram", "Time from ticket issue to serve by client type.");
+    for (size_t t = 0; t < 3; ++t)
+        appendHistogram(out, "bankq_queue_wait_seconds", typeLabel(t),
+                        (*latency)[static_cast<LatencyMetric>(static_cast<size_t>(LatencyMetric::WAIT_VIP) + t)]);
+
+    appendProcess(out);
+    return out;
+}
+
+// --- MetricsServer ---
+
+MetricsServer::MetricsServer(uint16_t port) : port(port) {}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start()
+{
+    listenFd = openListenSocket(port);
+    if (listenFd < 0) return false;
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    listener = std::thread([this] { run(); });
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (listener.joinable()) {
+        const uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+        listener.join();
+    }
+    if (listenFd >= 0) ::close(listenFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+    listenFd = wakeFd = -1;
+}
+
+void MetricsServer::run()
+{
+    pollfd fds[2] = {{listenFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+    while (true) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) return;
+        while (true) {
+            const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC); // blocking, with timeouts below
+            if (fd < 0) break;
+            answer(fd);
+            ::close(fd);
+        }
+    }
+}
+
+// One request per connection; a slow or silent client is dropped after the
+// socket timeout rather than holding up the next scrape for long.
+void MetricsServer::answer(int fd)
+{
+    const timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string status = "200 OK", body;
+    const std::string_view line = std::string_view(request).substr(0, request.find("\r\n"));
+    if (line.substr(0, 4) != "GET ") {
+        status = "405 Method Not Allowed";
+    } else {
+        std::string_view path = line.substr(4, line.find(' ', 4) - 4);
+        path = path.substr(0, path.find('?'));
+        if (path == "/metrics") body = renderMetrics();
+        else status = "404 Not Found";
+    }
+    if (body.empty()) body = status + "\n";
+
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n";
+    response += body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
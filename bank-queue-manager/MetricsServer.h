@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Prometheus metrics over HTTP.
+//
+// A small listener on its own thread answers `GET /metrics` with the text
+// exposition format (version 0.0.4) and closes the connection; anything else
+// gets a 404. It never calls into a BankQueueManager: everything it reports
+// comes from the per-thread counters and histograms of Stats.h, merged when
+// the scrape arrives, and from the process itself:
+//
+//  - queue depth per client type (queued - served - canceled)
+//  - requests queued / served / canceled per client type, fast-lane checks,
+//    failed withdrawals and transfers, as counters (per-second rates are
+//    rate() over them)
+//  - command duration and queue wait histograms, folded from the HDR
+//    buckets into fixed `le` bounds from 1 us to 10 s
+//  - resident / virtual memory, CPU time and malloc heap usage
+//
+// The serving threads only ever touch their own counters, so a scrape costs
+// them nothing.
+
+class MetricsServer
+{
+    public:
+        explicit MetricsServer(uint16_t port);
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        // Binds on all interfaces (port 0 picks a free port) and starts the
+        // listener thread. False (reason on stderr) on failure.
+        bool start();
+        uint16_t getPort() const { return port; }
+
+        // Stops and joins the listener thread. Called by the destructor.
+        void stop();
+
+    private:
+        uint16_t port;
+        int listenFd = -1;
+        int wakeFd = -1;
+        std::thread listener;
+
+        void run();
+        void answer(int fd);
+};
+
+// The current metrics in the Prometheus text format.
+std::string renderMetrics();
@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// A set of keys in [0, capacity) that counts the keys below any key in
+// O(log capacity): a bitmap, plus a Fenwick tree of the keys per 64-bit word
+// of it. Keeping the tree per word makes it 64 times smaller than one per
+// key, so its upper levels stay in cache. Growing the key range means
+// starting over (reset()).
+
+class RankIndex
+{
+    public:
+        explicit RankIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : words(resource), tree(resource) {}
+
+        size_t capacity() const { return words.size() * 64; }
+        bool fits(uint64_t key) const { return key < capacity(); }
+
+        // Empties the index and sets its key range to at least [0, capacity).
+        void reset(size_t capacity)
+        {
+            words.assign((capacity + 63) / 64, 0);
+            tree.assign(words.size() + 1, 0);
+        }
+
+        // Only for a key that fits() and is not in the set yet.
+        void add(uint64_t key)
+        {
+            words[key / 64] |= uint64_t{1} << (key % 64);
+            for (size_t i = static_cast<size_t>(key / 64) + 1; i < tree.size(); i += i & (~i + 1)) ++tree[i];
+        }
+
+        // Keys below `key`.
+        size_t countBelow(uint64_t key) const
+        {
+            key = std::min<uint64_t>(key, capacity());
+            const size_t word = static_cast<size_t>(key / 64);
+            size_t n = 0;
+            for (size_t i = word; i > 0; i -= i & (~i + 1)) n += tree[i];
+            if (key % 64) n += std::bitset<64>(words[word] & ((uint64_t{1} << (key % 64)) - 1)).count();
+            return n;
+        }
+
+    private:
+        std::pmr::vector<uint64_t> words;
+        std::pmr::vector<uint32_t> tree; // 1-based over words, tree[0] unused
+};
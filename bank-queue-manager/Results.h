@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// Outcome of one queue or service action, as a fixed 32-byte record.
+//
+// The manager only fills these in; turning them into text happens in a
+// separate rendering stage (BankQueueManager::flushResults) that works on a
+// batch of records at a time and can emit the classic console text, JSON
+// Lines, the raw records, or nothing at all.
+
+enum class ResultEvent : uint8_t {
+    QUEUED,        // request entered the queue (or was rejected as a duplicate)
+    SERVED,        // request executed
+    FAST_LANE,     // check answered without queueing
+    CANCELED,      // request removed from the queue
+    QUEUE_EMPTY,   // serve with nothing queued
+    HOT,           // account balance split into sub-counters
+    REMOTE_SETTLED, // transfer to another branch committed (OK) or refunded
+    REMOTE_CREDIT   // transfer from another branch credited (OK) or refused
+};
+
+enum class ResultCode : uint8_t {
+    OK,
+    INVALID_AMOUNT,
+    INSUFFICIENT_FUNDS,
+    BALANCE_OVERFLOW,
+    REJECTED,        // multi-transfer failed validation (funds, amounts or targets)
+    ALREADY_QUEUED
+};
+
+enum class OutputFormat {
+    TEXT,     // console messages, through the log
+    JSONL,    // one JSON object per line, through the log
+    BINARY,   // raw ActionResult records appended to a file
+    NONE,     // results are not rendered at all
+    UNKNOWN
+};
+
+struct ActionResult {
+    int32_t ticket;
+    uint32_t client;               // client handle (unused for QUEUE_EMPTY)
+    uint32_t target;               // TRANSFER: target handle, MULTI_TRANSFER: leg count, REMOTE_CREDIT: source branch
+    int32_t amount;
+    int32_t balanceAfter;          // client balance after the action
+    int32_t targetBalanceAfter;    // TRANSFER: target balance after the action
+    uint8_t kind;                  // Service
+    ResultEvent event;
+    ResultCode code;
+    uint8_t reserved[5];
+};
+static_assert(sizeof(ActionResult) == 32, "result records are 32 bytes");
+
+inline const char* result_code_to_string(ResultCode code) {
+    switch (code) {
+        case ResultCode::OK:                 return "ok";
+        case ResultCode::INVALID_AMOUNT:     return "invalid_amount";
+        case ResultCode::INSUFFICIENT_FUNDS: return "insufficient_funds";
+        case ResultCode::BALANCE_OVERFLOW:   return "overflow";
+        case ResultCode::REJECTED:           return "rejected";
+        case ResultCode::ALREADY_QUEUED:     return "already_queued";
+    }
+    return "unknown";
+}
+
+inline const char* result_event_to_string(ResultEvent event) {
+    switch (event) {
+        case ResultEvent::QUEUED:      return "queued";
+        case ResultEvent::SERVED:      return "served";
+        case ResultEvent::FAST_LANE:   return "fast_lane";
+        case ResultEvent::CANCELED:    return "canceled";
+        case ResultEvent::QUEUE_EMPTY: return "queue_empty";
+        case ResultEvent::HOT:         return "hot";
+        case ResultEvent::REMOTE_SETTLED: return "remote_settled";
+        case ResultEvent::REMOTE_CREDIT:  return "remote_credit";
+    }
+    return "unknown";
+}
+
+inline OutputFormat parseOutputFormat(std::string_view str) {
+    if (str == "text") return OutputFormat::TEXT;
+    if (str == "jsonl") return OutputFormat::JSONL;
+    if (str == "binary") return OutputFormat::BINARY;
+    if (str == "none") return OutputFormat::NONE;
+    return OutputFormat::UNKNOWN;
+}
@@ -0,0 +1,312 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
+#include <set>
+#include <string_view>
+#include <vector>
+#include "RankIndex.h"
+
+// The service queue: requests ordered by client class, then arrival ticket,
+// behind one of two interchangeable backends.
+//
+//  - ORDERED_SET: a std::pmr::set ordered by the comparator, with the
+//    iterator of every client's latest request cached by handle. Add, serve
+//    and cancel are O(log n).
+//  - CLASS_FIFO: one FIFO per client class. Tickets only grow, so the order
+//    inside a class is append order, and the queue is the class FIFOs one
+//    after the other: add and serve are O(1). Cancel is O(1) too, and lazy:
+//    the entry is tombstoned in place (ticket 0; real tickets start at 1) and
+//    dropped once it reaches the front. A FIFO whose tombstones outnumber
+//    its live entries is compacted, so add / cancel churn stays bounded.
+//
+// Both also tell how many requests are ahead of any client's latest one,
+// in total and per kind, in O(Kinds log n), with add and serve only bumping
+// counters. Requests are numbered in push order per lane (class and kind).
+// One has ahead of it the classes served before its own, and in every lane
+// of its class the requests numbered below where that lane stood when it
+// was pushed, less those served since and those canceled (a RankIndex of
+// canceled numbers per lane). A cancel numbered past its index renumbers
+// the live requests of its class from 0 and sizes the indexes for twice as
+// many, so it costs O(1) amortized per push and memory stays proportional
+// to the queue.
+//
+// Both serve the same requests in the same order. As in the manager, a
+// handle remembers only the latest request queued for the client: that is
+// the one cancel() removes, and serving or canceling any request of the
+// client forgets it.
+//
+// Request needs `int ticket`, `uint32_t client` (handle) and a `clientType`
+// that converts to a class index below Classes (0 is served first); with
+// Kinds > 1, also a `kind` that converts to an index below Kinds.
+
+enum class SchedulerBackend {
+    ORDERED_SET,
+    CLASS_FIFO,
+    UNKNOWN
+};
+
+inline SchedulerBackend parseSchedulerBackend(std::string_view str) {
+    if (str == "set") return SchedulerBackend::ORDERED_SET;
+    if (str == "fifo") return SchedulerBackend::CLASS_FIFO;
+    return SchedulerBackend::UNKNOWN;
+}
+
+inline const char* scheduler_backend_to_string(SchedulerBackend backend) {
+    switch (backend) {
+        case SchedulerBackend::ORDERED_SET: return "set";
+        case SchedulerBackend::CLASS_FIFO:  return "fifo";
+        default:                            return "UNKNOWN";
+    }
+}
+
+template <typename Request, typename Compare, size_t Classes = 3, size_t Kinds = 1>
+class Scheduler
+{
+    public:
+        using KindCounts = std::array<size_t, Kinds>;
+
+        Scheduler(SchedulerBackend backend, std::pmr::memory_resource* resource)
+            : kind(backend), ordered(resource), orderedByHandle(resource), fifos(resource), fifoByHandle(resource),
+              pushNumbers(resource), canceled(resource)
+        {
+            fifos.resize(Classes); // each deque allocates from `resource` too
+            for (size_t lane = 0; lane < Lanes; ++lane) canceled.emplace_back(resource);
+        }
+
+        SchedulerBackend backend() const { return kind; }
+        size_t size() const { return live; }
+        bool empty() const { return live == 0; }
+
+        // Makes room for the next client handle.
+        void addClient()
+        {
+            if (kind == SchedulerBackend::ORDERED_SET) orderedByHandle.push_back(ordered.end());
+            else fifoByHandle.push_back(kNone);
+            pushNumbers.resize(pushNumbers.size() + Kinds);
+        }
+
+        // Whether the client's latest request is still queued.
+        bool queued(uint32_t client) const
+        {
+            if (kind == SchedulerBackend::ORDERED_SET) return orderedByHandle[client] != ordered.end();
+            return fifoByHandle[client] != kNone;
+        }
+
+        // Queues `request` as its client's latest; false if an equal request
+        // (same class and ticket) is already queued.
+        bool push(const Request& request)
+        {
+            if (kind == SchedulerBackend::ORDERED_SET) {
+                auto [it, inserted] = ordered.insert(request);
+                if (!inserted) return false;
+                orderedByHandle[request.client] = it;
+            } else {
+                const size_t cls = static_cast<size_t>(request.clientType);
+                std::pmr::deque<Request>& fifo = fifos[cls];
+                fifoByHandle[request.client] = locator(cls, popped[cls] + fifo.size());
+                fifo.push_back(request);
+            }
+            const size_t first = laneOf(request) - kindOf(request);
+            uint64_t* numbers = &pushNumbers[size_t{request.client} * Kinds];
+            for (size_t k = 0; k < Kinds; ++k) numbers[k] = pushed[first + k];
+            ++pushed[laneOf(request)];
+            ++queuedByLane[laneOf(request)];
+            ++live;
+            return true;
+        }
+
+        // Removes and returns the next request to serve. Not on an empty queue.
+        Request popFront()
+        {
+            Request request;
+            if (kind == SchedulerBackend::ORDERED_SET) {
+                request = *ordered.begin();
+                ordered.erase(ordered.begin());
+                orderedByHandle[request.client] = ordered.end();
+            } else {
+                size_t cls = 0;
+                while (fifos[cls].empty()) ++cls; // fronts are never tombstones
+                request = fifos[cls].front();
+                dropFront(cls);
+                fifoByHandle[request.client] = kNone;
+            }
+            ++served[laneOf(request)];
+            --queuedByLane[laneOf(request)];
+            --live;
+            return request;
+        }
+
+        // Removes and returns the client's latest request. Only if queued().
+        Request remove(uint32_t client)
+        {
+            Request request;
+            if (kind == SchedulerBackend::ORDERED_SET) {
+                request = *orderedByHandle[client];
+                ordered.erase(orderedByHandle[client]);
+                orderedByHandle[client] = ordered.end();
+            } else {
+                const uint64_t loc = fifoByHandle[client];
+                const size_t cls = static_cast<size_t>(loc % Classes);
+                std::pmr::deque<Request>& fifo = fifos[cls];
+                Request& entry = fifo[static_cast<size_t>(loc / Classes - popped[cls])];
+                request = entry;
+                entry.ticket = kTombstone;
+                fifoByHandle[client] = kNone;
+                ++tombstones[cls];
+                if (&entry == &fifo.front()) dropFront(cls);
+                else if (tombstones[cls] > kCompactFloor && 2 * tombstones[cls] > fifo.size()) compact(cls);
+            }
+            const size_t lane = laneOf(request);
+            const uint64_t number = pushNumbers[size_t{client} * Kinds + kindOf(request)];
+            --queuedByLane[lane];
+            if (canceled[lane].fits(number)) canceled[lane].add(number);
+            else renumber(static_cast<size_t>(request.clientType));
+            --live;
+            return request;
+        }
+
+        // The client's latest request. Only if queued().
+        const Request& latest(uint32_t client) const
+        {
+            if (kind == SchedulerBackend::ORDERED_SET) return *orderedByHandle[client];
+            const uint64_t loc = fifoByHandle[client];
+            const size_t cls = static_cast<size_t>(loc % Classes);
+            return fifos[cls][static_cast<size_t>(loc / Classes - popped[cls])];
+        }
+
+        // Requests served before the client's latest one (0: it is next).
+        // Only if queued().
+        size_t position(uint32_t client) const
+        {
+            size_t ahead = 0;
+            for (size_t n : aheadByKind(client)) ahead += n;
+            return ahead;
+        }
+
+        // The same requests, counted by kind.
+        KindCounts aheadByKind(uint32_t client) const
+        {
+            const size_t cls = static_cast<size_t>(latest(client).clientType);
+            KindCounts ahead{};
+            for (size_t lane = 0; lane < cls * Kinds; ++lane) ahead[lane % Kinds] += queuedByLane[lane];
+            const uint64_t* numbers = &pushNumbers[size_t{client} * Kinds];
+            for (size_t k = 0; k < Kinds; ++k) {
+                const size_t lane = cls * Kinds + k;
+                ahead[k] += static_cast<size_t>(numbers[k] - served[lane] - canceled[lane].countBelow(numbers[k]));
+            }
+            return ahead;
+        }
+
+        // Calls fn(const Request&) for every queued request, in serve order.
+        template <typename Fn>
+        void forEach(Fn&& fn) const
+        {
+            if (kind == SchedulerBackend::ORDERED_SET) {
+                for (const Request& request : ordered) fn(request);
+                return;
+            }
+            for (const std::pmr::deque<Request>& fifo : fifos) {
+                for (const Request& request : fifo) {
+                    if (request.ticket != kTombstone) fn(request);
+                }
+            }
+        }
+
+    private:
+        static constexpr uint64_t kNone = UINT64_MAX;
+        static constexpr int kTombstone = 0;
+        static constexpr size_t kCompactFloor = 64;
+
+        SchedulerBackend kind;
+        size_t live = 0;
+
+        // ORDERED_SET
+        std::pmr::set<Request, Compare> ordered;
+        std::pmr::vector<typename std::pmr::set<Request, Compare>::iterator> orderedByHandle; // end(): nothing queued
+
+        // CLASS_FIFO. An entry's sequence number counts every entry ever
+        // appended to its FIFO, so its index is sequence - popped[class].
+        std::pmr::vector<std::pmr::deque<Request>> fifos;
+        std::pmr::vector<uint64_t> fifoByHandle; // locator of the latest request, kNone: nothing queued
+        std::array<uint64_t, Classes> popped{};
+        std::array<size_t, Classes> tombstones{};
+
+        // Positions, by lane (class * Kinds + kind): requests numbered and
+        // served, canceled numbers; and where every lane of its class stood
+        // when each client's latest request was pushed (Kinds per handle).
+        static constexpr size_t Lanes = Classes * Kinds;
+        static constexpr size_t kMinRankCapacity = 1024;
+        std::array<uint64_t, Lanes> pushed{};
+        std::array<uint64_t, Lanes> served{};
+        std::array<size_t, Lanes> queuedByLane{};
+        std::pmr::vector<uint64_t> pushNumbers;
+        std::pmr::vector<RankIndex> canceled;
+
+        static uint64_t locator(size_t cls, uint64_t sequence) { return sequence * Classes + cls; }
+
+        static size_t kindOf(const Request& request)
+        {
+            if constexpr (Kinds == 1) return 0;
+            else return static_cast<size_t>(request.kind);
+        }
+        static size_t laneOf(const Request& request) { return static_cast<size_t>(request.clientType) * Kinds + kindOf(request); }
+
+        // Pops the front entry and any tombstones behind it.
+        void dropFront(size_t cls)
+        {
+            std::pmr::deque<Request>& fifo = fifos[cls];
+            do {
+                if (fifo.front().ticket == kTombstone) --tombstones[cls];
+                fifo.pop_front();
+                ++popped[cls];
+            } while (!fifo.empty() && fifo.front().ticket == kTombstone);
+        }
+
+        // Squeezes the tombstones out, renumbering the live entries.
+        void compact(size_t cls)
+        {
+            std::pmr::deque<Request>& fifo = fifos[cls];
+            size_t kept = 0;
+            for (size_t i = 0; i < fifo.size(); ++i) {
+                if (fifo[i].ticket == kTombstone) continue;
+                uint64_t& loc = fifoByHandle[fifo[i].client];
+                if (loc == locator(cls, popped[cls] + i)) loc = locator(cls, popped[cls] + kept);
+                fifo[kept++] = fifo[i];
+            }
+            fifo.resize(kept);
+            tombstones[cls] = 0;
+        }
+
+        // Numbers the live requests of a class from 0 per lane, in serve
+        // order, and empties the canceled indexes of its lanes.
+        void renumber(size_t cls)
+        {
+            std::array<uint64_t, Kinds> next{};
+            auto visit = [&](const Request& request, bool latest) {
+                if (latest) std::copy(next.begin(), next.end(), &pushNumbers[size_t{request.client} * Kinds]);
+                ++next[kindOf(request)];
+            };
+            if (kind == SchedulerBackend::ORDERED_SET) {
+                Request first{};
+                first.clientType = static_cast<decltype(first.clientType)>(cls);
+                first.ticket = kTombstone; // below every ticket
+                for (auto it = ordered.lower_bound(first); it != ordered.end() && static_cast<size_t>(it->clientType) == cls; ++it)
+                    visit(*it, orderedByHandle[it->client] == it);
+            } else {
+                const std::pmr::deque<Request>& fifo = fifos[cls];
+                for (size_t i = 0; i < fifo.size(); ++i) {
+                    if (fifo[i].ticket != kTombstone) visit(fifo[i], fifoByHandle[fifo[i].client] == locator(cls, popped[cls] + i));
+                }
+            }
+            for (size_t k = 0; k < Kinds; ++k) {
+                const size_t lane = cls * Kinds + k;
+                pushed[lane] = next[k];
+                served[lane] = 0;
+                canceled[lane].reset(std::max(kMinRankCapacity, 2 * static_cast<size_t>(next[k])));
+            }
+        }
+};
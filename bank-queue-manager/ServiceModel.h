@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Online model of service times, for wait estimates.
+//
+// A teller (the console, or one TCP session) takes a request with `serve`
+// and is busy with it until its own next `serve`: that interval is the
+// request's service time. It is recorded for the request's kind and for the
+// teller, unless the queue ran empty in between (the teller may have sat
+// idle), or the teller served with nothing queued or went away.
+//
+// Every series keeps an EWMA (weight 1/kEwmaWeight) for the recent mean and a
+// log-linear sketch for quantiles: 8 buckets per power of two (12.5% wide)
+// from 1 ns to ~73 minutes, halved every kSketchWindow samples so it follows
+// drift. Each teller also keeps its pace: an EWMA of its service times over
+// the mean of their kind, so a slow teller is told apart from a slow mix.
+//
+// predictWaitNs() treats the busy tellers as one pool working at the sum of
+// their speeds: the expected work of the requests ahead, by kind, plus what
+// the busy tellers have left of theirs, over that pool. It is O(Kinds +
+// tellers); the model itself is updated in O(1) per serve.
+
+// Recent distribution of one series of service times.
+class ServiceTimeSeries
+{
+    public:
+        static constexpr unsigned kSubBits = 3;
+        static constexpr unsigned kMaxBits = 42;
+        static constexpr size_t kSub = size_t(1) << kSubBits;
+        static constexpr size_t kBuckets = (kMaxBits - kSubBits + 1) * kSub;
+        static constexpr int64_t kEwmaWeight = 8;
+        static constexpr uint32_t kSketchWindow = 1024;
+
+        void record(int64_t ns)
+        {
+            ns = std::max<int64_t>(ns, 0);
+            ewma = total ? ewma + (ns - ewma) / kEwmaWeight : ns;
+            ++total;
+            ++counts[bucketOf(static_cast<uint64_t>(ns))];
+            if (++inSketch == 2 * kSketchWindow) { // halve: older samples weigh less
+                inSketch = 0;
+                for (uint32_t& c : counts) inSketch += c >>= 1;
+            }
+        }
+
+        uint64_t samples() const { return total; }
+        int64_t mean() const { return ewma; }
+
+        // Upper bound of the bucket holding the q-quantile (0 <= q <= 1) of
+        // the recent samples; 0 without samples.
+        int64_t quantile(double q) const
+        {
+            if (inSketch == 0) return 0;
+            const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(q * inSketch + 0.5), 1, inSketch);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBuckets; ++i) {
+                seen += counts[i];
+                if (seen >= rank) return static_cast<int64_t>(bucketUpper(i));
+            }
+            return static_cast<int64_t>(bucketUpper(kBuckets - 1));
+        }
+
+    private:
+        std::array<uint32_t, kBuckets> counts{};
+        uint32_t inSketch = 0;   // sum of counts
+        uint64_t total = 0;      // ever recorded
+        int64_t ewma = 0;
+
+        static size_t bucketOf(uint64_t ns)
+        {
+            if (ns < kSub) return static_cast<size_t>(ns);
+            if (ns >> kMaxBits) return kBuckets - 1;
+            const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+            return static_cast<size_t>((msb - kSubBits + 1) * kSub + (ns >> (msb - kSubBits)) - kSub);
+        }
+
+        static uint64_t bucketUpper(size_t i)
+        {
+            if (i < kSub) return i;
+            const unsigned shift = static_cast<unsigned>(i / kSub - 1);
+            return ((i % kSub + kSub + 1) << shift) - 1;
+        }
+};
+
+template <size_t Kinds>
+class ServiceModel
+{
+    public:
+        using KindCounts = std::array<size_t, Kinds>;
+        static constexpr uint32_t kConsoleTeller = 0; // open from the start
+        static constexpr int64_t kPaceOne = 1024;     // pace of a teller as fast as the mean
+
+        ServiceModel() { openTeller(); }
+
+        // A new teller id (reusing closed ones); its series start empty.
+        uint32_t openTeller()
+        {
+            uint32_t id = static_cast<uint32_t>(tellers.size());
+            if (freeTellers.empty()) {
+                tellers.emplace_back();
+            } else {
+                id = freeTellers.back();
+                freeTellers.pop_back();
+                tellers[id] = Teller();
+            }
+            tellers[id].open = true;
+            return id;
+        }
+
+        void closeTeller(uint32_t teller)
+        {
+            idle(teller);
+            tellers[teller].open = false;
+            freeTellers.push_back(teller);
+        }
+
+        // `teller` took a request of `kind` at `nowNs` (steady clock), which
+        // ends its previous request.
+        void served(uint32_t teller, size_t kind, int64_t nowNs)
+        {
+            Teller& t = tellers[teller];
+            if (t.sinceNs && t.epoch == emptyEpoch) record(t, t.kind, nowNs - t.sinceNs);
+            if (!t.sinceNs) ++busy;
+            t.sinceNs = nowNs;
+            t.kind = static_cast<uint32_t>(kind);
+            t.epoch = emptyEpoch;
+        }
+
+        // `teller` has nothing in hand (it served an empty queue).
+        void idle(uint32_t teller)
+        {
+            Teller& t = tellers[teller];
+            if (t.sinceNs) --busy;
+            t.sinceNs = 0;
+        }
+
+        // The queue ran empty: whatever tellers hold now ends in idle time.
+        void queueEmptied() { ++emptyEpoch; }
+
+        // Expected ns until a teller takes a request with `ahead[k]` requests
+        // of kind k ahead of it; -1 before the first sample.
+        int64_t predictWaitNs(const KindCounts& ahead, int64_t nowNs) const
+        {
+            if (all.samples() == 0) return -1;
+            double work = 0;
+            for (size_t k = 0; k < Kinds; ++k) work += static_cast<double>(ahead[k]) * meanNs(k);
+            double speed = 0; // in tellers of mean pace
+            for (const Teller& t : tellers) {
+                if (!t.open || !t.sinceNs) continue;
+                const double left = meanNs(t.kind) * t.pace / kPaceOne - static_cast<double>(nowNs - t.sinceNs);
+                work += std::max(left, 0.0);
+                speed += static_cast<double>(kPaceOne) / t.pace;
+            }
+            if (speed == 0) speed = 1; // nobody serving: assume one teller
+            return static_cast<int64_t>(work / speed);
+        }
+
+        // Mean service time of a kind, or of all kinds while it has no samples.
+        int64_t meanNs(size_t kind) const { return kinds[kind].samples() ? kinds[kind].mean() : all.mean(); }
+
+        const ServiceTimeSeries& byKind(size_t kind) const { return kinds[kind]; }
+        const ServiceTimeSeries& overall() const { return all; }
+        size_t busyTellers() const { return busy; }
+
+        // Calls fn(id, series, pace, busy) for every open teller.
+        template <typename Fn>
+        void forEachTeller(Fn&& fn) const
+        {
+            for (uint32_t id = 0; id < tellers.size(); ++id) {
+                const Teller& t = tellers[id];
+                if (t.open) fn(id, t.times, t.pace, t.sinceNs != 0);
+            }
+        }
+
+    private:
+        struct Teller {
+            bool open = false;
+            uint32_t kind = 0;       // of the request in hand
+            int64_t sinceNs = 0;     // took it at; 0: nothing in hand
+            uint64_t epoch = 0;      // emptyEpoch when taken
+            int64_t pace = kPaceOne; // EWMA of its service time / the kind's mean, * kPaceOne
+            ServiceTimeSeries times;
+        };
+
+        std::array<ServiceTimeSeries, Kinds> kinds;
+        ServiceTimeSeries all;
+        std::vector<Teller> tellers;
+        std::vector<uint32_t> freeTellers;
+        uint64_t emptyEpoch = 0;
+        size_t busy = 0;
+
+        void record(Teller& t, size_t kind, int64_t ns)
+        {
+            const int64_t mean = meanNs(kind);
+            if (mean > 0) {
+                const int64_t pace = std::clamp<int64_t>(ns * kPaceOne / mean, kPaceOne / 16, kPaceOne * 16);
+                t.pace += (pace - t.pace) / ServiceTimeSeries::kEwmaWeight;
+            }
+            kinds[kind].record(ns);
+            all.record(ns);
+            t.times.record(ns);
+        }
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded single-producer / single-consumer ring.
+//
+// One thread pushes, one thread pops; neither ever blocks or takes a lock.
+// The two indexes live on separate cache lines, and each side keeps a private
+// copy of the other's index, refreshed only when the ring looks full (or
+// empty), so in steady state a push or a pop touches no line the other thread
+// is writing. N must be a power of two. Rings are large: allocate them on the
+// heap.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    public:
+        // Producer side. False when the ring is full.
+        bool tryPush(const T& value)
+        {
+            const uint64_t h = head.load(std::memory_order_relaxed);
+            if (h - cachedTail >= N) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (h - cachedTail >= N) return false;
+            }
+            slots[h & (N - 1)] = value;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side. False when the ring is empty.
+        bool tryPop(T& value)
+        {
+            const uint64_t t = tail.load(std::memory_order_relaxed);
+            if (t == cachedHead) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (t == cachedHead) return false;
+            }
+            value = slots[t & (N - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        alignas(64) std::atomic<uint64_t> head{0}; // next slot the producer writes
+        uint64_t cachedTail = 0;                    // producer's view of `tail`
+        alignas(64) std::atomic<uint64_t> tail{0}; // next slot the consumer reads
+        uint64_t cachedHead = 0;                    // consumer's view of `head`
+        alignas(64) T slots[N];
+};
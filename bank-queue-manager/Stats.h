@@ -0,0 +1,333 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Latency histograms and event counters for the hot path.
+//
+// Every recording thread owns a shard of log-linear (HDR-style) histograms,
+// one per metric: values below 2^kSubBits ns get a bucket each, and every
+// power of two above is split into 2^kSubBits buckets, so a bucket is never
+// wider than 1/64 of its values (~1.6%) from 1 ns to 2^kMaxBits ns (~18
+// minutes; longer values land in the last bucket). Recording is two relaxed
+// atomic stores into the caller's own shard: no lock, no shared cache line.
+//
+// snapshot() merges every shard on demand. reset() does not touch the shards
+// (their writers may be running); it remembers the current totals instead,
+// and later snapshots subtract them.
+//
+// Event counters (StatsCounters) use the same per-thread scheme. They only
+// grow, for the metrics endpoint (MetricsServer.h) to derive rates and
+// queue depths from.
+
+enum class LatencyMetric : uint8_t {
+    ADD,                  // add: request built and queued
+    CANCEL,
+    SERVE_DEPOSIT,        // serve, by Service (same order)
+    SERVE_WITHDRAW,
+    SERVE_CHECK,
+    SERVE_TRANSFER,
+    SERVE_MULTI_TRANSFER,
+    WAIT_VIP,             // ticket issued -> served, by ClientType (same order)
+    WAIT_BUSINESS,
+    WAIT_REGULAR,
+    COUNT
+};
+
+inline constexpr std::array<const char*, static_cast<size_t>(LatencyMetric::COUNT)> kLatencyMetricNames = {
+    "add", "cancel",
+    "serve.deposit", "serve.withdraw", "serve.check", "serve.transfer", "serve.multitransfer",
+    "wait.vip", "wait.business", "wait.regular"};
+
+enum class StatsCounter : uint8_t {
+    QUEUED_VIP,           // requests queued, by ClientType (same order)
+    QUEUED_BUSINESS,
+    QUEUED_REGULAR,
+    SERVED_VIP,           // requests served
+    SERVED_BUSINESS,
+    SERVED_REGULAR,
+    CANCELED_VIP,         // requests canceled
+    CANCELED_BUSINESS,
+    CANCELED_REGULAR,
+    FAST_LANE_CHECKS,     // checks answered without queueing
+    FAILED_WITHDRAWALS,
+    FAILED_TRANSFERS,     // transfers and multi-transfers
+    COUNT
+};
+
+// Per-thread shards of one registry. Each writing thread gets a Shard on
+// first use and hands it back when it exits; the next new thread takes it
+// over, counts and all, so totals are unaffected and memory is bounded by the
+// peak number of concurrent writers rather than by every thread ever seen
+// (gRPC's sync server starts and retires threads as load changes). A Shard
+// with an adopt() member has it called, under the lock, before the new owner
+// writes. Readers visit all shards under the lock. One registry per Shard
+// type (the thread-local slot is per type), which the singletons below
+// guarantee.
+template <typename Shard>
+class ThreadShards
+{
+    public:
+        Shard& local()
+        {
+            thread_local Shard* shard = nullptr;
+            if (!shard) {
+                thread_local Lease lease(*this); // returns the shard at thread exit
+                shard = lease.shard;
+            }
+            return *shard;
+        }
+
+        // Calls fn(Shard&) for every shard; `locked` runs under the same lock,
+        // after them.
+        template <typename Fn, typename Locked>
+        void forEach(Fn&& fn, Locked&& locked)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& shard : shards) fn(*shard);
+            locked();
+        }
+
+    private:
+        template <typename T, typename = void>
+        struct HasAdopt : std::false_type {};
+        template <typename T>
+        struct HasAdopt<T, std::void_t<decltype(std::declval<T&>().adopt())>> : std::true_type {};
+
+        struct Lease {
+            ThreadShards& owner;
+            Shard* shard;
+
+            explicit Lease(ThreadShards& owner) : owner(owner), shard(owner.acquire()) {}
+            ~Lease() { owner.release(shard); }
+        };
+
+        std::mutex mutex; // guards both lists; taken when a writing thread starts or exits and by readers
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<Shard*> idle; // shards of exited threads, waiting for a new one
+
+        Shard* acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (idle.empty()) {
+                shards.push_back(std::make_unique<Shard>());
+                return shards.back().get();
+            }
+            Shard* shard = idle.back();
+            idle.pop_back();
+            if constexpr (HasAdopt<Shard>::value) shard->adopt();
+            return shard;
+        }
+
+        void release(Shard* shard)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.push_back(shard);
+        }
+};
+
+// One merged histogram; plain counters, owned by the reader.
+struct LatencyHistogram {
+    static constexpr unsigned kSubBits = 6;
+    static constexpr unsigned kMaxBits = 40;
+    static constexpr size_t kSub = size_t(1) << kSubBits;
+    static constexpr size_t kBuckets = (kMaxBits - kSubBits + 1) * kSub;
+
+    std::array<uint64_t, kBuckets> counts{};
+    uint64_t count = 0;
+    uint64_t sum = 0; // ns
+
+    static size_t bucketOf(uint64_t ns)
+    {
+        if (ns < kSub) return static_cast<size_t>(ns);
+        if (ns >> kMaxBits) return kBuckets - 1;
+        const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+        return static_cast<size_t>((msb - kSubBits + 1) * kSub + (ns >> (msb - kSubBits)) - kSub);
+    }
+
+    // Highest value that lands in bucket `i`.
+    static uint64_t bucketUpper(size_t i)
+    {
+        if (i < kSub) return i;
+        const unsigned shift = static_cast<unsigned>(i / kSub - 1);
+        return ((i % kSub + kSub + 1) << shift) - 1;
+    }
+
+    double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+
+    // Upper bound of the bucket holding the q-quantile (0 <= q <= 1); 0 when empty.
+    uint64_t percentile(double q) const
+    {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * count + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > count) rank = count;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return bucketUpper(i);
+        }
+        return bucketUpper(kBuckets - 1);
+    }
+
+    uint64_t max() const { return percentile(1.0); }
+};
+
+struct LatencySnapshot {
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyMetric::COUNT)> metrics;
+
+    const LatencyHistogram& operator[](LatencyMetric m) const { return metrics[static_cast<size_t>(m)]; }
+};
+
+class LatencyStats
+{
+    public:
+        static LatencyStats& instance()
+        {
+            static LatencyStats stats;
+            return stats;
+        }
+
+        LatencyStats(const LatencyStats&) = delete;
+        LatencyStats& operator=(const LatencyStats&) = delete;
+
+        void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+        // Steady-clock time in ns to pass to record(); 0 while recording is
+        // off, which record() ignores.
+        int64_t start() const
+        {
+            if (!enabled.load(std::memory_order_relaxed)) return 0;
+            return now();
+        }
+
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Records the time since `startNs` (from start()); returns the end time.
+        int64_t record(LatencyMetric metric, int64_t startNs)
+        {
+            if (startNs == 0) return 0;
+            const int64_t end = now();
+            recordValue(metric, static_cast<uint64_t>(end > startNs ? end - startNs : 0));
+            return end;
+        }
+
+        void recordValue(LatencyMetric metric, uint64_t ns)
+        {
+            Shard::Histogram& h = shards.local().metrics[static_cast<size_t>(metric)];
+            std::atomic<uint64_t>& bucket = h.counts[LatencyHistogram::bucketOf(ns)];
+            // Single writer per shard: load + store, no read-modify-write.
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            h.sum.store(h.sum.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        }
+
+        // Everything recorded by every thread since the last reset(), or
+        // since the start with `sinceReset` false. On the heap: a snapshot
+        // is ~180 KB.
+        std::unique_ptr<LatencySnapshot> snapshot(bool sinceReset = true)
+        {
+            auto merged = std::make_unique<LatencySnapshot>();
+            auto base = std::make_unique<LatencySnapshot>();
+            shards.forEach([&](const Shard& shard) { merge(shard, *merged); },
+                           [&] { if (sinceReset) *base = *baseline; });
+            for (size_t m = 0; sinceReset && m < merged->metrics.size(); ++m) {
+                LatencyHistogram& h = merged->metrics[m];
+                const LatencyHistogram& from = base->metrics[m];
+                h.count = 0;
+                for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+                    h.counts[i] -= from.counts[i];
+                    h.count += h.counts[i];
+                }
+                h.sum -= from.sum;
+            }
+            return merged;
+        }
+
+        void reset()
+        {
+            auto merged = std::make_unique<LatencySnapshot>();
+            shards.forEach([&](const Shard& shard) { merge(shard, *merged); },
+                           [&] { baseline = std::move(merged); });
+        }
+
+    private:
+        struct Shard {
+            struct Histogram {
+                std::array<std::atomic<uint64_t>, LatencyHistogram::kBuckets> counts{};
+                std::atomic<uint64_t> sum{0};
+            };
+            std::array<Histogram, static_cast<size_t>(LatencyMetric::COUNT)> metrics{};
+        };
+
+        std::atomic<bool> enabled{true};
+        ThreadShards<Shard> shards;
+        std::unique_ptr<LatencySnapshot> baseline = std::make_unique<LatencySnapshot>(); // guarded by the shards' lock
+
+        LatencyStats() = default;
+
+        static void merge(const Shard& shard, LatencySnapshot& merged)
+        {
+            for (size_t m = 0; m < merged.metrics.size(); ++m) {
+                const Shard::Histogram& from = shard.metrics[m];
+                LatencyHistogram& to = merged.metrics[m];
+                for (size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+                    const uint64_t n = from.counts[i].load(std::memory_order_relaxed);
+                    to.counts[i] += n;
+                    to.count += n;
+                }
+                to.sum += from.sum.load(std::memory_order_relaxed);
+            }
+        }
+};
+
+class StatsCounters
+{
+    public:
+        using Values = std::array<uint64_t, static_cast<size_t>(StatsCounter::COUNT)>;
+
+        static StatsCounters& instance()
+        {
+            static StatsCounters counters;
+            return counters;
+        }
+
+        StatsCounters(const StatsCounters&) = delete;
+        StatsCounters& operator=(const StatsCounters&) = delete;
+
+        void add(StatsCounter counter, uint64_t n = 1)
+        {
+            std::atomic<uint64_t>& c = shards.local().values[static_cast<size_t>(counter)];
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        // Totals over every thread since the start.
+        Values snapshot()
+        {
+            Values totals{};
+            shards.forEach([&](const Shard& shard) {
+                for (size_t i = 0; i < totals.size(); ++i) totals[i] += shard.values[i].load(std::memory_order_relaxed);
+            }, [] {});
+            return totals;
+        }
+
+    private:
+        struct Shard {
+            std::array<std::atomic<uint64_t>, static_cast<size_t>(StatsCounter::COUNT)> values{};
+        };
+
+        ThreadShards<Shard> shards;
+
+        StatsCounters() = default;
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <string_view>
+
+// Chrome trace-event instrumentation (opens in Perfetto or chrome://tracing).
+//
+// BANKQ_TRACE_SCOPE("name") times the rest of the enclosing block as one
+// complete ("X") event. Builds without -DBANKQ_TRACE compile it to nothing.
+// With it, each thread records into its own ring of Tracer::kRingEvents events,
+// overwriting the oldest: a flight recorder that always holds the latest
+// activity. An event is two TSC reads and three relaxed stores into the
+// caller's ring; the reads dominate, and it stays under 40 ns even on a VM
+// that makes each one cost ~20 ns (benchmarks/trace_benchmark.cpp).
+//
+// traceDump() writes what the rings hold as trace_event JSON; call it when
+// the latency spike of interest has just happened (`trace dump <file>`).
+// Event names must be string literals: only the pointer is recorded.
+
+#if defined(BANKQ_TRACE)
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Stats.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+inline constexpr bool kTraceCompiled = true;
+
+class Tracer
+{
+    public:
+        static constexpr size_t kRingEvents = size_t(1) << 15; // per thread, a power of two
+
+        static Tracer& instance()
+        {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        // Cycle counter on x86, steady-clock ns elsewhere.
+        static uint64_t ticks()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        void record(const char* name, uint64_t begin, uint64_t end)
+        {
+            Ring& ring = shards.local();
+            const uint64_t head = ring.head.load(std::memory_order_relaxed);
+            Event& e = ring.events[head & (kRingEvents - 1)];
+            e.name.store(name, std::memory_order_relaxed);
+            e.begin.store(begin, std::memory_order_relaxed);
+            e.end.store(end, std::memory_order_relaxed);
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        // Writes every event still held by the rings as trace_event JSON.
+        bool dump(const std::string& path)
+        {
+            const double ticksPerUs = calibrate();
+            std::FILE* out = std::fopen(path.c_str(), "w");
+            if (!out) return false;
+            const int pid = static_cast<int>(::getpid());
+            std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+            std::fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"bankq\"}}", pid);
+            std::vector<Copy> events;
+            shards.forEach([&](const Ring& ring) {
+                copy(ring, events);
+                for (const Copy& e : events) {
+                    std::fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"bankq\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                                 e.name, pid, ring.tid.load(std::memory_order_relaxed), static_cast<int64_t>(e.begin - origin) / ticksPerUs,
+                                 (e.end - e.begin) / ticksPerUs);
+                }
+            }, [] {});
+            std::fprintf(out, "\n]}\n");
+            return std::fclose(out) == 0;
+        }
+
+        // Forgets every recorded event.
+        void clear()
+        {
+            shards.forEach([](Ring& ring) {
+                ring.floor.store(ring.head.load(std::memory_order_acquire), std::memory_order_relaxed);
+            }, [] {});
+        }
+
+    private:
+        // Fields are relaxed atomics: a dump may read a slot its writer is
+        // overwriting, and drops it by the ring's head afterwards.
+        struct Event {
+            std::atomic<const char*> name{nullptr};
+            std::atomic<uint64_t> begin{0};
+            std::atomic<uint64_t> end{0};
+        };
+
+        struct Ring {
+            alignas(64) std::atomic<uint64_t> head{0}; // events ever recorded
+            std::atomic<uint64_t> floor{0};            // set by clear(): older events are gone
+            std::atomic<int> tid{static_cast<int>(::syscall(SYS_gettid))};
+            std::unique_ptr<Event[]> events{new Event[kRingEvents]};
+
+            // Taken over from an exited thread (see ThreadShards): its events
+            // would show under the new tid, so they are dropped.
+            void adopt()
+            {
+                tid.store(static_cast<int>(::syscall(SYS_gettid)), std::memory_order_relaxed);
+                floor.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        };
+
+        struct Copy {
+            const char* name;
+            uint64_t begin;
+            uint64_t end;
+        };
+
+        ThreadShards<Ring> shards;
+        const uint64_t origin = ticks();
+        const std::chrono::steady_clock::time_point originTime = std::chrono::steady_clock::now();
+
+        Tracer() = default;
+
+        // Ticks per microsecond, measured against the steady clock since the
+        // tracer started (at least 10 ms of it).
+        double calibrate() const
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            auto elapsed = std::chrono::steady_clock::now() - originTime;
+            if (elapsed < std::chrono::milliseconds(10)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+                elapsed = std::chrono::steady_clock::now() - originTime;
+            }
+            const uint64_t now = ticks();
+            return (now - origin) / std::chrono::duration<double, std::micro>(elapsed).count();
+#else
+            return 1000.0;
+#endif
+        }
+
+        static void copy(const Ring& ring, std::vector<Copy>& events)
+        {
+            events.clear();
+            const uint64_t head = ring.head.load(std::memory_order_acquire);
+            const uint64_t from = std::max(ring.floor.load(std::memory_order_relaxed),
+                                           head > kRingEvents ? head - kRingEvents : 0);
+            for (uint64_t i = from; i < head; ++i) {
+                const Event& e = ring.events[i & (kRingEvents - 1)];
+                events.push_back({e.name.load(std::memory_order_relaxed), e.begin.load(std::memory_order_relaxed),
+                                  e.end.load(std::memory_order_relaxed)});
+            }
+            // Slots the writer reused while they were copied.
+            const uint64_t after = ring.head.load(std::memory_order_acquire);
+            const uint64_t lost = after > kRingEvents ? after - kRingEvents : 0;
+            if (lost > from) events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(lost - from, head - from)));
+        }
+};
+
+class TraceScope
+{
+    public:
+        // The tracer exists before the first tick is read: events start after its origin.
+        explicit TraceScope(const char* name) : tracer(Tracer::instance()), name(name), begin(Tracer::ticks()) {}
+        ~TraceScope() { tracer.record(name, begin, Tracer::ticks()); }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        Tracer& tracer;
+        const char* name;
+        uint64_t begin;
+};
+
+#define BANKQ_TRACE_CONCAT_(a, b) a##b
+#define BANKQ_TRACE_CONCAT(a, b) BANKQ_TRACE_CONCAT_(a, b)
+#define BANKQ_TRACE_SCOPE(name) TraceScope BANKQ_TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+inline bool traceDump(std::string_view path) { return Tracer::instance().dump(std::string(path)); }
+inline void traceClear() { Tracer::instance().clear(); }
+
+#else
+
+inline constexpr bool kTraceCompiled = false;
+
+#define BANKQ_TRACE_SCOPE(name) static_cast<void>(0)
+
+inline bool traceDump(std::string_view) { return false; }
+inline void traceClear() {}
+
+#endif
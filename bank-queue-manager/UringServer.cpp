@@ -0,0 +1,446 @@
+#include "UringServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// --- IoUring ---
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+void IoUring::release()
+{
+    if (bufRing) ::munmap(bufRing, bufRingSize);
+    if (sqes) ::munmap(sqes, sqesSize);
+    if (cqMap && cqMap != sqMap) ::munmap(cqMap, cqMapSize);
+    if (sqMap) ::munmap(sqMap, sqMapSize);
+    if (ringFd >= 0) ::close(ringFd);
+    bufRing = nullptr;
+    sqes = nullptr;
+    cqMap = sqMap = nullptr;
+    ringFd = -1;
+}
+
+bool IoUring::init(unsigned entries, unsigned cqEntries, unsigned flags)
+{
+    release();
+
+    io_uring_params params{};
+    params.flags = flags | IORING_SETUP_CQSIZE;
+    params.cq_entries = cqEntries;
+    ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0) return false;
+
+    sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+    auto map = [this](size_t size, off_t offset) -> void* {
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    };
+    sqMap = map(sqMapSize, IORING_OFF_SQ_RING);
+    cqMap = singleMap ? sqMap : map(cqMapSize, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(map(sqesSize, IORING_OFF_SQES));
+    if (!sqMap || !cqMap || !sqes) {
+        const int err = errno;
+        release();
+        errno = err;
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqMap);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqeTail = *sqTail;
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) array[i] = i; // slot i always holds sqes[i]
+
+    char* cq = static_cast<char*>(cqMap);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+bool IoUring::enable()
+{
+    return ::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) == 0;
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+    if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        submitAndWait(0);
+        if (sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes[sqeTail & *sqMask];
+    ++sqeTail;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool IoUring::submitAndWait(unsigned waitFor)
+{
+    __atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+    while (true) {
+        const unsigned toSubmit = sqeTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        const long r = ::syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor,
+                                 waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (r >= 0) return true;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EBUSY) return true; // completions must be reaped first
+        return false;
+    }
+}
+
+bool IoUring::registerBufferRing(uint16_t group, char* base, unsigned count, unsigned size)
+{
+    bufRingSize = count * sizeof(io_uring_buf);
+    void* mem = ::mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    bufRing = static_cast<io_uring_buf*>(mem);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+
+    bufBase = base;
+    bufSize = size;
+    bufMask = static_cast<uint16_t>(count - 1);
+    bufGroup = group;
+    bufTail = 0;
+    for (unsigned i = 0; i < count; ++i) returnBuffer(static_cast<uint16_t>(i));
+    publishBuffers();
+    return true;
+}
+
+void IoUring::returnBuffer(uint16_t id)
+{
+    // The ring is a plain io_uring_buf array whose first `resv` field doubles
+    // as the tail. (io_uring_buf_ring::bufs is not used: in C++ the header's
+    // flexible-array wrapper shifts it away from the kernel's layout.) Only
+    // addr/len/bid are written so the tail is left alone.
+    io_uring_buf& b = bufRing[bufTail & bufMask];
+    b.addr = reinterpret_cast<uint64_t>(buffer(id));
+    b.len = bufSize;
+    b.bid = id;
+    ++bufTail;
+}
+
+void IoUring::publishBuffers()
+{
+    __atomic_store_n(&bufRing[0].resv, bufTail, __ATOMIC_RELEASE);
+}
+
+// --- UringServer ---
+
+bool UringServer::supported(std::string& reason)
+{
+    // SINGLE_ISSUER arrived in the same release as multishot recv (6.0).
+    IoUring probe;
+    if (!probe.init(8, 16, IORING_SETUP_SINGLE_ISSUER)) {
+        reason = errno == EINVAL ? "needs Linux 6.0 or newer" : std::strerror(errno);
+        return false;
+    }
+    static char buffers[2][64];
+    if (!probe.registerBufferRing(kBufferGroup, &buffers[0][0], 2, sizeof(buffers[0]))) {
+        reason = std::string("buffer ring: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+UringServer::UringServer(BankQueueManager& manager, uint16_t port)
+    : manager(manager), port(port) {}
+
+UringServer::~UringServer()
+{
+    for (auto& c : connections)
+        if (c) ::close(c->fd);
+    if (listenFd >= 0) ::close(listenFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+}
+
+bool UringServer::listen()
+{
+    listenFd = openListenSocket(port);
+    if (listenFd < 0) return false;
+    wakeFd = ::eventfd(0, EFD_CLOEXEC);
+
+    // Best first: completions are only processed inside io_uring_enter() on
+    // the reactor thread (6.1+), then cooperative task work (5.19+), then
+    // whatever the kernel offers.
+    const unsigned flagSets[] = {
+        IORING_SETUP_R_DISABLED | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_COOP_TASKRUN,
+        0
+    };
+    bool created = false;
+    for (unsigned flags : flagSets) {
+        if (ring.init(kQueueDepth, kCompletionDepth, flags)) {
+            enableOnRun = flags & IORING_SETUP_R_DISABLED;
+            created = true;
+            break;
+        }
+    }
+    if (!created) {
+        std::cerr << "io_uring_setup() failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    recvBuffers.reset(new char[static_cast<size_t>(kRecvBuffers) * kRecvBufferSize]);
+    if (!ring.registerBufferRing(kBufferGroup, recvBuffers.get(), kRecvBuffers, kRecvBufferSize)) {
+        std::cerr << "Failed to register receive buffers: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    armAccept();
+    armWake();
+    return true;
+}
+
+void UringServer::stop()
+{
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeFd, &one, sizeof(one));
+    (void)n;
+}
+
+void UringServer::run()
+{
+    if (enableOnRun && !ring.enable()) {
+        std::cerr << "Failed to enable the io_uring: " << std::strerror(errno) << "\n";
+        return;
+    }
+    enableOnRun = false;
+
+    while (!stopping) {
+        // Everything queued by the previous iteration goes out with the wait.
+        if (!ring.submitAndWait(1)) {
+            std::cerr << "io_uring_enter() failed: " << std::strerror(errno) << "\n";
+            return;
+        }
+        ring.drainCompletions([this](const io_uring_cqe& cqe) { onCompletion(cqe); });
+        ring.publishBuffers();
+
+        // Connections marked while servicing (a send that found the
+        // submission queue full) wait for the next iteration.
+        servicing.swap(dirtyFds);
+        for (int fd : servicing) {
+            Connection* c = connections[fd].get();
+            if (!c || !c->dirty) continue;
+            c->dirty = false;
+            service(*c);
+        }
+        servicing.clear();
+    }
+}
+
+void UringServer::armAccept()
+{
+    io_uring_sqe* sqe = ring.getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = userData(ACCEPT, listenFd, 0);
+}
+
+void UringServer::armWake()
+{
+    io_uring_sqe* sqe = ring.getSqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeValue);
+    sqe->len = sizeof(wakeValue);
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->user_data = userData(WAKE, wakeFd, 0);
+}
+
+void UringServer::onCompletion(const io_uring_cqe& cqe)
+{
+    const Op op = static_cast<Op>(cqe.user_data & 0xff);
+    const int fd = static_cast<int>((cqe.user_data >> 8) & 0xffffff);
+    const uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+
+    switch (op) {
+        case WAKE:
+            stopping = true;
+            return;
+
+        case ACCEPT:
+            if (cqe.res >= 0) onAccept(cqe.res);
+            else if (cqe.res != -ECANCELED) std::cerr << "accept failed: " << std::strerror(-cqe.res) << "\n";
+            if (!(cqe.flags & IORING_CQE_F_MORE)) armAccept();
+            return;
+
+        case CANCEL:
+            return;
+
+        case RECV:
+        case SEND:
+            break;
+    }
+
+    Connection* c = fd < static_cast<int>(connections.size()) ? connections[fd].get() : nullptr;
+    if (!c || c->generation != generation) {
+        // Late completion for a connection that is gone.
+        if (op == RECV && (cqe.flags & IORING_CQE_F_BUFFER))
+            ring.returnBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+        return;
+    }
+    if (op == RECV) onRecv(*c, cqe);
+    else onSend(*c, cqe.res);
+}
+
+void UringServer::onAccept(int fd)
+{
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (fd >= static_cast<int>(connections.size())) connections.resize(fd + 1);
+    connections[fd] = std::make_unique<Connection>(fd, nextGeneration++, manager);
+    ++connectionsOpen;
+    updateRecv(*connections[fd]);
+}
+
+void UringServer::onRecv(Connection& c, const io_uring_cqe& cqe)
+{
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        const uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe.res > 0) c.session.in.append(ring.buffer(id), static_cast<size_t>(cqe.res));
+        ring.returnBuffer(id);
+    }
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        c.recvActive = false;
+        c.recvCanceling = false;
+    }
+    // -ENOBUFS (buffer ring ran dry) and -ECANCELED only end this recv; it is
+    // re-armed by service() if still wanted. EOF or a real error ends input.
+    if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED))
+        c.peerClosed = true;
+    markDirty(c);
+}
+
+void UringServer::onSend(Connection& c, int result)
+{
+    if (result < 0) {
+        c.sendActive = false;
+        closeConnection(c); // peer gone
+        return;
+    }
+    c.sendingSent += static_cast<size_t>(result);
+    c.sendActive = false;
+    if (c.sendPending() && startSend(c)) return; // short send: the rest of the same buffer
+    markDirty(c);
+}
+
+void UringServer::markDirty(Connection& c)
+{
+    if (c.dirty) return;
+    c.dirty = true;
+    dirtyFds.push_back(c.fd);
+}
+
+void UringServer::service(Connection& c)
+{
+    Session& s = c.session;
+    if (!s.closing && !s.outputBacklogged()) {
+        manager.setOutputSink(&s);
+        s.process();
+        manager.setOutputSink(nullptr); // renders this session's pending results into it
+    }
+    if (!c.sendActive && (c.sendPending() || s.hasOutput())) {
+        // The session keeps appending to `out` while the kernel sends, so the
+        // in-flight bytes move to a buffer of their own. With the submission
+        // queue full they go back to `out` (the rest of a short send stays
+        // in `sending`) and the next iteration tries again.
+        const bool fresh = !c.sendPending();
+        if (fresh) {
+            c.sending.clear();
+            c.sending.swap(s.out);
+            c.sendingSent = 0;
+        }
+        if (!startSend(c)) {
+            if (fresh) s.out.swap(c.sending);
+            markDirty(c);
+        }
+    }
+
+    const bool finished = s.closing || (c.peerClosed && !s.hasCompleteRequest());
+    if (finished && !c.sendActive && !c.sendPending() && !s.hasOutput()) {
+        closeConnection(c);
+        return;
+    }
+    updateRecv(c);
+}
+
+bool UringServer::startSend(Connection& c)
+{
+    io_uring_sqe* sqe = ring.getSqe();
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(c.sending.data() + c.sendingSent);
+    sqe->len = static_cast<uint32_t>(c.sending.size() - c.sendingSent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = userData(SEND, c.fd, c.generation);
+    c.sendActive = true;
+    return true;
+}
+
+void UringServer::updateRecv(Connection& c)
+{
+    if (c.peerClosed || c.session.closing) return; // closing the socket ends the recv
+
+    if (!c.session.outputBacklogged()) {
+        if (c.recvActive) return;
+        io_uring_sqe* sqe = ring.getSqe();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = c.fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = userData(RECV, c.fd, c.generation);
+        c.recvActive = true;
+    } else if (c.recvActive && !c.recvCanceling) {
+        // Stop reading until the client takes its output.
+        io_uring_sqe* sqe = ring.getSqe();
+        if (!sqe) return;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = userData(RECV, c.fd, c.generation);
+        sqe->user_data = userData(CANCEL, c.fd, c.generation);
+        c.recvCanceling = true;
+    }
+}
+
+void UringServer::closeConnection(Connection& c)
+{
+    // Never called with a send in flight, so `sending` can go. The shutdown
+    // ends the multishot recv; its last completion is dropped by generation.
+    const int fd = c.fd;
+    ::shutdown(fd, SHUT_RDWR);
+    ::close(fd);
+    connections[fd].reset();
+    --connectionsOpen;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "Results.h"
+
+// Binary wire protocol for machine clients of the TCP front end.
+//
+// A connection that starts with the byte kWireMagic speaks this protocol for
+// the rest of its life; any other first byte selects the text protocol, so
+// both share one port. After the magic byte the client sends frames, each an
+// 8-byte WireHeader followed by `length` body bytes. Integers are
+// little-endian and fixed width; no field needs parsing beyond a memcpy.
+//
+// Clients are named by handle: INTERN resolves an id string to its handle
+// once, and ADD / CHECK / CANCEL / ESTIMATE carry the 4-byte handle from
+// then on.
+//
+// Requests may be pipelined freely. They run in order, and every response
+// echoes the `tag` of the request that produced it. A request normally gets
+// one response; SERVE can add a second (a HOT record) and failures are
+// answered with an ERROR frame carrying the text message. RESULT bodies are
+// the manager's ActionResult records, so `ticket` is the arrival ticket
+// assigned when the request was queued.
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the wire format is little-endian");
+
+inline constexpr uint8_t kWireMagic = 0xB1; // not a valid first byte of a text command
+
+enum class WireOp : uint8_t {
+    INTERN = 1,   // body: client id bytes           -> HANDLE
+    ADD    = 2,   // body: WireAdd                   -> RESULT (queued / fast lane)
+    CHECK  = 3,   // body: WireClient                -> RESULT (queued / fast lane)
+    CANCEL = 4,   // body: WireClient                -> RESULT (canceled)
+    SERVE  = 5,   // no body                         -> RESULT (served / queue empty)
+    ESTIMATE = 6  // body: WireClient                -> ESTIMATE
+};
+
+enum class WireReply : uint8_t {
+    RESULT = 1,   // body: ActionResult
+    HANDLE = 2,   // body: WireClient
+    ERROR  = 3,   // body: message text
+    ESTIMATE = 4  // body: WireEstimate
+};
+
+struct WireHeader {
+    uint16_t length;   // body bytes after this header
+    uint8_t type;      // WireOp in requests, WireReply in responses
+    uint8_t reserved;
+    uint32_t tag;      // chosen by the client, echoed in the responses
+};
+static_assert(sizeof(WireHeader) == 8, "wire header is 8 bytes");
+
+struct WireClient {
+    uint32_t client;   // handle
+};
+static_assert(sizeof(WireClient) == 4, "wire client is 4 bytes");
+
+struct WireAdd {
+    uint32_t client;   // handle
+    uint32_t target;   // TRANSFER: target handle
+    int32_t amount;
+    uint8_t service;   // Service: DEPOSIT (0), WITHDRAW (1), CHECK (2) or TRANSFER (3)
+    uint8_t reserved[3];
+};
+static_assert(sizeof(WireAdd) == 16, "wire add is 16 bytes");
+
+// Position and expected wait of the client's latest queued request.
+struct WireEstimate {
+    int64_t waitNs;    // -1: no service times measured yet
+    uint32_t ahead;    // requests served before it
+    uint32_t tellers;  // tellers serving
+};
+static_assert(sizeof(WireEstimate) == 16, "wire estimate is 16 bytes");
+
+// Appends one frame to `out`.
+inline void appendWireFrame(std::string& out, uint8_t type, uint32_t tag, const void* body, size_t length)
+{
+    WireHeader h{};
+    h.length = static_cast<uint16_t>(length);
+    h.type = type;
+    h.tag = tag;
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.append(static_cast<const char*>(body), length);
+}
+
+// Reads a fixed-size body; false if the frame has the wrong length.
+template<typename T>
+bool readWireBody(std::string_view body, T& value)
+{
+    if (body.size() != sizeof(T)) return false;
+    std::memcpy(&value, body.data(), sizeof(T));
+    return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "../BankQueueManager.h"
+#include "Zipf.h"
+#include <array>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Synthetic bank workload: a population of accounts and a stream of commands
+// drawn from configurable distributions.
+//
+//  - Accounts are "a0" .. "a<N-1>", with client types drawn by `typeWeights`
+//    and opening balances uniform in [minBalance, maxBalance].
+//  - Each command's kind is drawn by `mix` (an add with one of the four
+//    single-account services, a cancel or a serve). The client of an add or
+//    cancel, and the target of a transfer, are Zipf(`zipf`) over the accounts,
+//    so a few accounts carry most of the traffic. Zipf ranks are scattered
+//    over the ids, so the popular accounts are not neighbours.
+//  - Arrivals are open loop: a Poisson process at `rate` commands/sec that
+//    does not wait for the system under test. A rate of 0 leaves the arrival
+//    times at 0 (closed loop: the driver sends as fast as it gets answers).
+//
+// The stream is a pure function of the config, seed included.
+
+enum class WorkloadOp : uint8_t {
+    DEPOSIT,
+    WITHDRAW,
+    CHECK,
+    TRANSFER,
+    CANCEL,
+    SERVE,
+    COUNT
+};
+
+inline constexpr std::array<const char*, static_cast<size_t>(WorkloadOp::COUNT)> kWorkloadOpNames = {
+    "deposit", "withdraw", "check", "transfer", "cancel", "serve"};
+
+// Indexed by ClientType (VIP, BUSINESS, REGULAR).
+inline constexpr std::array<const char*, 3> kWorkloadTypeNames = {"vip", "business", "regular"};
+
+struct WorkloadConfig {
+    uint32_t accounts = 100000;
+    uint64_t commands = 1000000;
+    double zipf = 0.99;
+    std::array<double, static_cast<size_t>(WorkloadOp::COUNT)> mix = {25, 15, 10, 5, 5, 40};
+    std::array<double, 3> typeWeights = {10, 20, 70};
+    int minBalance = 100;
+    int maxBalance = 100000;
+    int minAmount = 1;
+    int maxAmount = 500;
+    double rate = 0;       // commands/sec, 0 = closed loop
+    uint64_t seed = 1;
+};
+
+struct WorkloadCommand {
+    WorkloadOp op;
+    uint32_t client;       // account index (unused for SERVE)
+    uint32_t target;       // TRANSFER: target account index
+    int32_t amount;        // DEPOSIT / WITHDRAW / TRANSFER
+    double arrival;        // seconds from the start of the run
+};
+
+class WorkloadGenerator
+{
+    public:
+        explicit WorkloadGenerator(const WorkloadConfig& config)
+            : cfg(config),
+              rng(config.seed),
+              popularity(config.accounts, config.zipf),
+              opDist(config.mix.begin(), config.mix.end()),
+              amountDist(config.minAmount, config.maxAmount)
+        {
+            std::mt19937_64 accountRng(config.seed ^ 0x9e3779b97f4a7c15ULL);
+            std::discrete_distribution<int> typeDist(config.typeWeights.begin(), config.typeWeights.end());
+            std::uniform_int_distribution<int> balanceDist(config.minBalance, config.maxBalance);
+            types.resize(config.accounts);
+            balances.resize(config.accounts);
+            for (uint32_t i = 0; i < config.accounts; ++i) {
+                types[i] = static_cast<ClientType>(typeDist(accountRng));
+                balances[i] = balanceDist(accountRng);
+            }
+        }
+
+        const WorkloadConfig& config() const { return cfg; }
+
+        static std::string accountId(uint32_t account) { return "a" + std::to_string(account); }
+        ClientType accountType(uint32_t account) const { return types[account]; }
+        int accountBalance(uint32_t account) const { return balances[account]; }
+
+        WorkloadCommand next()
+        {
+            WorkloadCommand c{};
+            c.op = static_cast<WorkloadOp>(opDist(rng));
+            if (c.op != WorkloadOp::SERVE) c.client = pickAccount();
+            if (c.op == WorkloadOp::DEPOSIT || c.op == WorkloadOp::WITHDRAW || c.op == WorkloadOp::TRANSFER)
+                c.amount = amountDist(rng);
+            if (c.op == WorkloadOp::TRANSFER) {
+                c.target = pickAccount();
+                if (c.target == c.client) c.target = (c.client + 1) % cfg.accounts;
+            }
+            if (cfg.rate > 0) {
+                clock += std::exponential_distribution<double>(cfg.rate)(rng);
+                c.arrival = clock;
+            }
+            return c;
+        }
+
+        // Appends the command as one line of the CLI text protocol.
+        static void appendText(const WorkloadCommand& c, std::string& out)
+        {
+            switch (c.op) {
+                case WorkloadOp::SERVE:
+                    out += "serve\n";
+                    return;
+                case WorkloadOp::CANCEL:
+                    out += "cancel a" + std::to_string(c.client) + "\n";
+                    return;
+                case WorkloadOp::CHECK:
+                    out += "add a" + std::to_string(c.client) + " check\n";
+                    return;
+                default:
+                    break;
+            }
+            out += "add a" + std::to_string(c.client) + " " + kWorkloadOpNames[static_cast<size_t>(c.op)]
+                 + " " + std::to_string(c.amount);
+            if (c.op == WorkloadOp::TRANSFER) out += " a" + std::to_string(c.target);
+            out += "\n";
+        }
+
+    private:
+        static constexpr uint64_t kScatter = 2654435761u; // prime: rank -> account is a bijection
+
+        WorkloadConfig cfg;
+        std::mt19937_64 rng;
+        ZipfGenerator popularity;
+        std::discrete_distribution<int> opDist;
+        std::uniform_int_distribution<int> amountDist;
+        std::vector<ClientType> types;
+        std::vector<int> balances;
+        double clock = 0;
+
+        uint32_t pickAccount()
+        {
+            return static_cast<uint32_t>(popularity(rng) * kScatter % cfg.accounts);
+        }
+};
+
+// Parses "name=weight,name=weight,..." into `weights`; names not mentioned
+// get weight 0. False on an unknown name or a malformed weight.
+template <size_t N>
+bool parseWorkloadWeights(std::string_view spec, const std::array<const char*, N>& names, std::array<double, N>& weights)
+{
+    weights.fill(0);
+    while (!spec.empty()) {
+        const size_t comma = spec.find(',');
+        std::string_view item = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        const size_t eq = item.find('=');
+        if (eq == std::string_view::npos) return false;
+        size_t i = 0;
+        while (i < N && item.substr(0, eq) != names[i]) ++i;
+        if (i == N) return false;
+        try {
+            weights[i] = std::stod(std::string(item.substr(eq + 1)));
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (weights[i] < 0) return false;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Zipf(s) over ranks [0, n): rank 0 is the most popular.
+// Precomputes the CDF once; each draw is a binary search.
+class ZipfGenerator
+{
+    public:
+        ZipfGenerator(uint32_t n, double s)
+        {
+            cdf.resize(n);
+            double sum = 0;
+            for (uint32_t k = 0; k < n; ++k) {
+                sum += 1.0 / std::pow(static_cast<double>(k + 1), s);
+                cdf[k] = sum;
+            }
+            for (double& v : cdf) v /= sum;
+        }
+
+        template <typename Rng>
+        uint32_t operator()(Rng& rng)
+        {
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            auto it = std::lower_bound(cdf.begin(), cdf.end(), u);
+            return static_cast<uint32_t>(std::min<size_t>(it - cdf.begin(), cdf.size() - 1));
+        }
+
+    private:
+        std::vector<double> cdf;
+};
@@ -0,0 +1,113 @@
+// Counts global operator new calls per add/serve, add/cancel and
+// multitransfer/serve cycle.
+//
+// Every allocation in the process goes through the replaced operator new
+// below. After a warm-up that brings the queue node pool, the per-handle
+// tables and the ledger / history buffers to their working size, the
+// measured cycles should not allocate on the queue path at all; what is left
+// is the amortized growth of the ledger and history storage.
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/allocation_benchmark.cpp -o allocation_benchmark
+#include "../BankQueueManager.h"
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+std::atomic<unsigned long long> allocations{0};
+}
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr int kClients = 1000;
+constexpr int kWarmupCycles = 200000;
+constexpr int kCycles = 1000000;
+constexpr int kMultiTransferLegs = 8;
+
+struct Cycle {
+    std::string id;
+    std::string target;
+    Service service;
+};
+
+template <typename Fn>
+void measure(const char* name, Fn&& cycle)
+{
+    for (int i = 0; i < kWarmupCycles; ++i) cycle(i);
+
+    unsigned long long before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCycles; ++i) cycle(i);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned long long count = allocations.load() - before;
+
+    std::cerr << name << ": " << count << " allocations in " << kCycles << " cycles ("
+              << static_cast<double>(count) / kCycles << " per cycle), "
+              << static_cast<long long>(kCycles / seconds) << " cycles/sec\n";
+}
+
+} // namespace
+
+int main()
+{
+    Logger::instance().setLevel(LogLevel::SILENT); // measure the queue, not the console
+
+    BankQueueManager manager;
+    for (ClientType type : {ClientType::REGULAR, ClientType::BUSINESS, ClientType::VIP}) {
+        manager.setCheckFastLane(type, false);
+    }
+
+    const char* types[] = {"REGULAR", "BUSINESS", "VIP"};
+    std::vector<Cycle> script;
+    for (int i = 0; i < kClients; ++i) {
+        manager.addBankClient("client" + std::to_string(i), 1000000, types[i % 3]);
+    }
+    const Service services[] = {Service::DEPOSIT, Service::WITHDRAW, Service::CHECK, Service::TRANSFER};
+    for (int i = 0; i < kClients; ++i) {
+        script.push_back(Cycle{"client" + std::to_string(i), "client" + std::to_string((i + 1) % kClients),
+                               services[i % 4]});
+    }
+
+    // Keep a standing queue so add and serve see a realistic tree depth.
+    for (int i = 0; i < kClients / 2; ++i) {
+        const Cycle& c = script[i];
+        manager.addRequest(c.id, c.service, 10, c.target);
+    }
+
+    measure("add + serve ", [&](int i) {
+        const Cycle& c = script[kClients / 2 + i % (kClients / 2)];
+        manager.addRequest(c.id, c.service, 10, c.target);
+        manager.serveNext();
+    });
+
+    measure("add + cancel", [&](int i) {
+        const Cycle& c = script[kClients / 2 + i % (kClients / 2)];
+        manager.addRequest(c.id, c.service, 10, c.target);
+        manager.cancelClient(c.id);
+    });
+
+    // Multi-transfers come in through the command line, as the CLI sends them.
+    std::vector<std::string> multiTransfers;
+    for (int i = 0; i < kClients; ++i) {
+        std::string line = "add client" + std::to_string(i) + " multitransfer";
+        for (int leg = 1; leg <= kMultiTransferLegs; ++leg) line += " 1 client" + std::to_string((i + leg) % kClients);
+        multiTransfers.push_back(std::move(line));
+    }
+    measure("multitransfer (8 legs) + serve", [&](int i) {
+        manager.runCommand(multiTransfers[i % kClients]);
+        manager.serveNext();
+        manager.flushResults();
+    });
+
+    return 0;
+}
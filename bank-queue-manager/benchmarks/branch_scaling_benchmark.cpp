@@ -0,0 +1,101 @@
+// Throughput of the shared-nothing branch engine (BranchEngine.h) from one
+// branch up to one per core.
+//
+// Each branch owns kClientsPerBranch accounts and is fed add + serve pairs
+// of deposits, withdrawals and transfers; a given fraction of the transfers
+// targets an account of another branch and goes through the reserve / credit
+// / settle exchange. Results are not rendered (output none). Prints commands
+// per second and the speedup over one branch, for each cross-branch fraction:
+//
+//   ./branch_scaling_benchmark [max branches (default: cores)] [commands per branch]
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp BranchEngine.cpp benchmarks/branch_scaling_benchmark.cpp -o branch_scaling_benchmark
+#include "../BranchEngine.h"
+#include <iomanip>
+#include <random>
+
+namespace {
+
+constexpr int kClientsPerBranch = 1000;
+constexpr double kCrossFractions[] = {0.0, 0.01, 0.1};
+
+std::string clientId(size_t branch, int i)
+{
+    return "b" + std::to_string(branch) + "c" + std::to_string(i);
+}
+
+// Add + serve pairs for one branch: 50% deposits, 30% withdrawals, 20% transfers.
+std::vector<std::string> makeCommands(size_t branch, size_t branches, int count, double cross, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> client(0, kClientsPerBranch - 1);
+    std::uniform_int_distribution<size_t> other(0, branches - 1);
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::string> commands;
+    commands.reserve(static_cast<size_t>(count));
+    while (static_cast<int>(commands.size()) + 1 < count) {
+        const int p = pct(rng);
+        std::string line = "add " + clientId(branch, client(rng));
+        if (p < 50) {
+            line += " deposit " + std::to_string(1 + p);
+        } else if (p < 80) {
+            line += " withdraw " + std::to_string(1 + p % 20);
+        } else {
+            size_t to = branch;
+            if (branches > 1 && unit(rng) < cross) {
+                while (to == branch) to = other(rng);
+            }
+            line += " transfer " + std::to_string(1 + p % 10) + " " + clientId(to, client(rng));
+        }
+        commands.push_back(std::move(line));
+        commands.push_back("serve");
+    }
+    return commands;
+}
+
+double run(size_t branches, int perBranch, double cross)
+{
+    BranchEngine engine(branches);
+    for (size_t b = 0; b < branches; ++b) {
+        engine.manager(b).setOutputFormat(OutputFormat::NONE);
+        for (int i = 0; i < kClientsPerBranch; ++i) engine.addClient(b, clientId(b, i), 100000, i % 3 == 0 ? "VIP" : "REGULAR");
+    }
+    std::vector<std::vector<std::string>> commands;
+    for (size_t b = 0; b < branches; ++b) commands.push_back(makeCommands(b, branches, perBranch, cross, 42 + b));
+
+    engine.start();
+    const auto start = std::chrono::steady_clock::now();
+    // Round robin, so every branch is busy from the start.
+    for (size_t i = 0; i < commands[0].size(); ++i)
+        for (size_t b = 0; b < branches; ++b) engine.submit(b, commands[b][i]);
+    engine.drain();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    engine.stop();
+    return static_cast<double>(commands[0].size() * branches) / seconds;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const size_t maxBranches = argc > 1 ? std::stoul(argv[1]) : cores;
+    const int perBranch = argc > 2 ? std::stoi(argv[2]) : 400000;
+    std::cout << "cores: " << cores << ", commands per branch: " << perBranch << "\n";
+
+    for (double cross : kCrossFractions) {
+        std::cout << "\ncross-branch transfers: " << cross * 100 << "%\n";
+        double base = 0;
+        for (size_t branches = 1;; branches = std::min(branches * 2, maxBranches)) { // doubling, ending on maxBranches
+            const double rate = run(branches, perBranch, cross);
+            if (branches == 1) base = rate;
+            std::cout << std::setw(4) << branches << " branches: " << std::fixed << std::setprecision(0)
+                      << std::setw(12) << rate << " commands/sec, speedup " << std::setprecision(2)
+                      << rate / base << "x\n" << std::defaultfloat;
+            if (branches >= maxBranches) break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Latency and throughput of transfers in a bank cluster (cluster/ClusterNode.h).
+//
+// Forks one process per node, all on loopback, opens kAccountsPerNode
+// accounts on each over RPC, then drives transfers with `Execute` calls of
+// `add <a> transfer 1 <b>` + `serve`, which return once the transfer has
+// settled:
+//  - latency: one call at a time, p50 / p99 / mean, for local transfers
+//    (both accounts on the same node) and cross-node ones (two-phase commit)
+//  - throughput: cross-node transfers per second with 1..kMaxClients client
+//    threads calling concurrently, each on its own source accounts
+//
+//   ./cluster_benchmark [nodes (default 3)] [base port (default 50151)]
+//
+// Build (from bank-queue-manager/; see cluster/Makefile):
+//   make -C cluster benchmarks
+#include "../cluster/ClusterNode.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+namespace {
+
+constexpr int kAccountsPerNode = 1000;
+constexpr int kLatencySamples = 2000;
+constexpr int kMaxClients = 16;
+constexpr double kSecondsPerRun = 2.0;
+
+using Stubs = std::vector<std::unique_ptr<bankq::BankNode::Stub>>;
+
+Stubs connect(const std::vector<std::string>& peers)
+{
+    Stubs stubs;
+    for (const std::string& peer : peers) {
+        auto channel = grpc::CreateChannel(peer, grpc::InsecureChannelCredentials());
+        channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(10));
+        stubs.push_back(bankq::BankNode::NewStub(channel));
+    }
+    return stubs;
+}
+
+bool execute(bankq::BankNode::Stub& stub, const std::string& add)
+{
+    bankq::CommandRequest request;
+    request.add_lines(add);
+    request.add_lines("serve");
+    bankq::CommandReply reply;
+    grpc::ClientContext context;
+    return stub.Execute(&context, request, &reply).ok();
+}
+
+// Account ids by owning node; empty if a node refused one.
+std::vector<std::vector<std::string>> openAccounts(Stubs& stubs)
+{
+    const size_t nodes = stubs.size();
+    std::vector<std::vector<std::string>> byNode(nodes);
+    for (size_t i = 0, opened = 0; opened < nodes * kAccountsPerNode; ++i) {
+        const std::string id = "acct" + std::to_string(i);
+        const uint32_t owner = ClusterNode::ownerOf(id, nodes);
+        if (byNode[owner].size() >= kAccountsPerNode) continue;
+        bankq::Account account;
+        account.set_id(id);
+        account.set_balance(1000000);
+        account.set_client_type(i % 3 == 0 ? "VIP" : "REGULAR");
+        bankq::AccountReply reply;
+        grpc::ClientContext context;
+        if (!stubs[owner]->OpenAccount(&context, account, &reply).ok() || !reply.ok()) {
+            std::cerr << "Cannot open " << id << " on node " << owner << ": " << reply.error() << std::endl;
+            return {};
+        }
+        byNode[owner].push_back(id);
+        ++opened;
+    }
+    return byNode;
+}
+
+void latency(Stubs& stubs, const std::vector<std::vector<std::string>>& accounts, bool cross)
+{
+    const size_t nodes = stubs.size();
+    std::vector<double> us;
+    for (int i = 0; i < kLatencySamples; ++i) {
+        const size_t from = i % nodes;
+        const size_t to = cross ? (from + 1) % nodes : from;
+        const std::string& a = accounts[from][i % kAccountsPerNode];
+        const std::string& b = accounts[to][(i + 1) % kAccountsPerNode];
+        const auto start = std::chrono::steady_clock::now();
+        execute(*stubs[from], "add " + a + " transfer 1 " + b);
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double v : us) sum += v;
+    std::cout << (cross ? "cross-node" : "local     ") << " transfer latency: p50 " << std::fixed << std::setprecision(0)
+              << us[us.size() / 2] << " us, p99 " << us[us.size() * 99 / 100] << " us, mean " << sum / us.size()
+              << " us\n" << std::defaultfloat;
+}
+
+double throughput(const std::vector<std::string>& peers, const std::vector<std::vector<std::string>>& accounts, int clients)
+{
+    const size_t nodes = peers.size();
+    std::atomic<bool> go{false}, done{false};
+    std::atomic<int> connected{0};
+    std::atomic<uint64_t> transfers{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            Stubs stubs = connect(peers);
+            ++connected;
+            while (!go.load()) std::this_thread::yield();
+            uint64_t n = 0;
+            // Source accounts c, c + clients, ... on every node: never queued by two clients at once.
+            for (size_t k = 0; !done.load(std::memory_order_relaxed); ++k) {
+                const size_t from = k % nodes;
+                const std::string& a = accounts[from][c + clients * (k % (kAccountsPerNode / clients))];
+                const std::string& b = accounts[(from + 1) % nodes][k % kAccountsPerNode];
+                if (execute(*stubs[from], "add " + a + " transfer 1 " + b)) ++n;
+            }
+            transfers += n;
+        });
+    }
+    while (connected.load() < clients) std::this_thread::yield();
+    go = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(kSecondsPerRun));
+    done = true;
+    for (std::thread& t : threads) t.join();
+    return transfers / kSecondsPerRun;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const size_t nodes = argc > 1 ? std::stoul(argv[1]) : 3;
+    const int basePort = argc > 2 ? std::stoi(argv[2]) : 50151;
+    if (nodes < 2) {
+        std::cerr << "Invalid usage. Use: " << argv[0] << " [nodes (2 or more)] [base port]" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> peers;
+    for (size_t i = 0; i < nodes; ++i) peers.push_back("127.0.0.1:" + std::to_string(basePort + i));
+
+    // Nodes first: gRPC must not be initialized in the parent before fork().
+    std::vector<pid_t> children;
+    for (size_t i = 0; i < nodes; ++i) {
+        const pid_t pid = ::fork();
+        if (pid == 0) {
+            Logger::instance().setLevel(LogLevel::SILENT);
+            ClusterNode node(static_cast<uint32_t>(i), peers);
+            if (!node.start()) ::_exit(1);
+            node.wait();
+            ::_exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    {
+        Stubs stubs = connect(peers);
+        const auto accounts = openAccounts(stubs);
+        if (accounts.empty()) {
+            for (pid_t pid : children) ::kill(pid, SIGTERM);
+            return 1;
+        }
+        std::cout << nodes << " nodes, " << kAccountsPerNode << " accounts each\n";
+        latency(stubs, accounts, false);
+        latency(stubs, accounts, true);
+        for (int clients = 1; clients <= kMaxClients; clients *= 4) {
+            std::cout << std::setw(3) << clients << " clients: " << std::fixed << std::setprecision(0)
+                      << throughput(peers, accounts, clients) << " cross-node transfers/sec\n" << std::defaultfloat;
+        }
+    }
+
+    for (pid_t pid : children) ::kill(pid, SIGTERM);
+    for (pid_t pid : children) ::waitpid(pid, nullptr, 0);
+    return 0;
+}
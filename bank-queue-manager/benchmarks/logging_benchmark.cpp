@@ -0,0 +1,79 @@
+// Serving throughput with console output on and off.
+//
+// Runs the same add + serve cycles four times: with every result line
+// written synchronously through std::cout (what execute() used to do), with
+// results rendered as text into the asynchronous log at `info`, with the log
+// silenced, and with result rendering switched off (OutputFormat::NONE). Redirect stdout
+// to a file or /dev/null so the terminal does not set the pace:
+//
+//   ./logging_benchmark > /dev/null
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/logging_benchmark.cpp -o logging_benchmark
+#include "../BankQueueManager.h"
+
+namespace {
+
+constexpr int kClients = 1000;
+constexpr int kCycles = 500000;
+
+template <typename Fn>
+double measure(const char* name, BankQueueManager& manager, Fn&& cycle)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCycles; ++i) cycle(i);
+    double serving = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    manager.flushResults();
+    logFlush();
+    std::cout.flush();
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << name << ": " << static_cast<long long>(kCycles / serving) << " cycles/sec on the serving thread ("
+              << static_cast<long long>(kCycles / total) << " including the final flush)\n";
+    return kCycles / serving;
+}
+
+} // namespace
+
+int main()
+{
+    BankQueueManager manager;
+    const char* types[] = {"REGULAR", "BUSINESS", "VIP"};
+    std::vector<std::string> ids;
+    for (int i = 0; i < kClients; ++i) {
+        ids.push_back("client" + std::to_string(i));
+        manager.addBankClient(ids.back(), 1000000, types[i % 3]);
+    }
+
+    // Baseline: the same lines, formatted and flushed on the serving thread.
+    Logger::instance().setLevel(LogLevel::SILENT);
+    double sync = measure("std::cout + std::endl ", manager, [&](int i) {
+        const std::string& id = ids[i % kClients];
+        manager.addRequest(id, Service::DEPOSIT, 10, "");
+        std::cout << "Added client '" << id << "' to service queue" << std::endl;
+        manager.serveNext();
+        std::cout << "Deposited 10$ to client '" << id << "' | client new balance: " << 1000000 << "$" << std::endl;
+    });
+
+    Logger::instance().setLevel(LogLevel::INFO);
+    double async = measure("async log, info       ", manager, [&](int i) {
+        manager.addRequest(ids[i % kClients], Service::DEPOSIT, 10, "");
+        manager.serveNext();
+    });
+
+    Logger::instance().setLevel(LogLevel::SILENT);
+    double silent = measure("async log, silent     ", manager, [&](int i) {
+        manager.addRequest(ids[i % kClients], Service::DEPOSIT, 10, "");
+        manager.serveNext();
+    });
+
+    manager.setOutputFormat(OutputFormat::NONE);
+    double none = measure("results not rendered  ", manager, [&](int i) {
+        manager.addRequest(ids[i % kClients], Service::DEPOSIT, 10, "");
+        manager.serveNext();
+    });
+
+    std::cerr << "Serving-thread speedup: async " << async / sync << "x, silent " << silent / sync
+              << "x, no rendering " << none / sync << "x\n";
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Command line parsing throughput: parseCommandLine (string_view tokens,
+// from_chars, perfect-hash keywords) against the previous runCommand front end
+// (istringstream into a vector<string>, if-chain keyword lookup, std::stoi
+// with exceptions). Only parsing is measured; nothing is executed.
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 benchmarks/parser_benchmark.cpp -o parser_benchmark
+#include "../BankQueueManager.h"
+#include <random>
+#include <sstream>
+
+namespace {
+
+constexpr int kLines = 1 << 16;
+constexpr int kRounds = 64;
+
+// The pre-CommandParser front end, kept verbatim for comparison.
+Command legacyParseCommand(const std::string& cmd) {
+    if (cmd == "add")    return Command::ADD;
+    if (cmd == "cancel")    return Command::CANCEL;
+    if (cmd == "serve")  return Command::SERVE;
+    if (cmd == "printq")  return Command::PRINTQ;
+    if (cmd == "printc")  return Command::PRINTC;
+    if (cmd == "ledger")  return Command::LEDGER;
+    if (cmd == "history")  return Command::HISTORY;
+    if (cmd == "fastlane")  return Command::FASTLANE;
+    if (cmd == "exit")   return Command::EXIT;
+    return Command::UNKNOWN;
+}
+
+Service legacyParseService(const std::string& service) {
+    if (service == "deposit")    return Service::DEPOSIT;
+    if (service == "withdraw")    return Service::WITHDRAW;
+    if (service == "check")  return Service::CHECK;
+    if (service == "transfer")  return Service::TRANSFER;
+    if (service == "multitransfer")  return Service::MULTI_TRANSFER;
+    return Service::UNKNOWN;
+}
+
+// Returns a checksum so the work cannot be optimized away.
+long long legacyParse(const std::string& input)
+{
+    std::istringstream iss(input);
+    std::vector<std::string> tokens;
+    std::string word;
+    while (iss >> word) tokens.push_back(word);
+    if (tokens.empty()) return 0;
+
+    Command cmd = legacyParseCommand(tokens[0]);
+    long long sum = static_cast<long long>(cmd);
+    if (cmd == Command::ADD && tokens.size() >= 3 && tokens.size() <= 5) {
+        try {
+            sum += static_cast<long long>(legacyParseService(tokens[2])) + tokens[1].size();
+            if (tokens.size() >= 4) sum += std::stoi(tokens[3]);
+            if (tokens.size() == 5) sum += tokens[4].size();
+        } catch (const std::exception&) {
+            sum -= 1;
+        }
+    } else if (cmd == Command::CANCEL && tokens.size() == 2) {
+        sum += tokens[1].size();
+    }
+    return sum;
+}
+
+long long newParse(std::string_view input)
+{
+    const ParsedCommand p = parseCommandLine(input);
+    long long sum = static_cast<long long>(p.command);
+    if (p.status != ParseStatus::OK) return sum - 1;
+    if (p.command == Command::ADD) {
+        sum += static_cast<long long>(p.service) + p.id.size();
+        if (p.args.size() >= 4) sum += p.amount;
+        sum += p.targetId.size();
+    } else if (p.command == Command::CANCEL) {
+        sum += p.id.size();
+    }
+    return sum;
+}
+
+// Roughly the traffic of a busy branch: mostly adds, then serves and cancels.
+std::vector<std::string> makeLines()
+{
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, 99), id(1000, 99999), amount(1, 5000);
+    std::vector<std::string> lines;
+    lines.reserve(kLines);
+    for (int i = 0; i < kLines; ++i) {
+        int r = pick(rng);
+        if (r < 25)      lines.push_back("add " + std::to_string(id(rng)) + " deposit " + std::to_string(amount(rng)));
+        else if (r < 45) lines.push_back("add " + std::to_string(id(rng)) + " withdraw " + std::to_string(amount(rng)));
+        else if (r < 60) lines.push_back("add " + std::to_string(id(rng)) + " transfer " + std::to_string(amount(rng)) + " " + std::to_string(id(rng)));
+        else if (r < 65) lines.push_back("add " + std::to_string(id(rng)) + " check");
+        else if (r < 90) lines.push_back("serve");
+        else             lines.push_back("cancel " + std::to_string(id(rng)));
+    }
+    return lines;
+}
+
+template <typename Fn>
+double measure(const char* name, const std::vector<std::string>& lines, Fn&& parse)
+{
+    long long checksum = 0;
+    for (const std::string& line : lines) checksum += parse(line); // warm-up
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; ++round)
+        for (const std::string& line : lines) checksum += parse(line);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double perSec = static_cast<double>(kLines) * kRounds / seconds;
+    std::cerr << name << ": " << static_cast<long long>(perSec) << " commands/sec (checksum " << checksum << ")\n";
+    return perSec;
+}
+
+} // namespace
+
+int main()
+{
+    const std::vector<std::string> lines = makeLines();
+
+    long long legacySum = 0, newSum = 0;
+    for (const std::string& line : lines) {
+        legacySum += legacyParse(line);
+        newSum += newParse(line);
+    }
+    if (legacySum != newSum) {
+        std::cerr << "Parsers disagree: " << legacySum << " vs " << newSum << "\n";
+        return 1;
+    }
+
+    double legacy = measure("istringstream + stoi", lines, [](const std::string& l) { return legacyParse(l); });
+    double fast = measure("string_view + from_chars", lines, [](const std::string& l) { return newParse(l); });
+    std::cerr << "Speedup: " << fast / legacy << "x\n";
+}
@@ -0,0 +1,114 @@
+// add / serve / cancel latency and RSS of BankQueueManager with its
+// containers on the global allocator versus an unsynchronized pool resource.
+//
+// Each configuration runs in its own forked process so RSS numbers are not
+// polluted by the other run. The workload keeps a standing queue and churns
+// it with random cancels, which is what fragments a general-purpose heap.
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/pmr_benchmark.cpp -o pmr_benchmark
+#include "../BankQueueManager.h"
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kClients = 200000;
+constexpr int kStanding = 100000;
+constexpr int kOps = 1000000;
+
+long rssKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) return std::stol(line.substr(6));
+    }
+    return -1;
+}
+
+struct Latencies {
+    std::vector<uint32_t> add, serve, cancel;
+};
+
+void report(const char* op, std::vector<uint32_t>& ns)
+{
+    std::sort(ns.begin(), ns.end());
+    double sum = 0;
+    for (uint32_t v : ns) sum += v;
+    std::cerr << "  " << op << " | mean: " << static_cast<long>(sum / ns.size())
+              << " ns | p50: " << ns[ns.size() / 2] << " ns | p99: " << ns[ns.size() * 99 / 100]
+              << " ns | p99.9: " << ns[ns.size() * 999 / 1000] << " ns\n";
+}
+
+template <typename Fn>
+uint32_t timed(Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void run(const char* name, std::pmr::memory_resource* resource)
+{
+    long rssStart = rssKb();
+    BankQueueManager manager(resource);
+    for (ClientType type : {ClientType::REGULAR, ClientType::BUSINESS, ClientType::VIP}) {
+        manager.setCheckFastLane(type, false);
+    }
+
+    const char* types[] = {"REGULAR", "BUSINESS", "VIP"};
+    std::vector<std::string> ids;
+    for (int i = 0; i < kClients; ++i) {
+        ids.push_back("c" + std::to_string(i));
+        manager.addBankClient(ids.back(), 1000000, types[i % 3]);
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, kClients - 1);
+    for (int i = 0; i < kStanding; ++i) manager.addRequest(ids[pick(rng)], Service::CHECK, 0, "");
+
+    Latencies lat;
+    lat.add.reserve(kOps);
+    lat.serve.reserve(kOps / 2);
+    lat.cancel.reserve(kOps / 2);
+    std::vector<int> recent(1024, 0); // cancel clients that were added a while ago
+    for (int i = 0; i < kOps; ++i) {
+        int client = pick(rng);
+        lat.add.push_back(timed([&] { manager.addRequest(ids[client], Service::DEPOSIT, 10, ""); }));
+        int old = recent[i % recent.size()];
+        recent[i % recent.size()] = client;
+        if (i % 2 == 0) lat.serve.push_back(timed([&] { manager.serveNext(); }));
+        else lat.cancel.push_back(timed([&] { manager.cancelClient(ids[old]); }));
+    }
+
+    std::cerr << name << " (queue size at end: " << manager.queueSize() << ")\n";
+    report("add   ", lat.add);
+    report("serve ", lat.serve);
+    report("cancel", lat.cancel);
+    std::cerr << "  RSS growth: " << (rssKb() - rssStart) / 1024 << " MB\n";
+}
+
+} // namespace
+
+int main()
+{
+    Logger::instance().setLevel(LogLevel::SILENT); // measure the queue, not the console
+
+    struct Config {
+        const char* name;
+        bool pooled;
+    };
+    for (Config config : {Config{"global allocator (new_delete_resource)", false},
+                          Config{"unsynchronized_pool_resource", true}}) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            run(config.name, config.pooled ? nullptr : std::pmr::new_delete_resource());
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    return 0;
+}
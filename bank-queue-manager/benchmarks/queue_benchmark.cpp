@@ -0,0 +1,347 @@
+// Queue operation microbenchmarks across scheduler backends (Scheduler.h).
+//
+// For every backend, client-type mix and queue size from 10^3 to 10^7 the
+// queue is filled once, then each operation is timed on it while its size
+// stays put:
+//   add     - push (BankQueueManager::AddRequestToQueue), undone by cancels
+//   serve   - pop the next request (serveNext), refilled afterwards
+//   cancel  - remove a random client's request (cancelClient), re-queued
+//   position - requests ahead of a random queued client (position / estimate)
+//   iterate - walk the whole queue in serve order (printQueue), per request
+// Operations run in batches of kBatch between two clock reads, and batches
+// repeat until --min-time has been spent in them; the undo work between
+// batches is not timed.
+//
+// The console table follows Google Benchmark; --json writes its JSON report
+// format ("-" for stdout), so runs can be kept and compared between
+// releases with the usual tooling.
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/queue_benchmark.cpp -o queue_benchmark
+#include "../BankQueueManager.h"
+#include <sys/utsname.h>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <random>
+
+namespace {
+
+constexpr size_t kBatch = 256; // a quarter of the smallest queue
+
+volatile long long iterationSink; // keeps the iteration from being optimized out
+
+struct Mix {
+    const char* name;
+    std::array<double, 3> weights; // VIP, BUSINESS, REGULAR
+};
+constexpr Mix kMixes[] = {
+    {"uniform", {1, 1, 1}},
+    {"skewed", {5, 15, 80}},
+};
+
+struct Options {
+    size_t maxSize = 10000000;
+    double minTime = 0.25;
+    std::string filter;
+    const char* jsonPath = nullptr;
+};
+
+struct Result {
+    std::string name;
+    const char* operation;
+    const char* backend;
+    const char* mix;
+    size_t queueSize;
+    uint64_t iterations = 0;   // operations timed
+    double realNs = 0;         // per operation
+    double cpuNs = 0;
+};
+
+// Accumulates wall and CPU time over the timed sections only.
+class Stopwatch
+{
+    public:
+        void start()
+        {
+            wallStart = std::chrono::steady_clock::now();
+            cpuStart = cpuNow();
+        }
+        void stop()
+        {
+            wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+            cpu += cpuNow() - cpuStart;
+        }
+        double wallSeconds() const { return wall; }
+        double cpuSeconds() const { return cpu; }
+
+    private:
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart = 0;
+        double wall = 0;
+        double cpu = 0;
+
+        static double cpuNow()
+        {
+            timespec ts{};
+            ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+};
+
+// One filled queue: `size` requests from distinct clients, plus kBatch
+// clients with nothing queued for the add benchmark.
+class Fixture
+{
+    public:
+        Fixture(SchedulerBackend backend, const Mix& mix, size_t size)
+            : queue(backend, &pool), size(size)
+        {
+            std::mt19937_64 rng(42); // same clients for every backend
+            std::discrete_distribution<int> typeDist(mix.weights.begin(), mix.weights.end());
+            types.resize(size + kBatch);
+            chosen.resize(types.size());
+            for (ClientType& t : types) t = static_cast<ClientType>(typeDist(rng));
+            for (size_t h = 0; h < types.size(); ++h) queue.addClient();
+            for (uint32_t h = 0; h < size; ++h) queue.push(request(h));
+            for (uint32_t h = static_cast<uint32_t>(size); h < types.size(); ++h) idle.push_back(h);
+        }
+
+        // Each operation times one batch and adds the operations it timed
+        // to `ops`.
+        void add(Stopwatch& watch, uint64_t& ops)
+        {
+            watch.start();
+            for (uint32_t h : idle) queue.push(request(h));
+            watch.stop();
+            for (uint32_t h : idle) queue.remove(h);
+            ops += idle.size();
+        }
+
+        void serve(Stopwatch& watch, uint64_t& ops)
+        {
+            std::array<uint32_t, kBatch> served;
+            watch.start();
+            for (uint32_t& h : served) h = queue.popFront().client;
+            watch.stop();
+            for (uint32_t h : served) queue.push(request(h));
+            ops += served.size();
+        }
+
+        void cancel(Stopwatch& watch, uint64_t& ops)
+        {
+            std::array<uint32_t, kBatch> picked;
+            std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(types.size() - 1));
+            for (uint32_t& h : picked) {
+                do h = pick(rng);
+                while (!queue.queued(h) || chosen[h]);
+                chosen[h] = true;
+            }
+            watch.start();
+            for (uint32_t h : picked) queue.remove(h);
+            watch.stop();
+            for (uint32_t h : picked) {
+                queue.push(request(h));
+                chosen[h] = false;
+            }
+            ops += picked.size();
+        }
+
+        void position(Stopwatch& watch, uint64_t& ops)
+        {
+            std::array<uint32_t, kBatch> picked;
+            std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(types.size() - 1));
+            for (uint32_t& h : picked) {
+                do h = pick(rng);
+                while (!queue.queued(h));
+            }
+            long long sum = 0;
+            watch.start();
+            for (uint32_t h : picked) sum += static_cast<long long>(queue.position(h));
+            watch.stop();
+            iterationSink = sum;
+            ops += picked.size();
+        }
+
+        void iterate(Stopwatch& watch, uint64_t& ops)
+        {
+            long long sum = 0;
+            watch.start();
+            queue.forEach([&](const ServiceRequest& r) { sum += r.ticket; });
+            watch.stop();
+            iterationSink = sum;
+            ops += queue.size();
+        }
+
+    private:
+        std::pmr::unsynchronized_pool_resource pool; // as in the manager
+        RequestScheduler queue;
+        size_t size;
+        std::vector<ClientType> types;
+        std::vector<uint32_t> idle;
+        std::vector<bool> chosen; // cancel: picked for the current batch
+        std::mt19937 rng{7};
+        int nextTicket = 1;
+
+        ServiceRequest request(uint32_t client)
+        {
+            ServiceRequest r{};
+            r.ticket = nextTicket++;
+            r.client = client;
+            r.kind = Service::DEPOSIT;
+            r.amount = 1;
+            r.clientType = types[client];
+            return r;
+        }
+};
+
+using Operation = void (Fixture::*)(Stopwatch&, uint64_t&);
+
+struct NamedOperation {
+    const char* name;
+    Operation run;
+};
+constexpr NamedOperation kOperations[] = {
+    {"add", &Fixture::add},
+    {"serve", &Fixture::serve},
+    {"cancel", &Fixture::cancel},
+    {"position", &Fixture::position},
+    {"iterate", &Fixture::iterate},
+};
+
+void printRow(std::ostream& out, const Result& r)
+{
+    out << std::left << std::setw(36) << r.name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(11) << r.realNs << " ns" << std::setw(11) << r.cpuNs << " ns"
+        << std::setw(13) << r.iterations << "\n";
+}
+
+std::string isoNow()
+{
+    const std::time_t t = std::time(nullptr);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&t));
+    return buf;
+}
+
+json report(const std::vector<Result>& results, const char* executable)
+{
+    utsname host{};
+    ::uname(&host);
+    json j;
+    j["context"] = {
+        {"date", isoNow()},
+        {"host_name", host.nodename},
+        {"executable", executable},
+        {"num_cpus", std::thread::hardware_concurrency()},
+        {"library_build_type", "release"},
+    };
+    j["benchmarks"] = json::array();
+    for (const Result& r : results) {
+        j["benchmarks"].push_back({
+            {"name", r.name},
+            {"run_name", r.name},
+            {"run_type", "iteration"},
+            {"iterations", r.iterations},
+            {"real_time", r.realNs},
+            {"cpu_time", r.cpuNs},
+            {"time_unit", "ns"},
+            {"items_per_second", r.realNs > 0 ? 1e9 / r.realNs : 0},
+            {"operation", r.operation},
+            {"backend", r.backend},
+            {"mix", r.mix},
+            {"queue_size", r.queueSize},
+        });
+    }
+    return j;
+}
+
+bool parseOptions(int argc, char* argv[], Options& o)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (arg == "--max-size") {
+            if (!parseNumber(std::string_view(value), o.maxSize) || o.maxSize < 1000) return false;
+        } else if (arg == "--min-time") {
+            char* end = nullptr;
+            o.minTime = std::strtod(value, &end);
+            if (*end != '\0' || o.minTime <= 0) return false;
+        } else if (arg == "--filter") {
+            o.filter = value;
+        } else if (arg == "--json") {
+            o.jsonPath = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Invalid usage. Use: " << argv[0]
+                  << " [--max-size N] [--min-time seconds] [--filter substring] [--json file|-]" << std::endl;
+        return 1;
+    }
+    // With the JSON on stdout the table moves to stderr.
+    std::ostream& table = options.jsonPath && std::string_view(options.jsonPath) == "-" ? std::cerr : std::cout;
+
+    table << std::left << std::setw(36) << "Benchmark" << std::right << std::setw(14) << "Time"
+          << std::setw(14) << "CPU" << std::setw(13) << "Iterations" << "\n"
+          << std::string(77, '-') << "\n";
+
+    std::vector<Result> results;
+    for (SchedulerBackend backend : {SchedulerBackend::ORDERED_SET, SchedulerBackend::CLASS_FIFO}) {
+        for (const Mix& mix : kMixes) {
+            for (size_t size = 1000; size <= options.maxSize; size *= 10) {
+                std::vector<const NamedOperation*> selected;
+                for (const NamedOperation& op : kOperations) {
+                    const std::string name = std::string(op.name) + "/" + scheduler_backend_to_string(backend) + "/"
+                                           + mix.name + "/" + std::to_string(size);
+                    if (name.find(options.filter) != std::string::npos) selected.push_back(&op);
+                }
+                if (selected.empty()) continue;
+
+                Fixture fixture(backend, mix, size);
+                for (const NamedOperation* op : selected) {
+                    Result r{};
+                    r.operation = op->name;
+                    r.backend = scheduler_backend_to_string(backend);
+                    r.mix = mix.name;
+                    r.queueSize = size;
+                    r.name = std::string(op->name) + "/" + r.backend + "/" + mix.name + "/" + std::to_string(size);
+                    Stopwatch watch;
+                    (fixture.*op->run)(watch, r.iterations); // warm-up
+                    watch = Stopwatch();
+                    r.iterations = 0;
+                    while (watch.wallSeconds() < options.minTime) (fixture.*op->run)(watch, r.iterations);
+                    r.realNs = watch.wallSeconds() * 1e9 / r.iterations;
+                    r.cpuNs = watch.cpuSeconds() * 1e9 / r.iterations;
+                    printRow(table, r);
+                    results.push_back(std::move(r));
+                }
+            }
+        }
+    }
+
+    if (options.jsonPath) {
+        const std::string text = report(results, argv[0]).dump(2) + "\n";
+        if (std::string_view(options.jsonPath) == "-") {
+            std::cout << text;
+        } else {
+            std::ofstream out(options.jsonPath);
+            out << text;
+            if (!out) {
+                std::cerr << "Failed to write '" << options.jsonPath << "'.\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Cost of replicating the command log with Raft (cluster/RaftReplica.h).
+//
+// Starts a group of replicas on loopback (this binary, re-executed with
+// --replica), waits for a leader, then sends it `Execute` calls of
+// `add <id> deposit 1` + `serve`, each answered once committed and applied:
+//  - latency: one call at a time, p50 / p99 / mean
+//  - throughput: commands per second with 1..kMaxClients concurrent clients
+//    (concurrent commands share AppendEntries batches and fdatasyncs)
+// for 1 replica (the log alone) and 3 replicas, with and without fdatasync.
+// The difference between the 1- and 3-replica rows is the replication cost.
+//
+//   ./raft_benchmark [base port (default 50251)]
+//
+// Build (from bank-queue-manager/; see cluster/Makefile):
+//   make -C cluster benchmarks
+#include "../cluster/RaftReplica.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+
+namespace {
+
+constexpr int kAccounts = 1000;
+constexpr int kLatencySamples = 2000;
+constexpr int kMaxClients = 16;
+constexpr double kSecondsPerRun = 2.0;
+
+using Stub = std::unique_ptr<bankq::Replica::Stub>;
+
+Stub connect(const std::string& address)
+{
+    auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
+    channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(10));
+    return bankq::Replica::NewStub(channel);
+}
+
+bool execute(bankq::Replica::Stub& stub, const std::string& add, bankq::ReplicaReply& reply)
+{
+    bankq::ReplicaCommand command;
+    command.add_lines(add);
+    command.add_lines("serve");
+    grpc::ClientContext context;
+    return stub.Execute(&context, command, &reply).ok() && reply.ok();
+}
+
+// Address of the elected leader, or empty after 10 seconds without one.
+std::string findLeader(const std::vector<std::string>& peers)
+{
+    std::vector<Stub> stubs;
+    for (const std::string& peer : peers) stubs.push_back(connect(peer));
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        for (size_t i = 0; i < peers.size(); ++i) {
+            bankq::ReplicaReply reply;
+            if (execute(*stubs[i], "add acct0 deposit 1", reply)) return peers[i];
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return {};
+}
+
+void latency(bankq::Replica::Stub& leader)
+{
+    std::vector<double> us;
+    for (int i = 0; i < kLatencySamples; ++i) {
+        bankq::ReplicaReply reply;
+        const auto start = std::chrono::steady_clock::now();
+        execute(leader, "add acct" + std::to_string(i % kAccounts) + " deposit 1", reply);
+        us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double v : us) sum += v;
+    std::cout << "  commit latency: p50 " << std::fixed << std::setprecision(0) << us[us.size() / 2] << " us, p99 "
+              << us[us.size() * 99 / 100] << " us, mean " << sum / us.size() << " us\n" << std::defaultfloat;
+}
+
+double throughput(const std::string& leader, int clients)
+{
+    std::atomic<bool> go{false}, done{false};
+    std::atomic<int> connected{0};
+    std::atomic<uint64_t> commands{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            Stub stub = connect(leader);
+            ++connected;
+            while (!go.load()) std::this_thread::yield();
+            uint64_t n = 0;
+            for (int k = c; !done.load(std::memory_order_relaxed); k += clients) {
+                bankq::ReplicaReply reply;
+                if (execute(*stub, "add acct" + std::to_string(k % kAccounts) + " deposit 1", reply)) ++n;
+            }
+            commands += n;
+        });
+    }
+    while (connected.load() < clients) std::this_thread::yield();
+    go = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(kSecondsPerRun));
+    done = true;
+    for (std::thread& t : threads) t.join();
+    return commands / kSecondsPerRun;
+}
+
+// Runs one group of replicas (fresh data directories) and measures its leader.
+bool measure(const char* self, size_t replicas, bool sync, int basePort, const std::string& clientsPath)
+{
+    std::vector<std::string> peers;
+    for (size_t i = 0; i < replicas; ++i) peers.push_back("127.0.0.1:" + std::to_string(basePort + i));
+    std::string list;
+    for (const std::string& peer : peers) list += (list.empty() ? "" : ",") + peer;
+
+    // Re-executed rather than forked: this process already runs gRPC.
+    std::vector<pid_t> children;
+    for (size_t i = 0; i < replicas; ++i) {
+        const std::string dir = "/tmp/raft_benchmark." + std::to_string(::getpid()) + "." + std::to_string(basePort + i);
+        std::filesystem::remove_all(dir);
+        const pid_t pid = ::fork();
+        if (pid == 0) {
+            const std::string index = std::to_string(i);
+            ::execl(self, self, "--replica", index.c_str(), list.c_str(), dir.c_str(), clientsPath.c_str(),
+                    sync ? "--sync" : "--no-sync", static_cast<char*>(nullptr));
+            ::_exit(127);
+        }
+        children.push_back(pid);
+    }
+
+    const std::string leader = findLeader(peers);
+    std::cout << replicas << (replicas == 1 ? " replica, " : " replicas, ") << (sync ? "fdatasync" : "no fdatasync") << "\n";
+    if (!leader.empty()) {
+        Stub stub = connect(leader);
+        latency(*stub);
+        for (int clients = 1; clients <= kMaxClients; clients *= 4) {
+            std::cout << "  " << std::setw(2) << clients << " clients: " << std::fixed << std::setprecision(0)
+                      << throughput(leader, clients) << " commands/sec\n" << std::defaultfloat;
+        }
+    } else {
+        std::cout << "  no leader elected\n";
+    }
+
+    for (pid_t pid : children) ::kill(pid, SIGTERM);
+    for (pid_t pid : children) ::waitpid(pid, nullptr, 0);
+    for (size_t i = 0; i < replicas; ++i)
+        std::filesystem::remove_all("/tmp/raft_benchmark." + std::to_string(::getpid()) + "." + std::to_string(basePort + i));
+    return !leader.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc == 7 && std::string_view(argv[1]) == "--replica") {
+        Logger::instance().setLevel(LogLevel::SILENT);
+        RaftReplica replica(static_cast<uint32_t>(std::stoul(argv[2])), [&] {
+            std::vector<std::string> peers;
+            std::string_view list = argv[3];
+            while (!list.empty()) {
+                const size_t comma = list.find(',');
+                peers.emplace_back(list.substr(0, comma));
+                list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+            }
+            return peers;
+        }(), argv[4], std::string_view(argv[6]) == "--sync");
+        if (!replica.start(argv[5])) return 1;
+        replica.wait();
+        return 0;
+    }
+    const int basePort = argc > 1 ? std::stoi(argv[1]) : 50251;
+
+    const std::string clientsPath = "/tmp/raft_benchmark." + std::to_string(::getpid()) + ".clients.json";
+    {
+        json clients = {{"clients", json::array()}};
+        for (int i = 0; i < kAccounts; ++i)
+            clients["clients"].push_back({{"id", "acct" + std::to_string(i)}, {"balance", 1000}, {"clientType", "REGULAR"}});
+        std::ofstream(clientsPath) << clients.dump();
+    }
+
+    bool ok = true;
+    int port = basePort;
+    for (bool sync : {false, true}) {
+        for (size_t replicas : {1, 3}) {
+            ok = measure("/proc/self/exe", replicas, sync, port, clientsPath) && ok;
+            port += static_cast<int>(replicas);
+        }
+    }
+    std::remove(clientsPath.c_str());
+    return ok ? 0 : 1;
+}
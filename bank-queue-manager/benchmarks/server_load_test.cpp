@@ -0,0 +1,263 @@
+// Load test for the TCP front end: connections x pipeline depth -> commands/sec.
+//
+// Every connection sends `depth` commands at once (alternating
+// `add <id> deposit 1` and `serve`), waits for the `depth` responses and
+// repeats until the run ends. Each configuration runs over the text protocol
+// and over the binary protocol (WireProtocol.h, ids interned at connect).
+// All connections are driven from one epoll thread. Without arguments the
+// server runs in-process on its own reactor thread, once per I/O backend
+// (epoll, io_uring, and coroutines when built with -std=c++20); with
+// `host port` an already running `bankq --serve <port>` is loaded instead
+// (its clients.json must contain the ids used, so prefer the in-process mode
+// for numbers).
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++20 -pthread BankQueueManager.cpp BankServer.cpp UringServer.cpp CoroServer.cpp benchmarks/server_load_test.cpp -o server_load_test
+// (-std=c++17 also works and leaves out the coroutine backend)
+#include "../BankServer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <iomanip>
+
+namespace {
+
+constexpr int kClients = 10000;
+constexpr double kSecondsPerRun = 1.0;
+
+struct LoadConnection {
+    int fd = -1;
+    std::string batch;       // `depth` commands, sent as one write
+    size_t sent = 0;         // bytes of `batch` sent in this round
+    int pending = 0;         // responses still expected in this round
+    std::string partial;     // binary: start of a frame not fully received
+    std::chrono::steady_clock::time_point roundStart;
+};
+
+// Blocking request/response used while setting up a binary connection.
+bool internIds(int fd, const std::vector<std::string>& ids, std::vector<uint32_t>& handles)
+{
+    std::string request(1, static_cast<char>(kWireMagic));
+    for (size_t i = 0; i < ids.size(); ++i)
+        appendWireFrame(request, static_cast<uint8_t>(WireOp::INTERN), static_cast<uint32_t>(i), ids[i].data(), ids[i].size());
+    if (::send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) return false;
+
+    const size_t frame = sizeof(WireHeader) + sizeof(WireClient);
+    std::string reply;
+    char buf[4096];
+    while (reply.size() < ids.size() * frame) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        reply.append(buf, static_cast<size_t>(n));
+    }
+    handles.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        WireHeader h;
+        std::memcpy(&h, reply.data() + i * frame, sizeof(h));
+        if (h.type != static_cast<uint8_t>(WireReply::HANDLE) || h.length != sizeof(WireClient)) return false;
+        std::memcpy(&handles[h.tag], reply.data() + i * frame + sizeof(h), sizeof(WireClient));
+    }
+    return true;
+}
+
+// Counts the complete binary responses in `data` (plus the saved partial
+// frame) that answer a request; HOT notices are extra and not counted.
+int countFrames(LoadConnection& c, const char* data, size_t size)
+{
+    c.partial.append(data, size);
+    int frames = 0;
+    size_t pos = 0;
+    while (c.partial.size() - pos >= sizeof(WireHeader)) {
+        WireHeader h;
+        std::memcpy(&h, c.partial.data() + pos, sizeof(h));
+        if (c.partial.size() - pos - sizeof(h) < h.length) break;
+        bool answer = true;
+        if (h.type == static_cast<uint8_t>(WireReply::RESULT) && h.length == sizeof(ActionResult)) {
+            ActionResult r;
+            std::memcpy(&r, c.partial.data() + pos + sizeof(h), sizeof(r));
+            answer = r.event != ResultEvent::HOT;
+        }
+        frames += answer;
+        pos += sizeof(h) + h.length;
+    }
+    c.partial.erase(0, pos);
+    return frames;
+}
+
+int connectTo(const char* host, uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ::inet_pton(AF_INET, host, &addr.sin_addr);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+struct RunResult {
+    double commandsPerSec;
+    double meanRoundUs;
+    double p99RoundUs;
+};
+
+RunResult runLoad(const char* host, uint16_t port, int connections, int depth, bool binary)
+{
+    std::vector<LoadConnection> conns(connections);
+    int ep = ::epoll_create1(0);
+    for (int i = 0; i < connections; ++i) {
+        LoadConnection& c = conns[i];
+        c.fd = connectTo(host, port);
+        if (c.fd < 0) {
+            std::cerr << "connect failed after " << i << " connections: " << std::strerror(errno) << "\n";
+            std::exit(1);
+        }
+        std::vector<std::string> ids;
+        for (int k = 0; k < depth; k += 2) ids.push_back("c" + std::to_string((i * depth + k) % kClients));
+        std::vector<uint32_t> handles;
+        if (binary && !internIds(c.fd, ids, handles)) {
+            std::cerr << "binary handshake failed\n";
+            std::exit(1);
+        }
+        for (int k = 0; k < depth; ++k) {
+            if (!binary) {
+                if (k % 2 == 0) c.batch += "add " + ids[k / 2] + " deposit 1\n";
+                else c.batch += "serve\n";
+            } else if (k % 2 == 0) {
+                WireAdd add{};
+                add.client = handles[k / 2];
+                add.amount = 1;
+                add.service = static_cast<uint8_t>(Service::DEPOSIT);
+                appendWireFrame(c.batch, static_cast<uint8_t>(WireOp::ADD), static_cast<uint32_t>(k), &add, sizeof(add));
+            } else {
+                appendWireFrame(c.batch, static_cast<uint8_t>(WireOp::SERVE), static_cast<uint32_t>(k), nullptr, 0);
+            }
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(i);
+        ::epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    std::vector<double> roundsUs;
+    roundsUs.reserve(1 << 20);
+    unsigned long long commands = 0;
+    auto send = [&](LoadConnection& c) {
+        while (c.sent < c.batch.size()) {
+            ssize_t n = ::send(c.fd, c.batch.data() + c.sent, c.batch.size() - c.sent, MSG_NOSIGNAL);
+            if (n <= 0) return; // socket buffers are far larger than a batch
+            c.sent += static_cast<size_t>(n);
+        }
+    };
+    auto startRound = [&](LoadConnection& c) {
+        c.sent = 0;
+        c.pending = depth;
+        c.roundStart = std::chrono::steady_clock::now();
+        send(c);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration<double>(kSecondsPerRun);
+    for (LoadConnection& c : conns) startRound(c);
+
+    int active = connections;
+    std::vector<epoll_event> events(1024);
+    char buf[64 * 1024];
+    while (active > 0) {
+        int n = ::epoll_wait(ep, events.data(), static_cast<int>(events.size()), 1000);
+        if (n <= 0) break;
+        const auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; ++i) {
+            LoadConnection& c = conns[events[i].data.u32];
+            ssize_t r = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (r <= 0) continue;
+            if (binary) {
+                c.pending -= countFrames(c, buf, static_cast<size_t>(r));
+            } else {
+                for (ssize_t k = 0; k < r; ++k)
+                    if (buf[k] == '\n') --c.pending;
+            }
+            if (c.pending > 0) continue;
+
+            commands += depth;
+            roundsUs.push_back(std::chrono::duration<double, std::micro>(now - c.roundStart).count());
+            if (now < deadline) {
+                startRound(c);
+            } else {
+                ::epoll_ctl(ep, EPOLL_CTL_DEL, c.fd, nullptr);
+                --active;
+            }
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (LoadConnection& c : conns) ::close(c.fd);
+    ::close(ep);
+
+    std::sort(roundsUs.begin(), roundsUs.end());
+    double sum = 0;
+    for (double us : roundsUs) sum += us;
+    RunResult result{};
+    result.commandsPerSec = commands / seconds;
+    result.meanRoundUs = roundsUs.empty() ? 0 : sum / roundsUs.size();
+    result.p99RoundUs = roundsUs.empty() ? 0 : roundsUs[roundsUs.size() * 99 / 100];
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    rlimit lim{};
+    ::getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &lim);
+
+    const int connectionCounts[] = {1, 16, 256, 1024, 4096};
+    const int depths[] = {1, 32};
+    auto runAll = [&](const char* host, uint16_t port, const char* backend) {
+        for (int depth : depths) {
+            for (int connections : connectionCounts) {
+                if (2 * connections + 64 > static_cast<int>(lim.rlim_cur)) continue;
+                for (bool binary : {false, true}) {
+                    RunResult r = runLoad(host, port, connections, depth, binary);
+                    std::cout << std::setw(8) << backend << std::setw(9) << (binary ? "binary" : "text")
+                              << std::setw(13) << connections << std::setw(7) << depth
+                              << std::setw(14) << static_cast<long long>(r.commandsPerSec)
+                              << std::setw(17) << static_cast<long long>(r.meanRoundUs)
+                              << std::setw(16) << static_cast<long long>(r.p99RoundUs) << "\n";
+                }
+            }
+        }
+    };
+
+    std::cout << " backend  protocol  connections  depth  commands/sec  mean round (us)  p99 round (us)\n";
+    if (argc == 3) {
+        runAll(argv[1], static_cast<uint16_t>(std::stoi(argv[2])), "remote");
+        return 0;
+    }
+
+    Logger::instance().setLevel(LogLevel::SILENT); // responses still go to the sockets
+    BankQueueManager manager;
+    const char* types[] = {"REGULAR", "BUSINESS", "VIP"};
+    for (int i = 0; i < kClients; ++i) manager.addBankClient("c" + std::to_string(i), 1000000, types[i % 3]);
+
+    for (IoBackend backend : {IoBackend::EPOLL, IoBackend::URING, IoBackend::CORO}) {
+        std::unique_ptr<NetworkServer> server = createServer(backend, manager, 0);
+        if (server->backend() != backend || !server->listen()) continue;
+        std::thread reactor([&] { server->run(); }); // the only thread touching the manager
+        runAll("127.0.0.1", server->getPort(), io_backend_to_string(backend));
+        server->stop();
+        reactor.join();
+    }
+    return 0;
+}
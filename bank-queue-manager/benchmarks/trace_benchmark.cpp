@@ -0,0 +1,57 @@
+// Cost of the trace points (Trace.h).
+//
+// Times an empty BANKQ_TRACE_SCOPE in a loop (the cost of one event), then
+// add + serve cycles through the manager with result output off, which pass
+// through every trace point of the command pipeline. Build it twice, with
+// and without -DBANKQ_TRACE, and compare the cycle times:
+//
+//   ./trace_benchmark
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread -DBANKQ_TRACE BankQueueManager.cpp benchmarks/trace_benchmark.cpp -o trace_benchmark
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/trace_benchmark.cpp -o trace_benchmark_off
+#include "../BankQueueManager.h"
+
+namespace {
+
+constexpr int kEvents = 10000000;
+constexpr int kClients = 1000;
+constexpr int kCycles = 1000000;
+
+volatile int scopeSink;
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    std::cout << "Tracing " << (kTraceCompiled ? "compiled in" : "compiled out") << "\n";
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kEvents; ++i) {
+        BANKQ_TRACE_SCOPE("bench");
+        scopeSink = i;
+    }
+    std::cout << "empty scope:       " << secondsSince(start) * 1e9 / kEvents << " ns/event\n";
+
+    BankQueueManager manager;
+    manager.setOutputFormat(OutputFormat::NONE);
+    std::vector<std::string> adds;
+    for (int i = 0; i < kClients; ++i) {
+        const std::string id = "c" + std::to_string(i);
+        manager.addBankClient(id, 1000000, i % 3 == 0 ? "VIP" : "REGULAR");
+        adds.push_back("add " + id + " deposit 1");
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kCycles; ++i) {
+        manager.runCommand(adds[i % kClients]);
+        manager.runCommand("serve");
+    }
+    std::cout << "add + serve cycle: " << secondsSince(start) * 1e9 / kCycles << " ns/cycle\n";
+    return 0;
+}
@@ -0,0 +1,451 @@
+// Synthetic load driver: feeds a generated workload (Workload.h) to a
+// BankQueueManager and reports throughput and latency percentiles.
+//
+// In-process (default), commands go straight to a fresh manager through the
+// handle API on this thread, with results and logging turned off; its queue
+// backend is picked with --scheduler set|fifo (Scheduler.h). With
+// --connect they go to a running `bankq --serve` over the binary protocol,
+// spread round-robin over --connections sockets.
+//
+// With --rate the arrivals are open loop: each command is due at its own
+// Poisson arrival time whether or not earlier ones were answered, and its
+// latency runs from that due time, so queueing behind a slow command counts
+// (no coordinated omission). Without --rate the driver runs closed loop:
+// in-process back to back, over sockets with --depth commands in flight per
+// connection.
+//
+// The server must know the generated accounts: write them with --clients-out
+// and start the server from that directory, e.g.
+//   ./workload_driver --accounts 1000000 --clients-out /tmp/w/clients.json
+//   (cd /tmp/w && bankq --serve 7000) &
+//   ./workload_driver --accounts 1000000 --connect 127.0.0.1 7000 --rate 200000
+// --script-out writes the command stream as a script for `bankq --batch`.
+//
+// Build (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp benchmarks/workload_driver.cpp -o workload_driver
+#include "Workload.h"
+#include "../WireProtocol.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    WorkloadConfig workload;
+    const char* host = nullptr;
+    uint16_t port = 0;
+    int connections = 1;
+    int depth = 32;
+    SchedulerBackend scheduler = SchedulerBackend::ORDERED_SET;
+    const char* clientsOut = nullptr;
+    const char* scriptOut = nullptr;
+};
+
+struct Report {
+    uint64_t commands = 0;
+    uint64_t errors = 0;              // socket mode: ERROR frames (e.g. cancel with nothing queued)
+    double seconds = 0;
+    std::vector<float> latenciesUs;
+};
+
+void usage(const char* argv0)
+{
+    std::cerr << "Invalid usage. Use: " << argv0 << " [--accounts N] [--commands N] [--zipf S] [--rate R] [--seed N]\n"
+              << "    [--mix deposit=W,withdraw=W,check=W,transfer=W,cancel=W,serve=W]\n"
+              << "    [--types vip=W,business=W,regular=W] [--amounts MIN MAX] [--balances MIN MAX] [--scheduler set|fifo]\n"
+              << "    [--connect HOST PORT [--connections N] [--depth N]]\n"
+              << "    [--clients-out FILE | --script-out FILE]" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& o)
+{
+    WorkloadConfig& w = o.workload;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const int wanted = (arg == "--amounts" || arg == "--balances" || arg == "--connect") ? 2 : 1;
+        if (argc - i - 1 < wanted) return false;
+        auto number = [&](auto& value) { return parseNumber(std::string_view(argv[++i]), value); };
+        bool ok = true;
+        if (arg == "--accounts") {
+            ok = number(w.accounts) && w.accounts >= 2;
+        } else if (arg == "--commands") {
+            ok = number(w.commands) && w.commands > 0;
+        } else if (arg == "--seed") {
+            ok = number(w.seed);
+        } else if (arg == "--zipf" || arg == "--rate") {
+            char* end = nullptr;
+            const double v = std::strtod(argv[++i], &end);
+            ok = *end == '\0' && v >= 0;
+            (arg == "--zipf" ? w.zipf : w.rate) = v;
+        } else if (arg == "--mix") {
+            ok = parseWorkloadWeights(argv[++i], kWorkloadOpNames, w.mix);
+        } else if (arg == "--types") {
+            ok = parseWorkloadWeights(argv[++i], kWorkloadTypeNames, w.typeWeights);
+        } else if (arg == "--amounts") {
+            ok = number(w.minAmount) && number(w.maxAmount) && w.minAmount <= w.maxAmount;
+        } else if (arg == "--balances") {
+            ok = number(w.minBalance) && number(w.maxBalance) && w.minBalance <= w.maxBalance;
+        } else if (arg == "--connect") {
+            o.host = argv[++i];
+            ok = number(o.port) && o.port > 0;
+        } else if (arg == "--connections") {
+            ok = number(o.connections) && o.connections > 0;
+        } else if (arg == "--depth") {
+            ok = number(o.depth) && o.depth > 0;
+        } else if (arg == "--scheduler") {
+            o.scheduler = parseSchedulerBackend(argv[++i]);
+            ok = o.scheduler != SchedulerBackend::UNKNOWN;
+        } else if (arg == "--clients-out") {
+            o.clientsOut = argv[++i];
+        } else if (arg == "--script-out") {
+            o.scriptOut = argv[++i];
+        } else {
+            ok = false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// --- Generated files ---
+
+bool writeClients(const WorkloadGenerator& gen, const char* path)
+{
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "{\n  \"clients\": [\n";
+    for (uint32_t i = 0; i < gen.config().accounts; ++i) {
+        out << "    { \"id\": \"" << WorkloadGenerator::accountId(i) << "\", \"balance\": " << gen.accountBalance(i)
+            << ", \"clientType\": \"" << client_type_to_string(gen.accountType(i)) << "\" }"
+            << (i + 1 < gen.config().accounts ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+bool writeScript(WorkloadGenerator& gen, const char* path)
+{
+    std::ofstream out(path);
+    if (!out) return false;
+    std::string line;
+    for (uint64_t i = 0; i < gen.config().commands; ++i) {
+        line.clear();
+        WorkloadGenerator::appendText(gen.next(), line);
+        out << line;
+    }
+    return static_cast<bool>(out);
+}
+
+// --- In-process ---
+
+void waitUntil(Clock::time_point due)
+{
+    // Sleeping is far too coarse for sub-millisecond arrival gaps: sleep
+    // the bulk of a long gap, spin the rest.
+    const auto now = Clock::now();
+    if (due - now > std::chrono::milliseconds(2)) std::this_thread::sleep_for(due - now - std::chrono::milliseconds(1));
+    while (Clock::now() < due) {}
+}
+
+Report runInProcess(WorkloadGenerator& gen, SchedulerBackend scheduler)
+{
+    const WorkloadConfig& w = gen.config();
+    BankQueueManager manager(scheduler);
+    manager.setOutputFormat(OutputFormat::NONE);
+    std::vector<uint32_t> handles(w.accounts);
+    for (uint32_t i = 0; i < w.accounts; ++i) {
+        const std::string id = WorkloadGenerator::accountId(i);
+        manager.addBankClient(id, gen.accountBalance(i), client_type_to_string(gen.accountType(i)));
+        handles[i] = manager.findClientHandle(id);
+    }
+
+    // Generated up front so drawing random numbers is not part of the latency.
+    std::vector<WorkloadCommand> commands(w.commands);
+    for (WorkloadCommand& c : commands) c = gen.next();
+
+    Report report;
+    report.latenciesUs.reserve(commands.size());
+    const auto start = Clock::now();
+    for (const WorkloadCommand& c : commands) {
+        const auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(c.arrival));
+        auto began = due;
+        if (w.rate > 0) waitUntil(due);
+        else began = Clock::now();
+
+        switch (c.op) {
+            case WorkloadOp::SERVE:    manager.serveNext(); break;
+            case WorkloadOp::CANCEL:   manager.cancelClient(handles[c.client]); break;
+            case WorkloadOp::DEPOSIT:  manager.addRequest(handles[c.client], Service::DEPOSIT, c.amount); break;
+            case WorkloadOp::WITHDRAW: manager.addRequest(handles[c.client], Service::WITHDRAW, c.amount); break;
+            case WorkloadOp::CHECK:    manager.addRequest(handles[c.client], Service::CHECK, 0); break;
+            case WorkloadOp::TRANSFER:
+                manager.addRequest(handles[c.client], Service::TRANSFER, c.amount, handles[c.target]);
+                break;
+            case WorkloadOp::COUNT: break;
+        }
+        report.latenciesUs.push_back(std::chrono::duration<float, std::micro>(Clock::now() - began).count());
+    }
+    manager.flushResults();
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.commands = commands.size();
+    std::cerr << "queue size at end: " << manager.queueSize() << "\n";
+    return report;
+}
+
+// --- Over sockets (binary protocol) ---
+
+int connectTo(const char* host, uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host, &addr.sin_addr) != 1
+        || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Blocking receive until `data` holds at least `wanted` bytes.
+bool receiveBytes(int fd, std::string& data, size_t wanted)
+{
+    char buf[64 * 1024];
+    while (data.size() < wanted) {
+        const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        data.append(buf, static_cast<size_t>(n));
+    }
+    return true;
+}
+
+// Resolves every account id to the server's handle, a chunk at a time so
+// neither side's output backs up.
+bool internAccounts(int fd, uint32_t accounts, std::vector<uint32_t>& handles)
+{
+    constexpr uint32_t kChunk = 4096;
+    const size_t frame = sizeof(WireHeader) + sizeof(WireClient);
+    handles.resize(accounts);
+    for (uint32_t first = 0; first < accounts; first += kChunk) {
+        const uint32_t count = std::min(kChunk, accounts - first);
+        std::string request;
+        for (uint32_t i = first; i < first + count; ++i) {
+            const std::string id = WorkloadGenerator::accountId(i);
+            appendWireFrame(request, static_cast<uint8_t>(WireOp::INTERN), i, id.data(), id.size());
+        }
+        if (::send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) return false;
+        std::string reply;
+        if (!receiveBytes(fd, reply, count * frame)) return false;
+        for (uint32_t k = 0; k < count; ++k) {
+            WireHeader h;
+            std::memcpy(&h, reply.data() + k * frame, sizeof(h));
+            if (h.type != static_cast<uint8_t>(WireReply::HANDLE) || h.length != sizeof(WireClient)) {
+                std::cerr << "server does not know account " << WorkloadGenerator::accountId(first + k)
+                          << " (start it from the directory of the --clients-out file)\n";
+                return false;
+            }
+            std::memcpy(&handles[h.tag], reply.data() + k * frame + sizeof(h), sizeof(WireClient));
+        }
+    }
+    return true;
+}
+
+void appendFrame(const WorkloadCommand& c, uint32_t tag, const std::vector<uint32_t>& handles, std::string& out)
+{
+    if (c.op == WorkloadOp::SERVE) {
+        appendWireFrame(out, static_cast<uint8_t>(WireOp::SERVE), tag, nullptr, 0);
+        return;
+    }
+    if (c.op == WorkloadOp::CANCEL) {
+        WireClient body{handles[c.client]};
+        appendWireFrame(out, static_cast<uint8_t>(WireOp::CANCEL), tag, &body, sizeof(body));
+        return;
+    }
+    static constexpr Service services[] = {Service::DEPOSIT, Service::WITHDRAW, Service::CHECK, Service::TRANSFER};
+    WireAdd add{};
+    add.client = handles[c.client];
+    add.target = c.op == WorkloadOp::TRANSFER ? handles[c.target] : BankQueueManager::kNoClient;
+    add.amount = c.amount;
+    add.service = static_cast<uint8_t>(services[static_cast<size_t>(c.op)]);
+    appendWireFrame(out, static_cast<uint8_t>(WireOp::ADD), tag, &add, sizeof(add));
+}
+
+struct DriverConnection {
+    int fd = -1;
+    std::string out;       // frames not yet sent
+    size_t outSent = 0;
+    std::string in;        // start of a frame not fully received
+    int inFlight = 0;
+};
+
+Report runOverSockets(WorkloadGenerator& gen, const Options& o)
+{
+    const WorkloadConfig& w = gen.config();
+    Report report;
+    std::vector<DriverConnection> conns(o.connections);
+    for (DriverConnection& c : conns) {
+        c.fd = connectTo(o.host, o.port);
+        if (c.fd < 0) {
+            std::cerr << "connect failed: " << std::strerror(errno) << "\n";
+            return report;
+        }
+        ::send(c.fd, &kWireMagic, 1, MSG_NOSIGNAL);
+    }
+    std::vector<uint32_t> handles;
+    if (!internAccounts(conns[0].fd, w.accounts, handles)) return report;
+
+    std::vector<WorkloadCommand> commands(w.commands);
+    for (WorkloadCommand& c : commands) c = gen.next();
+    std::vector<Clock::time_point> began(commands.size()); // indexed by tag
+
+    int ep = ::epoll_create1(0);
+    for (size_t i = 0; i < conns.size(); ++i) {
+        ::fcntl(conns[i].fd, F_SETFL, O_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<uint32_t>(i);
+        ::epoll_ctl(ep, EPOLL_CTL_ADD, conns[i].fd, &ev);
+    }
+
+    auto flush = [](DriverConnection& c) {
+        while (c.outSent < c.out.size()) {
+            const ssize_t n = ::send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+            if (n <= 0) break; // retried after the next receive
+            c.outSent += static_cast<size_t>(n);
+        }
+        if (c.outSent == c.out.size()) {
+            c.out.clear();
+            c.outSent = 0;
+        }
+    };
+
+    report.latenciesUs.reserve(commands.size());
+    const auto start = Clock::now();
+    size_t nextCommand = 0;
+    uint64_t answered = 0;
+    std::vector<epoll_event> events(256);
+    char buf[64 * 1024];
+    while (answered < commands.size()) {
+        // Send what is due: by arrival time (open loop) or by free depth.
+        auto now = Clock::now();
+        while (nextCommand < commands.size()) {
+            const WorkloadCommand& c = commands[nextCommand];
+            DriverConnection& conn = conns[nextCommand % conns.size()];
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(c.arrival));
+            if (w.rate > 0 ? due > now : conn.inFlight >= o.depth) break;
+            began[nextCommand] = w.rate > 0 ? due : now;
+            appendFrame(c, static_cast<uint32_t>(nextCommand), handles, conn.out);
+            ++conn.inFlight;
+            ++nextCommand;
+        }
+        for (DriverConnection& c : conns) if (!c.out.empty()) flush(c);
+
+        int timeoutMs = -1;
+        if (w.rate > 0 && nextCommand < commands.size()) {
+            const auto due = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(commands[nextCommand].arrival));
+            timeoutMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now()).count());
+            if (timeoutMs < 0) timeoutMs = 0; // sub-millisecond gaps: poll
+        }
+        const int n = ::epoll_wait(ep, events.data(), static_cast<int>(events.size()), timeoutMs);
+        if (n < 0 && errno != EINTR) break;
+        now = Clock::now();
+        bool closed = false;
+        for (int i = 0; i < n; ++i) {
+            DriverConnection& c = conns[events[i].data.u32];
+            const ssize_t r = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) closed = true;
+            if (r <= 0) continue;
+            c.in.append(buf, static_cast<size_t>(r));
+            size_t pos = 0;
+            while (c.in.size() - pos >= sizeof(WireHeader)) {
+                WireHeader h;
+                std::memcpy(&h, c.in.data() + pos, sizeof(h));
+                if (c.in.size() - pos - sizeof(h) < h.length) break;
+                bool answer = true;
+                if (h.type == static_cast<uint8_t>(WireReply::RESULT) && h.length == sizeof(ActionResult)) {
+                    ActionResult result;
+                    std::memcpy(&result, c.in.data() + pos + sizeof(h), sizeof(result));
+                    answer = result.event != ResultEvent::HOT; // extra notice, not an answer
+                }
+                if (answer && h.tag < began.size()) {
+                    report.errors += h.type == static_cast<uint8_t>(WireReply::ERROR);
+                    report.latenciesUs.push_back(std::chrono::duration<float, std::micro>(now - began[h.tag]).count());
+                    --c.inFlight;
+                    ++answered;
+                }
+                pos += sizeof(h) + h.length;
+            }
+            c.in.erase(0, pos);
+        }
+        if (closed) {
+            std::cerr << "server closed a connection\n";
+            break;
+        }
+    }
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    report.commands = answered;
+    for (DriverConnection& c : conns) ::close(c.fd);
+    ::close(ep);
+    return report;
+}
+
+void printReport(const Options& o, Report& r)
+{
+    const WorkloadConfig& w = o.workload;
+    std::cout << "accounts: " << w.accounts << ", zipf " << w.zipf << ", mix";
+    for (size_t i = 0; i < w.mix.size(); ++i) std::cout << " " << kWorkloadOpNames[i] << "=" << w.mix[i];
+    std::cout << "\n";
+    std::cout << "mode: " << (o.host ? "socket" : std::string("in-process, ") + scheduler_backend_to_string(o.scheduler) + " scheduler")
+              << (w.rate > 0 ? ", open loop at " + std::to_string(static_cast<long long>(w.rate)) + " commands/sec"
+                             : std::string(", closed loop")) << "\n";
+    std::cout << "commands: " << r.commands << " in " << r.seconds << " s ("
+              << static_cast<long long>(r.seconds > 0 ? r.commands / r.seconds : 0) << " commands/sec)";
+    if (o.host) std::cout << ", " << r.errors << " error replies";
+    std::cout << "\n";
+    if (r.latenciesUs.empty()) return;
+
+    std::sort(r.latenciesUs.begin(), r.latenciesUs.end());
+    auto at = [&](double q) { return r.latenciesUs[static_cast<size_t>(q * (r.latenciesUs.size() - 1))]; };
+    std::cout << std::fixed << std::setprecision(1)
+              << "latency (us) | p50: " << at(0.5) << " | p90: " << at(0.9) << " | p99: " << at(0.99)
+              << " | p99.9: " << at(0.999) << " | max: " << r.latenciesUs.back() << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+    Logger::instance().setLevel(LogLevel::SILENT); // measure the queue, not the console
+
+    WorkloadGenerator gen(options.workload);
+    if (options.clientsOut || options.scriptOut) {
+        const bool ok = options.clientsOut ? writeClients(gen, options.clientsOut) : writeScript(gen, options.scriptOut);
+        if (!ok) std::cerr << "Failed to write '" << (options.clientsOut ? options.clientsOut : options.scriptOut) << "'.\n";
+        return ok ? 0 : 1;
+    }
+
+    Report report = options.host ? runOverSockets(gen, options) : runInProcess(gen, options.scheduler);
+    printReport(options, report);
+    return report.commands == options.workload.commands ? 0 : 1;
+}
@@ -0,0 +1,347 @@
+#include "ClusterNode.h"
+#include <sstream>
+
+// --- gRPC service ---
+
+class ClusterNode::Service final : public bankq::BankNode::Service
+{
+    public:
+        explicit Service(ClusterNode& node) : node(node) {}
+
+        grpc::Status Execute(grpc::ServerContext*, const bankq::CommandRequest* request, bankq::CommandReply* reply) override
+        {
+            reply->set_output(node.execute(*request));
+            return grpc::Status::OK;
+        }
+
+        grpc::Status OpenAccount(grpc::ServerContext*, const bankq::Account* account, bankq::AccountReply* reply) override
+        {
+            std::string error;
+            reply->set_ok(node.openAccount(account->id(), account->balance(), account->client_type(), error));
+            reply->set_error(error);
+            return grpc::Status::OK;
+        }
+
+        grpc::Status Prepare(grpc::ServerContext*, const bankq::PrepareRequest* request, bankq::Vote* vote) override
+        {
+            *vote = node.prepare(*request);
+            return grpc::Status::OK;
+        }
+
+        grpc::Status Commit(grpc::ServerContext*, const bankq::Decision* decision, bankq::Ack*) override
+        {
+            node.commit(decision->txid());
+            return grpc::Status::OK;
+        }
+
+        grpc::Status Abort(grpc::ServerContext*, const bankq::Decision* decision, bankq::Ack*) override
+        {
+            node.abort(decision->txid());
+            return grpc::Status::OK;
+        }
+
+    private:
+        ClusterNode& node;
+};
+
+// --- ClusterNode ---
+
+ClusterNode::ClusterNode(uint32_t self, std::vector<std::string> peers) : self(self), peers(std::move(peers))
+{
+    manager.setTransferRouter(this);
+    manager.setHistorySpillPath("history.node" + std::to_string(self) + ".bin");
+}
+
+ClusterNode::~ClusterNode()
+{
+    shutdown();
+}
+
+uint32_t ClusterNode::ownerOf(std::string_view id, size_t nodes)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : id) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return static_cast<uint32_t>(hash % nodes);
+}
+
+bool ClusterNode::openAccount(const std::string& id, int balance, const std::string& type, std::string& error)
+{
+    const uint32_t owner = ownerOf(id, peers.size());
+    if (owner != self) {
+        error = "account " + id + " belongs to node " + std::to_string(owner);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (manager.findClientHandle(id) != BankQueueManager::kNoClient) {
+        error = "duplicate account " + id;
+        return false;
+    }
+    if (!manager.addBankClient(id, balance, type)) {
+        error = "invalid client type " + type;
+        return false;
+    }
+    return true;
+}
+
+bool ClusterNode::loadAccounts(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open file '" << path << "'.\n";
+        return false;
+    }
+    json j;
+    in >> j;
+    for (const auto& clientJson : j["clients"]) {
+        try {
+            const std::string id = clientJson.at("id").get<std::string>();
+            if (ownerOf(id, peers.size()) != self) continue;
+            std::string error;
+            if (!openAccount(id, clientJson.at("balance").get<int>(), clientJson.at("clientType").get<std::string>(), error))
+                std::cerr << error << "\n";
+        } catch (const std::out_of_range& e) {
+            std::cerr << "Missing required client field: " << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+bool ClusterNode::start()
+{
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        stubs.push_back(i == self ? nullptr
+                                  : bankq::BankNode::NewStub(grpc::CreateChannel(peers[i], grpc::InsecureChannelCredentials())));
+    }
+    service = std::make_unique<Service>(*this);
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(peers[self], grpc::InsecureServerCredentials());
+    builder.RegisterService(service.get());
+    server = builder.BuildAndStart();
+    if (!server) {
+        std::cerr << "Cannot listen on " << peers[self] << std::endl;
+        return false;
+    }
+    for (int i = 0; i < kCoordinators; ++i) coordinators.emplace_back([this] { coordinate(); });
+    return true;
+}
+
+void ClusterNode::wait()
+{
+    if (server) server->Wait();
+}
+
+// Stops taking RPCs, then lets the coordinators finish the transfers already
+// reserved (a peer that is gone aborts them after kRpcTimeout).
+void ClusterNode::shutdown()
+{
+    if (server) server->Shutdown();
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex);
+        stopping = true;
+    }
+    transfersReady.notify_all();
+    for (std::thread& t : coordinators) t.join();
+    coordinators.clear();
+}
+
+// Only ADD / CANCEL / SERVE, POSITION / ESTIMATE and the two listings, like the TCP server.
+std::string ClusterNode::execute(const bankq::CommandRequest& request)
+{
+    Waiter waiter;
+    std::unique_lock<std::mutex> lock(mutex);
+    manager.setOutputSink(&waiter);
+    current = &waiter;
+    for (const std::string& line : request.lines()) {
+        const ParsedCommand p = parseCommandLine(line);
+        if (p.args.empty()) continue;
+        switch (p.command) {
+            case Command::ADD:
+            case Command::CANCEL:
+            case Command::SERVE:
+            case Command::POSITION:
+            case Command::ESTIMATE:
+                manager.runCommand(p);
+                break;
+            case Command::PRINTQ:
+            case Command::PRINTC: {
+                manager.flushResults();
+                std::ostringstream report;
+                if (p.command == Command::PRINTQ) manager.printQueue(report);
+                else manager.printBankClients(report);
+                waiter.text.append(report.str());
+                break;
+            }
+            default:
+                manager.flushResults();
+                waiter.writeLine("Command not available over the network: " + std::string(p.args[0]));
+                break;
+        }
+    }
+    current = nullptr;
+    manager.setOutputSink(nullptr); // renders the pending results into `waiter`
+    waiter.settled.wait(lock, [&] { return waiter.outstanding == 0; });
+    return std::move(waiter.text);
+}
+
+bool ClusterNode::findRemote(std::string_view id, RemoteAccount& where) const
+{
+    const uint32_t owner = ownerOf(id, peers.size());
+    if (owner == self) return false;
+    auto it = remoteIndex.find(id);
+    if (it == remoteIndex.end()) {
+        remoteIds.emplace_back(id);
+        it = remoteIndex.emplace(remoteIds.back(), static_cast<uint32_t>(remoteIds.size() - 1)).first;
+    }
+    where = RemoteAccount{owner, it->second};
+    return true;
+}
+
+// Called by the manager, under `mutex`, when it serves a cross-node transfer.
+void ClusterNode::sendCredit(const RemoteAccount& where, uint64_t transferId, int amount)
+{
+    if (current) {
+        ++current->outstanding;
+        waiters.emplace(transferId, current);
+    }
+    {
+        std::lock_guard<std::mutex> lock(transfersMutex);
+        transfers.push_back(Transfer{transferId, where.branch, remoteIds[where.handle], amount});
+    }
+    transfersReady.notify_one();
+}
+
+// --- Two-phase commit, participant side ---
+
+// Votes yes if the account is ours and can take the credit on top of the
+// credits already promised to it, and holds that room until the decision.
+bankq::Vote ClusterNode::prepare(const bankq::PrepareRequest& request)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bankq::Vote vote;
+    if (prepared.count(request.txid())) {
+        vote.set_yes(true); // a retried Prepare
+        return vote;
+    }
+    const uint32_t client = manager.findClientHandle(request.account());
+    ResultCode code = ResultCode::OK;
+    if (decided.count(request.txid())) {
+        code = ResultCode::REJECTED; // late: the coordinator has moved on
+    } else if (client == BankQueueManager::kNoClient) {
+        code = ResultCode::REJECTED;
+    } else if (request.amount() <= 0) {
+        code = ResultCode::INVALID_AMOUNT;
+    } else if (!manager.holdRemoteCredit(client, request.amount())) {
+        code = ResultCode::BALANCE_OVERFLOW;
+    }
+    if (code == ResultCode::OK)
+        prepared.emplace(request.txid(), Prepared{client, request.amount(), request.from_node()});
+    vote.set_yes(code == ResultCode::OK);
+    vote.set_code(static_cast<uint32_t>(code));
+    return vote;
+}
+
+void ClusterNode::commit(uint64_t txid)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = prepared.find(txid);
+    if (it == prepared.end()) return; // already committed
+    const Prepared p = it->second;
+    prepared.erase(it);
+    remember(txid);
+    // The held room is released and used by the same credit, under the lock.
+    manager.releaseRemoteCredit(p.client, p.amount);
+    const ResultCode code = manager.applyRemoteCredit(p.client, p.amount, p.fromNode);
+    manager.flushResults();
+    if (code != ResultCode::OK)
+        logError() << "Committed transaction " << txid << " could not be credited (" << result_code_to_string(code) << ")";
+}
+
+void ClusterNode::abort(uint64_t txid)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!decided.count(txid)) remember(txid); // also when its Prepare has not arrived yet
+    auto it = prepared.find(txid);
+    if (it == prepared.end()) return;
+    manager.releaseRemoteCredit(it->second.client, it->second.amount);
+    prepared.erase(it);
+}
+
+void ClusterNode::remember(uint64_t txid)
+{
+    decided.insert(txid);
+    decidedOrder.push_back(txid);
+    if (decidedOrder.size() > kDecidedRemembered) {
+        decided.erase(decidedOrder.front());
+        decidedOrder.pop_front();
+    }
+}
+
+// --- Two-phase commit, coordinator side ---
+
+void ClusterNode::coordinate()
+{
+    while (true) {
+        Transfer t;
+        {
+            std::unique_lock<std::mutex> lock(transfersMutex);
+            transfersReady.wait(lock, [&] { return stopping || !transfers.empty(); });
+            if (transfers.empty()) return;
+            t = std::move(transfers.front());
+            transfers.pop_front();
+        }
+
+        const uint64_t txid = static_cast<uint64_t>(self) << 48 | t.transferId;
+        bankq::PrepareRequest request;
+        request.set_txid(txid);
+        request.set_from_node(self);
+        request.set_account(t.account);
+        request.set_amount(t.amount);
+        bankq::Vote vote;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + kRpcTimeout);
+        const grpc::Status status = stubs[t.node]->Prepare(&context, request, &vote);
+
+        const bool commit = status.ok() && vote.yes();
+        if (!decide(t.node, txid, commit) && commit)
+            logError() << "Node " << t.node << " did not acknowledge the commit of transaction " << txid;
+        complete(t, commit ? ResultCode::OK : status.ok() ? static_cast<ResultCode>(vote.code()) : ResultCode::REJECTED);
+    }
+}
+
+// Delivers the decision, retrying with backoff. The source commits or
+// refunds whatever the participant answers: once decided, the outcome stands.
+bool ClusterNode::decide(uint32_t node, uint64_t txid, bool commit)
+{
+    bankq::Decision decision;
+    decision.set_txid(txid);
+    auto backoff = std::chrono::milliseconds(10);
+    for (int attempt = 0; attempt < kDecisionAttempts; ++attempt) {
+        bankq::Ack ack;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + kRpcTimeout);
+        const grpc::Status status = commit ? stubs[node]->Commit(&context, decision, &ack)
+                                           : stubs[node]->Abort(&context, decision, &ack);
+        if (status.ok()) return true;
+        std::this_thread::sleep_for(backoff);
+        backoff *= 2;
+    }
+    return false;
+}
+
+// Settles the reservation, into the output of the Execute that served it.
+void ClusterNode::complete(const Transfer& transfer, ResultCode code)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = waiters.find(transfer.transferId);
+    Waiter* waiter = it != waiters.end() ? it->second : nullptr;
+    if (waiter) manager.setOutputSink(waiter);
+    manager.settleRemoteTransfer(transfer.transferId, code);
+    manager.setOutputSink(nullptr);
+    if (waiter) {
+        waiters.erase(it);
+        if (--waiter->outstanding == 0) waiter->settled.notify_one();
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../BankQueueManager.h"
+#include "bank_node.grpc.pb.h"
+
+// A BankQueueManager served over gRPC as one node of a cluster.
+//
+// Every node knows the addresses of all nodes. An account belongs to node
+// ownerOf(id), so any node can tell where an id lives without asking. A node
+// only opens its own accounts and only takes commands for them (Execute);
+// a transfer whose target belongs to another node is a distributed
+// transaction, committed with two-phase commit:
+//
+//  - Serving the transfer reserves the amount at the source (debited to the
+//    inter-branch clearing account, see TransferRouter): the source's vote
+//    is already yes.
+//  - A coordinator thread of the source node sends Prepare to the target's
+//    node, which votes yes if the account exists and can take the credit,
+//    and holds that headroom for the transaction: no other credit can use
+//    it, so a Commit always applies. A Prepare for a transaction already
+//    decided (it arrived after its Abort) votes no.
+//  - Yes: Commit, the target credits the account and the source commits the
+//    reservation. No (or no answer before kRpcTimeout): Abort, and the source
+//    refunds it.
+//
+// The manager stays single-writer: RPC handlers and coordinators take turns
+// under one mutex, which is never held across an RPC, so two nodes
+// transferring to each other cannot deadlock. Execute answers once the
+// transfers it served have settled, with their outcome in the output.
+//
+// Decisions are not logged: a node that restarts forgets its transactions,
+// and a participant that never hears the decision keeps its hold.
+
+class ClusterNode : public TransferRouter
+{
+    public:
+        static constexpr int kCoordinators = 4;        // transfers in flight per node
+        static constexpr std::chrono::milliseconds kRpcTimeout{2000};
+        static constexpr int kDecisionAttempts = 5;    // Commit / Abort deliveries before giving up
+        static constexpr size_t kDecidedRemembered = 65536; // participant txids kept to refuse late Prepares
+
+        // `peers[self]` is this node's own listening address.
+        ClusterNode(uint32_t self, std::vector<std::string> peers);
+        ~ClusterNode();
+
+        ClusterNode(const ClusterNode&) = delete;
+        ClusterNode& operator=(const ClusterNode&) = delete;
+
+        // Node owning `id` in a cluster of `nodes` (FNV-1a of the id, the same
+        // in every process).
+        static uint32_t ownerOf(std::string_view id, size_t nodes);
+
+        // Opens an account of this node; false with the reason otherwise.
+        bool openAccount(const std::string& id, int balance, const std::string& type, std::string& error);
+        // Opens the accounts of a clients.json that belong to this node.
+        bool loadAccounts(const std::string& path);
+
+        // Listens on peers[self] and starts the coordinators. False (reason
+        // on stderr) if the address cannot be bound.
+        bool start();
+        void wait();
+        void shutdown();
+
+        // TransferRouter: accounts of other nodes.
+        bool findRemote(std::string_view id, RemoteAccount& where) const override;
+        void sendCredit(const RemoteAccount& where, uint64_t transferId, int amount) override;
+
+    private:
+        class Service;
+
+        // Output of one Execute, and the transfers it still waits for.
+        struct Waiter : OutputSink {
+            std::string text;
+            size_t outstanding = 0;
+            std::condition_variable settled;
+            void writeLine(std::string_view line) override
+            {
+                text.append(line);
+                text.push_back('\n');
+            }
+        };
+
+        struct Transfer {
+            uint64_t transferId;   // the manager's
+            uint32_t node;
+            std::string account;
+            int amount;
+        };
+
+        struct Prepared {
+            uint32_t client;
+            int amount;
+            uint32_t fromNode;
+        };
+
+        const uint32_t self;
+        const std::vector<std::string> peers;
+
+        std::mutex mutex; // guards the manager and everything down to `remoteIndex`
+        BankQueueManager manager;
+        Waiter* current = nullptr;                        // Execute running its commands
+        std::unordered_map<uint64_t, Waiter*> waiters;    // by transfer id
+        std::unordered_map<uint64_t, Prepared> prepared;  // participant side, by txid
+        std::unordered_set<uint64_t> decided;             // participant txids committed or aborted, newest kDecidedRemembered
+        std::deque<uint64_t> decidedOrder;                // `decided` oldest first
+        mutable std::deque<std::string> remoteIds;        // index = RemoteAccount::handle
+        mutable std::unordered_map<std::string_view, uint32_t> remoteIndex;
+
+        std::mutex transfersMutex; // guards `transfers` and `stopping`
+        std::condition_variable transfersReady;
+        std::deque<Transfer> transfers;
+        bool stopping = false;
+        std::vector<std::thread> coordinators;
+
+        std::vector<std::unique_ptr<bankq::BankNode::Stub>> stubs; // by node; set by start(), then read-only
+        std::unique_ptr<Service> service;
+        std::unique_ptr<grpc::Server> server;
+
+        std::string execute(const bankq::CommandRequest& request);
+        bankq::Vote prepare(const bankq::PrepareRequest& request);
+        void commit(uint64_t txid);
+        void abort(uint64_t txid);
+        void remember(uint64_t txid);
+
+        void coordinate();
+        bool decide(uint32_t node, uint64_t txid, bool commit);
+        void complete(const Transfer& transfer, ResultCode code);
+};
@@ -0,0 +1,853 @@
+#include "RaftReplica.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+
+bool writeAll(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        const ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0) return false;
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+// Replaces `path` with `content` (written to a temporary file, then renamed
+// over it, so a crash leaves the old or the new content).
+bool replaceFile(const std::string& path, std::string_view content, bool sync)
+{
+    const std::string tmp = path + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    const bool ok = writeAll(fd, content) && (!sync || ::fdatasync(fd) == 0);
+    ::close(fd);
+    return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// One line of the log file.
+std::string entryLine(uint64_t term, const std::vector<std::string>& lines)
+{
+    return json{{"term", term}, {"lines", lines}}.dump() + '\n';
+}
+
+bool loadAccounts(BankQueueManager& manager, const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open file '" << path << "'.\n";
+        return false;
+    }
+    json j;
+    in >> j;
+    for (const auto& clientJson : j["clients"]) {
+        try {
+            manager.addBankClient(clientJson.at("id").get<std::string>(), clientJson.at("balance").get<int>(),
+                                  clientJson.at("clientType").get<std::string>());
+        } catch (const std::out_of_range& e) {
+            std::cerr << "Missing required client field: " << e.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// --- gRPC service ---
+
+class RaftReplica::Service final : public bankq::Replica::Service
+{
+    public:
+        explicit Service(RaftReplica& replica) : replica(replica) {}
+
+        grpc::Status Execute(grpc::ServerContext*, const bankq::ReplicaCommand* command, bankq::ReplicaReply* reply) override
+        {
+            *reply = replica.execute(*command);
+            return grpc::Status::OK;
+        }
+
+        grpc::Status RequestVote(grpc::ServerContext*, const bankq::VoteRequest* request, bankq::VoteReply* reply) override
+        {
+            *reply = replica.requestVote(*request);
+            return grpc::Status::OK;
+        }
+
+        grpc::Status AppendEntries(grpc::ServerContext*, const bankq::AppendRequest* request, bankq::AppendReply* reply) override
+        {
+            *reply = replica.appendEntries(*request);
+            return grpc::Status::OK;
+        }
+
+        grpc::Status InstallSnapshot(grpc::ServerContext*, const bankq::SnapshotRequest* request, bankq::SnapshotReply* reply) override
+        {
+            *reply = replica.installSnapshot(*request);
+            return grpc::Status::OK;
+        }
+
+    private:
+        RaftReplica& replica;
+};
+
+// --- RaftReplica ---
+
+RaftReplica::RaftReplica(uint32_t self, std::vector<std::string> peers, std::string dataDir, bool syncWrites)
+    : self(self), peers(std::move(peers)), dataDir(std::move(dataDir)), syncWrites(syncWrites),
+      random(std::random_device{}() ^ self)
+{
+}
+
+RaftReplica::~RaftReplica()
+{
+    shutdown();
+    if (logFd >= 0) ::close(logFd);
+}
+
+bool RaftReplica::start(const std::string& clientsPath)
+{
+    if (!recover(clientsPath)) return false;
+    grpc::ChannelArguments args;
+    args.SetMaxReceiveMessageSize(-1); // snapshots
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        replicas.push_back(std::make_unique<Peer>());
+        if (i != self)
+            replicas[i]->stub = bankq::Replica::NewStub(grpc::CreateCustomChannel(peers[i], grpc::InsecureChannelCredentials(), args));
+    }
+    service = std::make_unique<Service>(*this);
+    grpc::ServerBuilder builder;
+    builder.SetMaxReceiveMessageSize(-1);
+    builder.AddListeningPort(peers[self], grpc::InsecureServerCredentials());
+    builder.RegisterService(service.get());
+    server = builder.BuildAndStart();
+    if (!server) {
+        std::cerr << "Cannot listen on " << peers[self] << std::endl;
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        resetElectionTimer();
+    }
+    ticker = std::thread([this] { tick(); });
+    applier = std::thread([this] { applyLoop(); });
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        if (i != self) replicas[i]->thread = std::thread([this, i] { replicate(*replicas[i]); });
+    }
+    return true;
+}
+
+void RaftReplica::wait()
+{
+    if (server) server->Wait();
+}
+
+void RaftReplica::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        stopping = true;
+        for (auto& [index, waiter] : waiters) waiter->settled.notify_one();
+    }
+    if (server) server->Shutdown(std::chrono::system_clock::now() + kRpcTimeout);
+    for (auto& peer : replicas) peer->queue.Shutdown();
+    voteQueue.Shutdown();
+    applyReady.notify_all();
+    for (std::thread* t : {&ticker, &applier}) {
+        if (t->joinable()) t->join();
+    }
+    for (auto& peer : replicas) {
+        if (peer->thread.joinable()) peer->thread.join();
+    }
+}
+
+// --- Client commands ---
+
+bankq::ReplicaReply RaftReplica::execute(const bankq::ReplicaCommand& command)
+{
+    bankq::ReplicaReply reply;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (role != Role::LEADER || stopping) {
+        reply.set_ok(false);
+        reply.set_error("not the leader");
+        if (leaderId >= 0 && leaderId != self) reply.set_leader(peers[leaderId]);
+        return reply;
+    }
+
+    Waiter waiter;
+    waiter.term = currentTerm;
+    const uint64_t index = appendLocal(Entry{currentTerm, {command.lines().begin(), command.lines().end()}});
+    waiters.emplace(index, &waiter);
+    pumpAll(); // followers write it while we do
+    lock.unlock();
+    syncLog(index);
+    lock.lock();
+    advanceCommit();
+    waiter.settled.wait_for(lock, kCommitTimeout, [&] { return waiter.done || stopping; });
+    auto it = waiters.find(index);
+    if (it != waiters.end() && it->second == &waiter) waiters.erase(it);
+
+    reply.set_ok(waiter.applied);
+    if (waiter.applied) {
+        reply.set_output(std::move(waiter.text));
+    } else {
+        reply.set_error(stopping ? "replica shutting down"
+                        : waiter.done ? "leadership changed, command not applied"
+                                      : "not committed in time, outcome unknown");
+        if (leaderId >= 0 && leaderId != self) reply.set_leader(peers[leaderId]);
+    }
+    return reply;
+}
+
+// --- Elections ---
+
+void RaftReplica::tick()
+{
+    while (true) {
+        std::chrono::system_clock::time_point deadline;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto wait = role == Role::LEADER ? kHeartbeat
+                                                   : std::max(std::chrono::steady_clock::duration::zero(),
+                                                              electionDeadline - std::chrono::steady_clock::now());
+            deadline = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(wait);
+        }
+        void* tag;
+        bool ok;
+        const auto status = voteQueue.AsyncNext(&tag, &ok, deadline);
+        if (status == grpc::CompletionQueue::SHUTDOWN) return;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        const bool leading = role == Role::LEADER;
+        if (status == grpc::CompletionQueue::GOT_EVENT) {
+            std::unique_ptr<Call> call(static_cast<Call*>(tag));
+            if (call->status.ok()) {
+                if (call->vote.term() > currentTerm) becomeFollower(call->vote.term());
+                else if (role == Role::CANDIDATE && call->term == currentTerm && call->vote.granted() && ++votes > peers.size() / 2)
+                    becomeLeader();
+            }
+        }
+        if (!stopping && role != Role::LEADER && std::chrono::steady_clock::now() >= electionDeadline) startElection();
+        if (!leading && role == Role::LEADER) {
+            // Elected: count the term's no-op once it is synced, off the lock.
+            const uint64_t index = lastIndex();
+            lock.unlock();
+            syncLog(index);
+            lock.lock();
+            advanceCommit();
+        }
+    }
+}
+
+void RaftReplica::startElection()
+{
+    role = Role::CANDIDATE;
+    ++currentTerm;
+    votedFor = self;
+    leaderId = -1;
+    votes = 1;
+    persistState();
+    resetElectionTimer();
+    if (votes > peers.size() / 2) {
+        becomeLeader(); // a cluster of one
+        return;
+    }
+    bankq::VoteRequest request;
+    request.set_term(currentTerm);
+    request.set_candidate(self);
+    request.set_last_log_index(lastIndex());
+    request.set_last_log_term(termAt(lastIndex()));
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        if (i == self) continue;
+        Call* call = new Call();
+        call->kind = Call::VOTE;
+        call->term = currentTerm;
+        call->context.set_deadline(std::chrono::system_clock::now() + kElectionTimeoutMin);
+        replicas[i]->stub->AsyncRequestVote(&call->context, request, &voteQueue)->Finish(&call->vote, &call->status, call);
+    }
+}
+
+void RaftReplica::becomeFollower(uint64_t term)
+{
+    if (term > currentTerm) {
+        currentTerm = term;
+        votedFor = -1;
+        persistState();
+    }
+    if (role != Role::FOLLOWER) {
+        role = Role::FOLLOWER;
+        resetElectionTimer();
+    }
+}
+
+// Starts the term with a no-op entry: committing it commits whatever the
+// previous leaders left in our log. tick() syncs it once off the lock.
+void RaftReplica::becomeLeader()
+{
+    role = Role::LEADER;
+    leaderId = self;
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        Peer& peer = *replicas[i];
+        peer.nextIndex = lastIndex() + 1;
+        peer.matchIndex = 0;
+        peer.retryAt = {};
+        peer.lastSent = {};
+    }
+    logInfo() << "Replica " << self << " leads term " << currentTerm;
+    appendLocal(Entry{currentTerm, {}});
+    pumpAll();
+}
+
+void RaftReplica::resetElectionTimer()
+{
+    std::uniform_int_distribution<int> timeout(static_cast<int>(kElectionTimeoutMin.count()),
+                                               static_cast<int>(kElectionTimeoutMax.count()));
+    electionDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout(random));
+}
+
+bankq::VoteReply RaftReplica::requestVote(const bankq::VoteRequest& request)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (request.term() > currentTerm) becomeFollower(request.term());
+    const uint64_t lastTerm = termAt(lastIndex());
+    const bool upToDate = request.last_log_term() > lastTerm
+                          || (request.last_log_term() == lastTerm && request.last_log_index() >= lastIndex());
+    const bool grant = request.term() == currentTerm && (votedFor < 0 || votedFor == request.candidate()) && upToDate;
+    if (grant) {
+        votedFor = request.candidate();
+        persistState();
+        resetElectionTimer();
+    }
+    bankq::VoteReply reply;
+    reply.set_term(currentTerm);
+    reply.set_granted(grant);
+    return reply;
+}
+
+// --- Replication, leader side ---
+
+// One thread per follower: completions, retries and heartbeats.
+void RaftReplica::replicate(Peer& peer)
+{
+    while (true) {
+        void* tag;
+        bool ok;
+        const auto status = peer.queue.AsyncNext(&tag, &ok, std::chrono::system_clock::now() + kHeartbeat / 2);
+        if (status == grpc::CompletionQueue::SHUTDOWN) return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (status == grpc::CompletionQueue::GOT_EVENT) {
+            std::unique_ptr<Call> call(static_cast<Call*>(tag));
+            onReply(peer, *call);
+        }
+        if (!stopping && role == Role::LEADER) pump(peer);
+    }
+}
+
+// Sends what the follower is missing, up to kMaxInFlight calls, or a
+// heartbeat when it has everything and heard nothing for kHeartbeat.
+void RaftReplica::pump(Peer& peer)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (stopping || now < peer.retryAt || peer.snapshotInFlight) return;
+    while (peer.inFlight < kMaxInFlight) {
+        if (peer.nextIndex <= snapshotIndex) {
+            sendSnapshot(peer);
+            return;
+        }
+        const bool behind = peer.nextIndex <= lastIndex();
+        if (!behind && now - peer.lastSent < kHeartbeat) return;
+        sendAppend(peer);
+        if (!behind) return;
+    }
+}
+
+void RaftReplica::sendAppend(Peer& peer)
+{
+    const uint64_t prev = peer.nextIndex - 1;
+    const uint64_t last = std::min(lastIndex(), prev + kMaxBatch);
+    bankq::AppendRequest request;
+    request.set_term(currentTerm);
+    request.set_leader(self);
+    request.set_prev_log_index(prev);
+    request.set_prev_log_term(termAt(prev));
+    request.set_leader_commit(commitIndex);
+    for (uint64_t i = prev + 1; i <= last; ++i) {
+        const Entry& entry = log[i - snapshotIndex - 1];
+        bankq::LogEntry* e = request.add_entries();
+        e->set_term(entry.term);
+        for (const std::string& line : entry.lines) e->add_lines(line);
+    }
+
+    Call* call = new Call();
+    call->kind = Call::APPEND;
+    call->term = currentTerm;
+    call->lastIndex = last;
+    call->context.set_deadline(std::chrono::system_clock::now() + kRpcTimeout);
+    peer.stub->AsyncAppendEntries(&call->context, request, &peer.queue)->Finish(&call->append, &call->status, call);
+    peer.nextIndex = last + 1; // optimistic: the next call goes out before this one is answered
+    ++peer.inFlight;
+    peer.lastSent = std::chrono::steady_clock::now();
+}
+
+void RaftReplica::sendSnapshot(Peer& peer)
+{
+    bankq::SnapshotRequest request;
+    request.set_term(currentTerm);
+    request.set_leader(self);
+    request.set_last_index(snapshotIndex);
+    request.set_last_term(snapshotTerm);
+    request.set_state(snapshotState);
+
+    Call* call = new Call();
+    call->kind = Call::SNAPSHOT;
+    call->term = currentTerm;
+    call->lastIndex = snapshotIndex;
+    call->context.set_deadline(std::chrono::system_clock::now() + 10 * kRpcTimeout);
+    peer.stub->AsyncInstallSnapshot(&call->context, request, &peer.queue)->Finish(&call->snapshot, &call->status, call);
+    peer.snapshotInFlight = true;
+    ++peer.inFlight;
+    peer.lastSent = std::chrono::steady_clock::now();
+}
+
+void RaftReplica::onReply(Peer& peer, const Call& call)
+{
+    --peer.inFlight;
+    if (call.kind == Call::SNAPSHOT) peer.snapshotInFlight = false;
+    if (!call.status.ok()) {
+        // Unreachable: resend from what it acknowledged, after a pause.
+        peer.retryAt = std::chrono::steady_clock::now() + kHeartbeat;
+        if (role == Role::LEADER && call.term == currentTerm) peer.nextIndex = std::min(peer.nextIndex, peer.matchIndex + 1);
+        return;
+    }
+    const uint64_t term = call.kind == Call::SNAPSHOT ? call.snapshot.term() : call.append.term();
+    if (term > currentTerm) {
+        becomeFollower(term);
+        return;
+    }
+    if (role != Role::LEADER || call.term != currentTerm) return;
+
+    if (call.kind == Call::SNAPSHOT || call.append.success()) {
+        const uint64_t match = call.kind == Call::SNAPSHOT ? call.lastIndex : call.append.match_index();
+        peer.matchIndex = std::max(peer.matchIndex, match);
+        peer.nextIndex = std::max(peer.nextIndex, peer.matchIndex + 1);
+        advanceCommit();
+    } else {
+        // Diverged, or a gap left by a call it has not seen yet.
+        peer.nextIndex = std::max(peer.matchIndex + 1, std::min(peer.nextIndex, call.append.conflict_index()));
+    }
+}
+
+// Sends new entries right away from the appending thread; the replicators
+// only handle what comes back.
+void RaftReplica::pumpAll()
+{
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        if (i != self) pump(*replicas[i]);
+    }
+}
+
+// Commits the highest index of this term stored by a majority (our own log
+// counting once synced).
+void RaftReplica::advanceCommit()
+{
+    if (role != Role::LEADER) return;
+    std::vector<uint64_t> match;
+    for (uint32_t i = 0; i < peers.size(); ++i) {
+        match.push_back(i == self ? (syncWrites ? std::min(syncedIndex.load(), lastIndex()) : lastIndex())
+                                  : replicas[i]->matchIndex);
+    }
+    std::sort(match.begin(), match.end(), std::greater<uint64_t>());
+    const uint64_t majority = match[peers.size() / 2];
+    if (majority > commitIndex && termAt(majority) == currentTerm) {
+        commitIndex = majority;
+        applyReady.notify_one();
+    }
+}
+
+// --- Replication, follower side ---
+
+bankq::AppendReply RaftReplica::appendEntries(const bankq::AppendRequest& request)
+{
+    bankq::AppendReply reply;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (request.term() < currentTerm) {
+        reply.set_term(currentTerm);
+        return reply;
+    }
+    becomeFollower(request.term());
+    leaderId = request.leader();
+    resetElectionTimer();
+    reply.set_term(currentTerm);
+
+    // Entries up to snapshotIndex are committed: they match.
+    uint64_t prev = request.prev_log_index();
+    int first = 0;
+    if (prev < snapshotIndex) {
+        const uint64_t skip = snapshotIndex - prev;
+        if (skip >= static_cast<uint64_t>(request.entries_size())) {
+            reply.set_success(true);
+            reply.set_match_index(prev + request.entries_size());
+            return reply;
+        }
+        first = static_cast<int>(skip);
+        prev = snapshotIndex;
+    } else if (prev > lastIndex()) {
+        reply.set_conflict_index(lastIndex() + 1);
+        return reply;
+    } else if (termAt(prev) != request.prev_log_term()) {
+        // Skip the whole conflicting term.
+        uint64_t index = prev;
+        while (index > snapshotIndex + 1 && termAt(index - 1) == termAt(prev)) --index;
+        reply.set_conflict_index(index);
+        return reply;
+    }
+
+    bool truncated = false;
+    std::string appended;
+    uint64_t index = prev;
+    for (int i = first; i < request.entries_size(); ++i) {
+        const bankq::LogEntry& e = request.entries(i);
+        ++index;
+        if (index <= lastIndex()) {
+            if (termAt(index) == e.term()) continue;
+            truncateFrom(index);
+            truncated = true;
+        }
+        log.push_back(Entry{e.term(), {e.lines().begin(), e.lines().end()}});
+        if (!truncated) appended += entryLine(e.term(), log.back().lines);
+    }
+    if (truncated) {
+        rewriteLog();
+    } else if (!appended.empty()) {
+        writeAll(logFd, appended);
+        writtenIndex = lastIndex();
+    }
+    if (request.leader_commit() > commitIndex && index > commitIndex) {
+        commitIndex = std::min(request.leader_commit(), index);
+        applyReady.notify_one();
+    }
+    lock.unlock();
+    syncLog(index);
+    reply.set_success(true);
+    reply.set_match_index(index);
+    return reply;
+}
+
+bankq::SnapshotReply RaftReplica::installSnapshot(const bankq::SnapshotRequest& request)
+{
+    bankq::SnapshotReply reply;
+    std::lock_guard<std::mutex> lock(mutex);
+    reply.set_term(currentTerm);
+    if (request.term() < currentTerm) return reply;
+    becomeFollower(request.term());
+    leaderId = request.leader();
+    resetElectionTimer();
+    reply.set_term(currentTerm);
+    if (request.last_index() <= lastApplied) return reply; // our state is already past it
+
+    std::unique_ptr<BankQueueManager> restored = newManager();
+    try {
+        if (!restored->restoreState(json::parse(request.state()))) return reply;
+    } catch (const json::exception& e) {
+        logError() << "Invalid snapshot from replica " << request.leader() << ": " << e.what();
+        return reply;
+    }
+    // Keep the log after the snapshot if it agrees with it.
+    if (request.last_index() < lastIndex() && termAt(request.last_index()) == request.last_term()) {
+        log.erase(log.begin(), log.begin() + static_cast<std::ptrdiff_t>(request.last_index() - snapshotIndex));
+    } else {
+        truncateFrom(snapshotIndex + 1);
+    }
+    snapshotIndex = request.last_index();
+    snapshotTerm = request.last_term();
+    snapshotState = request.state();
+    manager = std::move(restored);
+    commitIndex = std::max(commitIndex, snapshotIndex);
+    lastApplied = snapshotIndex;
+    {
+        std::lock_guard<std::mutex> syncLock(syncMutex); // after a snapshot takeSnapshot() is still writing
+        persistSnapshot(snapshotFile());
+    }
+    rewriteLog();
+    return reply;
+}
+
+// --- Applying ---
+
+void RaftReplica::applyLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        applyReady.wait(lock, [&] { return stopping || lastApplied < commitIndex; });
+        if (stopping) return;
+        while (lastApplied < commitIndex) {
+            ++lastApplied;
+            applyEntry(lastApplied, log[lastApplied - snapshotIndex - 1]);
+        }
+        if (lastApplied - snapshotIndex >= kSnapshotEntries) takeSnapshot(lock);
+    }
+}
+
+// Only ADD / CANCEL / SERVE, POSITION / ESTIMATE and the two listings, like the cluster node.
+void RaftReplica::applyEntry(uint64_t index, const Entry& entry)
+{
+    Waiter* waiter = nullptr;
+    auto it = waiters.find(index);
+    if (it != waiters.end()) {
+        waiter = it->second;
+        if (waiter->term != entry.term) { // another leader's entry took its place
+            waiter->done = true;
+            waiter->settled.notify_one();
+            waiter = nullptr;
+        }
+    }
+    if (waiter) manager->setOutputSink(waiter);
+    for (const std::string& line : entry.lines) {
+        const ParsedCommand p = parseCommandLine(line);
+        if (p.args.empty()) continue;
+        switch (p.command) {
+            case Command::ADD:
+            case Command::CANCEL:
+            case Command::SERVE:
+            case Command::POSITION:
+            case Command::ESTIMATE:
+                manager->runCommand(p);
+                break;
+            case Command::PRINTQ:
+            case Command::PRINTC: {
+                if (!waiter) break; // read-only: nobody to answer
+                manager->flushResults();
+                std::ostringstream report;
+                if (p.command == Command::PRINTQ) manager->printQueue(report);
+                else manager->printBankClients(report);
+                waiter->text.append(report.str());
+                break;
+            }
+            default:
+                manager->flushResults();
+                if (waiter) waiter->writeLine("Command not available over the network: " + std::string(p.args[0]));
+                break;
+        }
+    }
+    manager->setOutputSink(&discard); // renders the pending results into `waiter`
+    if (waiter) {
+        waiter->applied = true;
+        waiter->done = true;
+        waiter->settled.notify_one();
+    }
+}
+
+// The state and the log are copied under `mutex`; the snapshot and the
+// compacted log are written and synced off it, under syncMutex only, so no
+// entry past the copy gets synced to the old log file meanwhile. Entries
+// appended in between are added to the new file when the lock is back.
+void RaftReplica::takeSnapshot(std::unique_lock<std::mutex>& lock)
+{
+    snapshotState = manager->saveState().dump();
+    snapshotTerm = termAt(lastApplied);
+    log.erase(log.begin(), log.begin() + static_cast<std::ptrdiff_t>(lastApplied - snapshotIndex));
+    snapshotIndex = lastApplied;
+
+    const std::string snapshot = snapshotFile();
+    const std::string compactedLog = logFile();
+    const uint64_t copied = lastIndex();
+    const uint64_t rewrites = logRewrites;
+    const std::string file = path("raft.log");
+    const std::string tmp = file + ".compact";
+
+    std::unique_lock<std::mutex> syncLock(syncMutex);
+    lock.unlock();
+    int fd = -1;
+    bool ok = persistSnapshot(snapshot); // the old log still covers us otherwise
+    if (ok) {
+        fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        ok = fd >= 0 && writeAll(fd, compactedLog) && (!syncWrites || ::fdatasync(fd) == 0);
+        if (!ok) logError() << "Cannot write " << tmp << ": " << std::strerror(errno);
+    }
+    syncLock.unlock();
+    lock.lock();
+    syncLock.lock();
+
+    // A rewrite in between (truncation, installed snapshot) already compacted the log.
+    if (ok && logRewrites == rewrites) {
+        std::string tail;
+        for (uint64_t i = copied + 1; i <= lastIndex(); ++i) {
+            const Entry& entry = log[i - snapshotIndex - 1];
+            tail += entryLine(entry.term, entry.lines);
+        }
+        // Only a log sync that got in between the two locks makes the tail
+        // acknowledged, and so in need of a sync before the rename.
+        const bool tailSynced = syncedIndex > copied;
+        if (writeAll(fd, tail) && (!syncWrites || !tailSynced || ::fdatasync(fd) == 0)
+            && std::rename(tmp.c_str(), file.c_str()) == 0) {
+            ::close(logFd);
+            logFd = fd;
+            fd = -1;
+            writtenIndex = lastIndex();
+            syncedIndex = tailSynced ? lastIndex() : copied;
+        } else {
+            logError() << "Cannot write " << file << ": " << std::strerror(errno);
+        }
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+    }
+}
+
+// --- Log and persistence ---
+// raft.state: {"term", "votedFor"}. raft.snap: {"index", "term", "state"}.
+// raft.log: a {"firstIndex"} line, then one {"term", "lines"} line per entry.
+
+uint64_t RaftReplica::appendLocal(Entry entry)
+{
+    const std::string line = entryLine(entry.term, entry.lines);
+    log.push_back(std::move(entry));
+    if (!writeAll(logFd, line)) logError() << "Cannot write " << path("raft.log") << ": " << std::strerror(errno);
+    writtenIndex = lastIndex();
+    return lastIndex();
+}
+
+// Drops the entries from `index` on (the file is rewritten by the caller),
+// failing the Executes waiting for them.
+void RaftReplica::truncateFrom(uint64_t index)
+{
+    log.erase(log.begin() + static_cast<std::ptrdiff_t>(index - snapshotIndex - 1), log.end());
+    for (auto it = waiters.begin(); it != waiters.end();) {
+        if (it->first >= index) {
+            it->second->done = true;
+            it->second->settled.notify_one();
+            it = waiters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void RaftReplica::rewriteLog()
+{
+    std::lock_guard<std::mutex> lock(syncMutex);
+    ++logRewrites;
+    const std::string file = path("raft.log");
+    if (!replaceFile(file, logFile(), syncWrites)) logError() << "Cannot write " << file << ": " << std::strerror(errno);
+    if (logFd >= 0) ::close(logFd);
+    logFd = ::open(file.c_str(), O_WRONLY | O_APPEND);
+    writtenIndex = lastIndex();
+    syncedIndex = lastIndex();
+}
+
+// Returns once entries up to `index` are on disk. Concurrent callers share
+// an fdatasync: each syncs everything written when it gets its turn.
+void RaftReplica::syncLog(uint64_t index)
+{
+    if (!syncWrites) return;
+    std::lock_guard<std::mutex> lock(syncMutex);
+    if (syncedIndex >= index) return;
+    const uint64_t written = writtenIndex;
+    ::fdatasync(logFd);
+    syncedIndex = written;
+}
+
+void RaftReplica::persistState()
+{
+    const std::string file = path("raft.state");
+    if (!replaceFile(file, json{{"term", currentTerm}, {"votedFor", votedFor}}.dump(), syncWrites))
+        logError() << "Cannot write " << file << ": " << std::strerror(errno);
+}
+
+std::string RaftReplica::logFile() const
+{
+    std::string content = json{{"firstIndex", snapshotIndex + 1}}.dump() + '\n';
+    for (const Entry& entry : log) content += entryLine(entry.term, entry.lines);
+    return content;
+}
+
+std::string RaftReplica::snapshotFile() const
+{
+    return "{\"index\":" + std::to_string(snapshotIndex) + ",\"term\":" + std::to_string(snapshotTerm)
+           + ",\"state\":" + snapshotState + "}";
+}
+
+// Under syncMutex, which keeps two snapshot writes apart.
+bool RaftReplica::persistSnapshot(const std::string& content)
+{
+    const std::string file = path("raft.snap");
+    if (replaceFile(file, content, syncWrites)) return true;
+    logError() << "Cannot write " << file << ": " << std::strerror(errno);
+    return false;
+}
+
+bool RaftReplica::recover(const std::string& clientsPath)
+{
+    std::error_code error;
+    std::filesystem::create_directories(dataDir, error);
+    if (error) {
+        std::cerr << "Cannot create " << dataDir << ": " << error.message() << std::endl;
+        return false;
+    }
+    try {
+        if (std::ifstream in(path("raft.state")); in) {
+            const json state = json::parse(in);
+            currentTerm = state.at("term").get<uint64_t>();
+            votedFor = state.at("votedFor").get<int64_t>();
+        }
+        if (std::ifstream in(path("raft.snap")); in) {
+            const json snapshot = json::parse(in);
+            snapshotIndex = snapshot.at("index").get<uint64_t>();
+            snapshotTerm = snapshot.at("term").get<uint64_t>();
+            snapshotState = snapshot.at("state").dump();
+            manager = newManager();
+            if (!manager->restoreState(snapshot.at("state"))) return false;
+        } else {
+            manager = newManager();
+            if (!clientsPath.empty() && !loadAccounts(*manager, clientsPath)) return false;
+        }
+    } catch (const json::exception& e) {
+        std::cerr << "Invalid replica state in " << dataDir << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    if (std::ifstream in(path("raft.log")); in) {
+        std::string line;
+        uint64_t index = 0;
+        try {
+            if (std::getline(in, line)) index = json::parse(line).at("firstIndex").get<uint64_t>();
+        } catch (const json::exception& e) {
+            std::cerr << "Invalid log header in " << path("raft.log") << ": " << e.what() << std::endl;
+            return false;
+        }
+        if (index > snapshotIndex + 1) {
+            std::cerr << "Log in " << dataDir << " starts after the snapshot" << std::endl;
+            return false;
+        }
+        for (; std::getline(in, line); ++index) {
+            json entry;
+            try {
+                entry = json::parse(line);
+            } catch (const json::exception&) {
+                break; // torn last write
+            }
+            if (index <= snapshotIndex) continue;
+            log.push_back(Entry{entry.at("term").get<uint64_t>(), entry.at("lines").get<std::vector<std::string>>()});
+        }
+    }
+    rewriteLog(); // drops what the snapshot covers and any torn tail
+    commitIndex = lastApplied = snapshotIndex;
+    logInfo() << "Replica " << self << " recovered term " << currentTerm << ", snapshot at " << snapshotIndex << ", log to "
+              << lastIndex();
+    return true;
+}
+
+std::unique_ptr<BankQueueManager> RaftReplica::newManager()
+{
+    auto m = std::make_unique<BankQueueManager>();
+    m->setOutputSink(&discard);
+    // In the data directory, and not shared with the manager it may replace
+    // (installSnapshot builds it first; each deletes its file when it goes).
+    m->setHistorySpillPath(path(++managersMade % 2 ? "history.1.bin" : "history.2.bin"));
+    return m;
+}
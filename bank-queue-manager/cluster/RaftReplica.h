@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <grpcpp/grpcpp.h>
+#include "../BankQueueManager.h"
+#include "replica.grpc.pb.h"
+
+// A BankQueueManager replicated with Raft across a fixed set of processes.
+//
+// Every replica keeps the same log of commands and applies the committed
+// prefix, in order, to its own manager; all of them start from the same
+// clients.json. Only the leader takes commands (Execute): it appends them as
+// one entry, replicates it, and answers with the output of applying it once
+// a majority of replicas has the entry on disk. Followers answer with the
+// leader's address. If the leader stops, a follower whose election timer
+// runs out (randomized, kElectionTimeoutMin..Max) is elected by a majority
+// and carries on from the committed log.
+//
+//  - Replication is pipelined: the leader keeps up to kMaxInFlight
+//    AppendEntries in flight per follower, of up to kMaxBatch entries each,
+//    advancing nextIndex optimistically. New entries go out from the thread
+//    appending them; a replicator thread per follower takes the answers and
+//    sends heartbeats. A follower that refuses a call sends the leader back
+//    to where its log diverges.
+//  - The leader writes an entry to its own log in parallel with sending it,
+//    and counts itself once the write is synced; concurrent commands share
+//    one fdatasync.
+//  - Every kSnapshotEntries applied entries, the manager state is saved
+//    (BankQueueManager::saveState) and the log before it dropped. A follower
+//    too far behind for the remaining log gets the snapshot instead.
+//  - Term, vote, log and snapshot live in the replica's data directory, so a
+//    restarted replica recovers its log and catches up from the leader.
+//
+// Applying is deterministic except for wall-clock fields (history times).
+// One mutex guards the Raft state, the log and the manager. It is not held
+// across an RPC or a sync of the log or a snapshot taken here; what is
+// synced under it is the small term/vote file, which must be on disk before
+// a vote or a term change is acted on, and the log rewrites after a
+// conflicting append or an installed snapshot (which also wait for a log
+// sync in progress).
+
+class RaftReplica
+{
+    public:
+        static constexpr std::chrono::milliseconds kElectionTimeoutMin{150};
+        static constexpr std::chrono::milliseconds kElectionTimeoutMax{300};
+        static constexpr std::chrono::milliseconds kHeartbeat{50};
+        static constexpr std::chrono::milliseconds kRpcTimeout{500};
+        static constexpr std::chrono::milliseconds kCommitTimeout{5000}; // Execute gives up after
+        static constexpr int kMaxInFlight = 4;            // AppendEntries per follower
+        static constexpr size_t kMaxBatch = 256;          // entries per AppendEntries
+        static constexpr uint64_t kSnapshotEntries = 10000;
+
+        // `peers[self]` is this replica's own listening address. With
+        // `syncWrites` false, log and state writes are not fdatasync'ed
+        // (they survive a crash of the process, not of the machine).
+        RaftReplica(uint32_t self, std::vector<std::string> peers, std::string dataDir, bool syncWrites = true);
+        ~RaftReplica();
+
+        RaftReplica(const RaftReplica&) = delete;
+        RaftReplica& operator=(const RaftReplica&) = delete;
+
+        // Recovers from the data directory (the clients file is only read
+        // when there is no snapshot yet), listens on peers[self] and starts
+        // taking part in elections. False (reason on stderr) on failure.
+        bool start(const std::string& clientsPath);
+        void wait();
+        void shutdown();
+
+    private:
+        class Service;
+
+        enum class Role { FOLLOWER, CANDIDATE, LEADER };
+
+        struct Entry {
+            uint64_t term;
+            std::vector<std::string> lines;
+        };
+
+        // Output of applying an Execute's entry, if it is still the entry
+        // appended at that index in that term.
+        struct Waiter : OutputSink {
+            uint64_t term;
+            std::string text;
+            bool done = false;
+            bool applied = false;
+            std::condition_variable settled;
+            void writeLine(std::string_view line) override
+            {
+                text.append(line);
+                text.push_back('\n');
+            }
+        };
+
+        struct DiscardSink : OutputSink {
+            void writeLine(std::string_view) override {}
+        };
+
+        // An outgoing RPC, the tag of its completion.
+        struct Call {
+            enum Kind { APPEND, SNAPSHOT, VOTE } kind;
+            uint64_t term;        // ours when sent
+            uint64_t lastIndex;   // APPEND / SNAPSHOT: last index sent
+            grpc::ClientContext context;
+            grpc::Status status;
+            bankq::AppendReply append;
+            bankq::SnapshotReply snapshot;
+            bankq::VoteReply vote;
+        };
+
+        struct Peer {
+            std::unique_ptr<bankq::Replica::Stub> stub;
+            // Leader state, reset on election.
+            uint64_t nextIndex = 1;
+            uint64_t matchIndex = 0;
+            int inFlight = 0;
+            bool snapshotInFlight = false;
+            std::chrono::steady_clock::time_point lastSent{};
+            std::chrono::steady_clock::time_point retryAt{}; // after a failed call
+            grpc::CompletionQueue queue; // completions of the calls to it
+            std::thread thread;          // its replicator
+        };
+
+        const uint32_t self;
+        const std::vector<std::string> peers;
+        const std::string dataDir;
+        const bool syncWrites;
+
+        std::mutex mutex; // guards everything down to `waiters`
+        bool stopping = false;
+        Role role = Role::FOLLOWER;
+        uint64_t currentTerm = 0;
+        int64_t votedFor = -1;
+        int64_t leaderId = -1;
+        size_t votes = 0;
+        std::chrono::steady_clock::time_point electionDeadline;
+        std::mt19937 random;
+
+        std::deque<Entry> log;        // indexes snapshotIndex + 1 .. lastIndex()
+        uint64_t snapshotIndex = 0;
+        uint64_t snapshotTerm = 0;
+        std::string snapshotState;    // what InstallSnapshot sends
+        uint64_t commitIndex = 0;
+        uint64_t lastApplied = 0;
+        int logFd = -1;
+
+        std::unique_ptr<BankQueueManager> manager;
+        uint32_t managersMade = 0; // picks their history spill file
+        DiscardSink discard;
+        std::unordered_map<uint64_t, Waiter*> waiters; // by log index
+
+        std::mutex syncMutex; // serializes fdatasync of the log with its rewrites and snapshot writes
+        uint64_t logRewrites = 0; // rewriteLog() calls: a compaction in progress is stale
+        std::atomic<uint64_t> writtenIndex{0};
+        std::atomic<uint64_t> syncedIndex{0};
+
+        std::vector<std::unique_ptr<Peer>> replicas; // by replica index; ours has no stub
+        grpc::CompletionQueue voteQueue;
+        std::condition_variable applyReady;
+        std::thread ticker;
+        std::thread applier;
+        std::unique_ptr<Service> service;
+        std::unique_ptr<grpc::Server> server;
+
+        // RPC handlers.
+        bankq::ReplicaReply execute(const bankq::ReplicaCommand& command);
+        bankq::VoteReply requestVote(const bankq::VoteRequest& request);
+        bankq::AppendReply appendEntries(const bankq::AppendRequest& request);
+        bankq::SnapshotReply installSnapshot(const bankq::SnapshotRequest& request);
+
+        // Roles and elections (under `mutex`).
+        void tick();
+        void startElection();
+        void becomeFollower(uint64_t term);
+        void becomeLeader();
+        void resetElectionTimer();
+
+        // Replication (under `mutex`, except replicate()).
+        void replicate(Peer& peer);
+        void pump(Peer& peer);
+        void sendAppend(Peer& peer);
+        void sendSnapshot(Peer& peer);
+        void onReply(Peer& peer, const Call& call);
+        void pumpAll();
+        void advanceCommit();
+
+        // Applying (applier thread).
+        void applyLoop();
+        void applyEntry(uint64_t index, const Entry& entry);
+        void takeSnapshot(std::unique_lock<std::mutex>& lock);
+
+        // Log and persistence.
+        uint64_t lastIndex() const { return snapshotIndex + log.size(); }
+        uint64_t termAt(uint64_t index) const { return index == snapshotIndex ? snapshotTerm : log[index - snapshotIndex - 1].term; }
+        uint64_t appendLocal(Entry entry);
+        void truncateFrom(uint64_t index);
+        void rewriteLog();
+        void syncLog(uint64_t index);
+        void persistState();
+        std::string logFile() const;      // raft.log content
+        std::string snapshotFile() const; // raft.snap content
+        bool persistSnapshot(const std::string& content);
+        bool recover(const std::string& clientsPath);
+        std::unique_ptr<BankQueueManager> newManager();
+        std::string path(const char* name) const { return dataDir + "/" + name; }
+};
@@ -0,0 +1,34 @@
+// One node of a bank cluster (ClusterNode.h).
+//
+//   ./bank_node <index> <host:port,host:port,...> [clients.json]
+//
+// Every node of the cluster gets the same address list, in the same order,
+// and listens on its own entry. With a clients file, the node opens the
+// accounts of it that it owns; accounts can also be opened over RPC.
+#include "ClusterNode.h"
+
+int main(int argc, char* argv[])
+{
+    int index = -1;
+    std::vector<std::string> peers;
+    if (argc == 3 || argc == 4) {
+        std::string_view list = argv[2];
+        while (!list.empty()) {
+            const size_t comma = list.find(',');
+            peers.emplace_back(list.substr(0, comma));
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        }
+        if (!parseNumber(std::string_view(argv[1]), index) || static_cast<size_t>(index) >= peers.size()) index = -1;
+    }
+    if (index < 0) {
+        std::cerr << "Invalid usage. Use: " << argv[0] << " <index> <host:port,host:port,...> [clients.json]" << std::endl;
+        return 1;
+    }
+
+    ClusterNode node(static_cast<uint32_t>(index), peers);
+    if (argc == 4 && !node.loadAccounts(argv[3])) return 1;
+    if (!node.start()) return 1;
+    std::cerr << "Node " << index << " of " << peers.size() << " serving on " << peers[index] << std::endl;
+    node.wait();
+    return 0;
+}
@@ -0,0 +1,40 @@
+// One replica of a Raft-replicated bank manager (RaftReplica.h).
+//
+//   ./replica <index> <host:port,host:port,...> <data dir> [clients.json] [--no-sync]
+//
+// Every replica gets the same address list, in the same order, and the same
+// clients file, which is only read the first time (later starts recover
+// from the data directory). Commands go to the leader; any other replica
+// answers with its address.
+#include "RaftReplica.h"
+
+int main(int argc, char* argv[])
+{
+    bool sync = true;
+    if (argc > 1 && std::string_view(argv[argc - 1]) == "--no-sync") {
+        sync = false;
+        --argc;
+    }
+    int index = -1;
+    std::vector<std::string> peers;
+    if (argc == 4 || argc == 5) {
+        std::string_view list = argv[2];
+        while (!list.empty()) {
+            const size_t comma = list.find(',');
+            peers.emplace_back(list.substr(0, comma));
+            list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        }
+        if (!parseNumber(std::string_view(argv[1]), index) || static_cast<size_t>(index) >= peers.size()) index = -1;
+    }
+    if (index < 0) {
+        std::cerr << "Invalid usage. Use: " << argv[0] << " <index> <host:port,host:port,...> <data dir> [clients.json] [--no-sync]"
+                  << std::endl;
+        return 1;
+    }
+
+    RaftReplica replica(static_cast<uint32_t>(index), peers, argv[3], sync);
+    if (!replica.start(argc == 5 ? argv[4] : "")) return 1;
+    std::cerr << "Replica " << index << " of " << peers.size() << " serving on " << peers[index] << std::endl;
+    replica.wait();
+    return 0;
+}
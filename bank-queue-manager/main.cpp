@@ -0,0 +1,202 @@
+#include "BankQueueManager.h"
+#include "BankServer.h"
+#include "MetricsServer.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --- Batch mode ---
+// Replays a command script at full speed: no prompt, no per-command sleep, and
+// results rendered in batches. A script file is mapped into memory; stdin
+// ("-") is read in 1 MB blocks. Stops at the end of input or at `exit`.
+
+namespace {
+
+// Runs every complete line of `data`; returns the bytes consumed.
+// `stop` is set when an `exit` command is reached.
+size_t runLines(BankQueueManager& manager, std::string_view data, unsigned long long& commands, bool& stop)
+{
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const void* nl = std::memchr(data.data() + pos, '\n', data.size() - pos);
+        if (!nl) break;
+        const size_t end = static_cast<size_t>(static_cast<const char*>(nl) - data.data());
+        std::string_view line = data.substr(pos, end - pos);
+        pos = end + 1;
+
+        Tokenizer tokenizer(line);
+        std::string_view first;
+        if (!tokenizer.next(first)) continue;
+        if (parseCommand(first) == Command::EXIT) {
+            stop = true;
+            break;
+        }
+        manager.runCommand(line);
+        ++commands;
+    }
+    return pos;
+}
+
+bool runBatch(BankQueueManager& manager, const char* path)
+{
+    unsigned long long commands = 0;
+    bool stop = false;
+    const auto start = std::chrono::steady_clock::now();
+
+    if (std::strcmp(path, "-") == 0) {
+        std::vector<char> buf(1 << 20);
+        size_t filled = 0;
+        while (!stop) {
+            if (filled == buf.size()) buf.resize(buf.size() * 2); // a single line longer than the buffer
+            ssize_t n = ::read(STDIN_FILENO, buf.data() + filled, buf.size() - filled);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            filled += static_cast<size_t>(n);
+            size_t used = runLines(manager, std::string_view(buf.data(), filled), commands, stop);
+            std::memmove(buf.data(), buf.data() + used, filled - used);
+            filled -= used;
+        }
+        if (!stop && filled > 0) {
+            buf.resize(filled);
+            buf.push_back('\n'); // last line without a newline
+            runLines(manager, std::string_view(buf.data(), buf.size()), commands, stop);
+        }
+    } else {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Failed to open batch file '" << path << "'.\n";
+            return false;
+        }
+        struct stat st{};
+        ::fstat(fd, &st);
+        const size_t size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                std::cerr << "Failed to map batch file '" << path << "'.\n";
+                ::close(fd);
+                return false;
+            }
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+            std::string_view data(static_cast<const char*>(mapped), size);
+            size_t used = runLines(manager, data, commands, stop);
+            if (!stop && used < size) {
+                std::string last(data.substr(used));
+                last.push_back('\n'); // last line without a newline
+                runLines(manager, last, commands, stop);
+            }
+            ::munmap(mapped, size);
+        }
+        ::close(fd);
+    }
+
+    manager.flushResults();
+    logFlush();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::flush;
+    std::cerr << "Batch: " << commands << " commands in " << seconds << " s ("
+              << static_cast<long long>(seconds > 0 ? commands / seconds : 0) << " commands/sec)" << std::endl;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+
+    const char* batchPath = nullptr;
+    int servePort = -1;
+    IoBackend ioBackend = IoBackend::EPOLL;
+    int metricsPort = -1;
+    if (argc >= 3 && std::strcmp(argv[argc - 2], "--metrics") == 0) { // goes with any mode
+        if (!parseNumber(std::string_view(argv[argc - 1]), metricsPort) || metricsPort > 65535) {
+            metricsPort = -1;
+            argc = 0; // invalid usage below
+        } else {
+            argc -= 2;
+        }
+    }
+    if (argc == 3 && std::strcmp(argv[1], "--batch") == 0) {
+        batchPath = argv[2];
+    } else if ((argc == 3 || argc == 5) && std::strcmp(argv[1], "--serve") == 0) {
+        if (!parseNumber(std::string_view(argv[2]), servePort) || servePort > 65535) servePort = -1;
+        if (argc == 5) {
+            ioBackend = std::strcmp(argv[3], "--io") == 0 ? parseIoBackend(argv[4]) : IoBackend::UNKNOWN;
+            if (ioBackend == IoBackend::UNKNOWN) servePort = -1;
+        }
+    }
+    if (argc != 1 && !batchPath && servePort < 0) {
+        std::cerr << "Invalid usage. Use: " << argv[0] << " [--batch <script file | -> | --serve <port> [--io epoll|uring|coro]]"
+                  << " [--metrics <port>]" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<MetricsServer> metrics;
+    if (metricsPort >= 0) {
+        metrics = std::make_unique<MetricsServer>(static_cast<uint16_t>(metricsPort));
+        if (!metrics->start()) return 1;
+        std::cerr << "Serving metrics on http://localhost:" << metrics->getPort() << "/metrics" << std::endl;
+    }
+
+    BankQueueManager manager;
+    manager.LoadPreClientsAndQueue();
+
+    if (batchPath) {
+        return runBatch(manager, batchPath) ? 0 : 1;
+    }
+
+    if (servePort >= 0) {
+        manager.flushResults();
+        std::unique_ptr<NetworkServer> server = createServer(ioBackend, manager, static_cast<uint16_t>(servePort));
+        if (!server->listen()) return 1;
+        std::cerr << "Serving the command protocol on port " << server->getPort()
+                  << " (" << io_backend_to_string(server->backend()) << ")" << std::endl;
+        server->run();
+        return 0;
+    }
+
+    manager.flushResults();
+    logFlush();
+    std::cout << std::endl;
+    manager.printBankClients();
+    std::cout << std::endl;
+    manager.printQueue();
+    std::cout << std::endl;
+
+    std::string input;
+
+    std::cout << "Please insert one of the following commands:" << std::endl;
+    std::cout << "add [id (1 word string)] [service (1 word string)] [(optional)amount] [(optional)target id]" << std::endl;
+    std::cout << "add [id] multitransfer [amount] [target id] [amount] [target id] ..." << std::endl;
+    std::cout << "cancel [id (1 word string)]" << std::endl;
+    std::cout << "serve" << std::endl;
+    std::cout << "position [id] (requests ahead in the queue)" << std::endl;
+    std::cout << "estimate [id] (position and estimated wait from the service times)" << std::endl;
+    std::cout << "servicetimes (service time per action and per teller)" << std::endl;
+    std::cout << "printq (print queue)" << std::endl;
+    std::cout << "printc (print bank clients)" << std::endl;
+    std::cout << "ledger [id] (print client journal entries)" << std::endl;
+    std::cout << "fastlane [(optional) REGULAR|VIP|BUSINESS] [on|off] (answer balance checks without queueing)" << std::endl;
+    std::cout << "history [id] [(optional) last [n] | ticket [from] [to] | time [fromMs] [toMs]]" << std::endl;
+    std::cout << "verbosity [(optional) silent|error|info|debug] (console output level)" << std::endl;
+    std::cout << "output [(optional) text|jsonl|none|binary [file]] (how results are rendered)" << std::endl;
+    std::cout << "stats [(optional) on|off|reset|dump [file]] (latency percentiles of add / serve / cancel and queue waits)" << std::endl;
+    std::cout << "trace [dump [file] | clear] (Chrome trace of recent commands, builds with -DBANKQ_TRACE)" << std::endl;
+    std::cout << "exit" << std::endl;
+    std::cout << std::endl;
+
+    while (true) {
+            manager.flushResults();
+            logFlush(); // everything from the last command is on screen before the prompt
+            std::cout << std::endl;
+            std::cout << ">> " << std::flush;
+            std::getline(std::cin, input); // input from user
+
+            manager.runCommand(input);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Checks that the service-time model behind `estimate` learns from serves
+// with latency stats off as well as on.
+//
+// Four deposits are queued and the first three served kServeGap apart: the
+// two completed intervals must be recorded as service times of at least
+// kServeGap, and the last client must get a positive wait estimate. Exits
+// non-zero on the first failed check.
+//
+// Build and run (from bank-queue-manager/):
+//   g++ -O2 -std=c++17 -pthread BankQueueManager.cpp tests/service_model_test.cpp -o service_model_test && ./service_model_test
+#include "../BankQueueManager.h"
+#include <thread>
+
+namespace {
+
+constexpr auto kServeGap = std::chrono::milliseconds(2);
+constexpr int64_t kServeGapNs = std::chrono::nanoseconds(kServeGap).count();
+
+int failures = 0;
+
+void check(bool ok, const char* what, bool statsOn)
+{
+    if (ok) return;
+    std::cerr << "FAILED (stats " << (statsOn ? "on" : "off") << "): " << what << "\n";
+    ++failures;
+}
+
+void run(bool statsOn)
+{
+    LatencyStats::instance().setEnabled(statsOn);
+    BankQueueManager manager;
+    manager.setOutputFormat(OutputFormat::NONE);
+    const char* ids[] = {"a", "b", "c", "d"};
+    for (const char* id : ids) manager.addBankClient(id, 1000, "REGULAR");
+    for (const char* id : ids) manager.addRequest(id, Service::DEPOSIT, 10, {});
+    const uint32_t last = manager.findClientHandle("d");
+
+    check(manager.estimateWaitNs(last) == -1, "no estimate before the first service time", statsOn);
+    for (int i = 0; i < 3; ++i) {
+        if (i) std::this_thread::sleep_for(kServeGap);
+        manager.serveNext();
+    }
+
+    const ServiceTimeSeries& deposits = manager.serviceTimes().byKind(static_cast<size_t>(Service::DEPOSIT));
+    check(manager.serviceTimes().overall().samples() == 2, "two service times recorded", statsOn);
+    check(deposits.samples() == 2, "recorded as deposits", statsOn);
+    check(deposits.mean() >= kServeGapNs, "service time covers the gap between serves", statsOn);
+    check(manager.serviceTimes().busyTellers() == 1, "the console teller is busy", statsOn);
+    check(manager.queuePosition(last) == 0, "the last client is next", statsOn);
+    check(manager.estimateWaitNs(last) > 0, "positive wait estimate", statsOn);
+}
+
+} // namespace
+
+int main()
+{
+    run(false);
+    run(true);
+    if (failures) return 1;
+    std::cout << "service_model_test: OK\n";
+    return 0;
+}